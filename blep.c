@@ -0,0 +1,210 @@
+/* blep.c: Band-limited step synthesis
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Rather than computing every output sample, a signal made of steps is
+   described by when and by how much its level changes. Each change
+   adds a band-limited impulse (a windowed sinc) into the buffer, and
+   reading sums the buffer, turning the impulses into band-limited
+   steps. The cost is then proportional to the number of changes rather
+   than the number of samples, and square waves come out without
+   aliasing. */
+
+#include <config.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "blep.h"
+#include "sound/dsp.h"
+#include "ui/ui.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* How many sub-sample positions the kernel is tabulated at */
+#define BLEP_PHASE_BITS 6
+#define BLEP_PHASES ( 1 << BLEP_PHASE_BITS )
+
+/* Each phase of the kernel sums to 1 << BLEP_KERNEL_BITS, so a step
+   always settles at exactly the requested level */
+#define BLEP_KERNEL_BITS 14
+
+/* Cutoff as a fraction of the sample rate; a little below Nyquist to
+   leave room for the window's transition band */
+static const double BLEP_CUTOFF = 0.45;
+
+static libspectrum_signed_word blep_kernel[ BLEP_PHASES ][ BLEP_WIDTH ];
+static int blep_kernel_ready = 0;
+
+struct blep_buffer {
+  size_t length;
+  libspectrum_signed_dword *impulses;	/* length + BLEP_WIDTH entries */
+  libspectrum_signed_dword level;	/* Running sum of impulses read */
+};
+
+static void
+blep_make_kernel( void )
+{
+  int phase, i, largest;
+  double total, value[ BLEP_WIDTH ];
+  libspectrum_signed_dword sum;
+
+  for( phase = 0; phase < BLEP_PHASES; phase++ ) {
+
+    total = 0;
+    for( i = 0; i < BLEP_WIDTH; i++ ) {
+
+      /* Distance of this tap from the centre of the impulse */
+      double t = i - ( BLEP_WIDTH / 2 - 1 ) - (double)phase / BLEP_PHASES;
+      double x = 2 * BLEP_CUTOFF * t;
+      double sinc = x ? sin( M_PI * x ) / ( M_PI * x ) : 1;
+      double window = 0.42 + 0.5  * cos(     M_PI * t / ( BLEP_WIDTH / 2 ) )
+	                   + 0.08 * cos( 2 * M_PI * t / ( BLEP_WIDTH / 2 ) );
+
+      value[i] = sinc * window;
+      total += value[i];
+    }
+
+    sum = 0; largest = 0;
+    for( i = 0; i < BLEP_WIDTH; i++ ) {
+      blep_kernel[ phase ][i] =
+	floor( value[i] / total * ( 1 << BLEP_KERNEL_BITS ) + 0.5 );
+      sum += blep_kernel[ phase ][i];
+      if( blep_kernel[ phase ][i] > blep_kernel[ phase ][ largest ] )
+	largest = i;
+    }
+
+    /* Put any rounding error where it'll do least harm */
+    blep_kernel[ phase ][ largest ] += ( 1 << BLEP_KERNEL_BITS ) - sum;
+  }
+
+  blep_kernel_ready = 1;
+}
+
+blep_buffer*
+blep_alloc( size_t length )
+{
+  blep_buffer *buffer;
+
+  if( !blep_kernel_ready ) blep_make_kernel();
+
+  buffer = malloc( sizeof( *buffer ) );
+  if( !buffer ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  buffer->length = length;
+  buffer->impulses =
+    malloc( ( length + BLEP_WIDTH ) * sizeof( *buffer->impulses ) );
+  if( !buffer->impulses ) {
+    free( buffer );
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  blep_clear( buffer );
+
+  return buffer;
+}
+
+void
+blep_add_delta( blep_buffer *buffer, libspectrum_dword position, int delta )
+{
+  size_t sample = position >> BLEP_POSITION_BITS, i;
+  const libspectrum_signed_word *kernel;
+  libspectrum_signed_dword *impulses;
+
+  if( !delta ) return;
+
+  /* Anything further ahead than we've room for happens at the end */
+  if( sample >= buffer->length ) {
+    sample = buffer->length - 1;
+    position = 0;
+  }
+
+  kernel = blep_kernel[ ( position >> ( BLEP_POSITION_BITS - BLEP_PHASE_BITS ) )
+			& ( BLEP_PHASES - 1 ) ];
+  impulses = &buffer->impulses[ sample ];
+
+  for( i = 0; i < BLEP_WIDTH; i++ )
+    impulses[i] += kernel[i] * delta;
+}
+
+/* Forget the first 'count' samples, which have now been read */
+static void
+blep_consume( blep_buffer *buffer, size_t count )
+{
+  /* Move anything still to come down to the start of the buffer */
+  memmove( buffer->impulses, &buffer->impulses[ count ],
+	   ( buffer->length + BLEP_WIDTH - count ) *
+	   sizeof( *buffer->impulses ) );
+  memset( &buffer->impulses[ buffer->length + BLEP_WIDTH - count ], 0,
+	  count * sizeof( *buffer->impulses ) );
+}
+
+void
+blep_read( blep_buffer *buffer, libspectrum_signed_word *out, size_t count,
+	   size_t copies )
+{
+  if( count > buffer->length ) count = buffer->length;
+
+  sound_dsp->integrate( out, buffer->impulses, count, &buffer->level,
+			BLEP_KERNEL_BITS, copies );
+
+  blep_consume( buffer, count );
+}
+
+void
+blep_read_stereo( blep_buffer *left, blep_buffer *right,
+		  libspectrum_signed_word *out, size_t count )
+{
+  libspectrum_signed_dword levels[2];
+
+  if( count > left->length ) count = left->length;
+  if( count > right->length ) count = right->length;
+
+  levels[0] = left->level; levels[1] = right->level;
+  sound_dsp->integrate_stereo( out, left->impulses, right->impulses, count,
+			       levels, BLEP_KERNEL_BITS );
+  left->level = levels[0]; right->level = levels[1];
+
+  blep_consume( left, count );
+  blep_consume( right, count );
+}
+
+void
+blep_clear( blep_buffer *buffer )
+{
+  memset( buffer->impulses, 0,
+	  ( buffer->length + BLEP_WIDTH ) * sizeof( *buffer->impulses ) );
+  buffer->level = 0;
+}
+
+void
+blep_free( blep_buffer *buffer )
+{
+  if( !buffer ) return;
+
+  free( buffer->impulses );
+  free( buffer );
+}
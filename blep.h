@@ -0,0 +1,60 @@
+/* blep.h: Band-limited step synthesis
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef FUSE_BLEP_H
+#define FUSE_BLEP_H
+
+#include <stdlib.h>
+
+#include <libspectrum.h>
+
+/* Sample positions passed to blep_add_delta() are fixed point with
+   this many fractional bits */
+#define BLEP_POSITION_BITS 16
+
+/* How many samples after its position a step takes to settle */
+#define BLEP_WIDTH 16
+
+typedef struct blep_buffer blep_buffer;
+
+/* A buffer able to take steps up to 'length' samples ahead of the next
+   sample to be read */
+blep_buffer* blep_alloc( size_t length );
+
+/* Change the output level by 'delta' at sample position 'position' */
+void blep_add_delta( blep_buffer *buffer, libspectrum_dword position,
+		     int delta );
+
+/* Write the next 'count' samples to 'out', each one to 'copies' (1 or
+   2) consecutive entries */
+void blep_read( blep_buffer *buffer, libspectrum_signed_word *out,
+		size_t count, size_t copies );
+
+/* Write the next 'count' samples from each side to 'out', interleaved */
+void blep_read_stereo( blep_buffer *left, blep_buffer *right,
+		       libspectrum_signed_word *out, size_t count );
+
+/* Return the output to zero and forget any pending steps */
+void blep_clear( blep_buffer *buffer );
+
+void blep_free( blep_buffer *buffer );
+
+#endif			/* #ifndef FUSE_BLEP_H */
@@ -86,4 +86,30 @@ int compat_file_write( compat_fd fd, const unsigned char *buffer,
                        size_t length );
 int compat_file_close( compat_fd fd );
 
+typedef void* compat_dir;
+
+typedef enum compat_dir_result_t {
+  COMPAT_DIR_RESULT_OK,
+  COMPAT_DIR_RESULT_END,
+  COMPAT_DIR_RESULT_ERROR,
+} compat_dir_result_t;
+
+compat_dir compat_opendir( const char *path );
+compat_dir_result_t compat_readdir( compat_dir directory, char *name,
+				    size_t length );
+int compat_closedir( compat_dir directory );
+
+typedef void* compat_thread;
+typedef void* compat_semaphore;
+
+/* Run 'function( data )' on a new thread; NULL on failure */
+compat_thread compat_thread_create( int (*function)( void *data ),
+				    void *data );
+void compat_thread_join( compat_thread thread );
+
+compat_semaphore compat_semaphore_create( int value );
+void compat_semaphore_wait( compat_semaphore semaphore );
+void compat_semaphore_post( compat_semaphore semaphore );
+void compat_semaphore_destroy( compat_semaphore semaphore );
+
 #endif				/* #ifndef FUSE_COMPAT_H */
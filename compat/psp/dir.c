@@ -0,0 +1,62 @@
+/* dir.c: Directory-related compatibility routines
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <config.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+
+#include "compat.h"
+#include "ui/ui.h"
+
+compat_dir
+compat_opendir( const char *path )
+{
+  return opendir( path );
+}
+
+compat_dir_result_t
+compat_readdir( compat_dir directory, char *name, size_t length )
+{
+  struct dirent *dirent;
+
+  errno = 0;
+  dirent = readdir( directory );
+
+  if( !dirent ) {
+    if( errno == 0 ) return COMPAT_DIR_RESULT_END;
+    ui_error( UI_ERROR_ERROR, "error reading directory: %s",
+	      strerror( errno ) );
+    return COMPAT_DIR_RESULT_ERROR;
+  }
+
+  strncpy( name, dirent->d_name, length );
+  name[ length - 1 ] = 0;
+
+  return COMPAT_DIR_RESULT_OK;
+}
+
+int
+compat_closedir( compat_dir directory )
+{
+  return closedir( directory );
+}
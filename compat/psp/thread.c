@@ -0,0 +1,128 @@
+/* thread.c: Thread-related compatibility routines
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <pspkernel.h>
+
+#include "compat.h"
+#include "ui/ui.h"
+
+/* Above the main thread, so work handed over is started at once and
+   the main thread gets to run whenever a worker blocks, but below the
+   sound threads */
+#define COMPAT_THREAD_PRIORITY 0x18
+#define COMPAT_THREAD_STACK 0x10000
+
+typedef struct psp_thread {
+  SceUID id;
+  int (*function)( void *data );
+  void *data;
+} psp_thread;
+
+static int
+thread_entry( SceSize length, void *argp )
+{
+  psp_thread *thread = *(psp_thread**)argp;
+
+  sceKernelExitThread( thread->function( thread->data ) );
+  return 0;
+}
+
+compat_thread
+compat_thread_create( int (*function)( void *data ), void *data )
+{
+  psp_thread *thread;
+
+  thread = malloc( sizeof( *thread ) );
+  if( !thread ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  thread->function = function;
+  thread->data = data;
+
+  thread->id = sceKernelCreateThread( "fuse", thread_entry,
+				      COMPAT_THREAD_PRIORITY,
+				      COMPAT_THREAD_STACK, 0, NULL );
+  if( thread->id < 0 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't create thread: 0x%08x",
+	      (unsigned)thread->id );
+    free( thread );
+    return NULL;
+  }
+
+  /* The kernel copies the arguments onto the new thread's stack */
+  if( sceKernelStartThread( thread->id, sizeof( thread ), &thread ) < 0 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't start thread" );
+    sceKernelDeleteThread( thread->id );
+    free( thread );
+    return NULL;
+  }
+
+  return thread;
+}
+
+void
+compat_thread_join( compat_thread thread )
+{
+  psp_thread *psp = thread;
+
+  sceKernelWaitThreadEnd( psp->id, NULL );
+  sceKernelDeleteThread( psp->id );
+  free( psp );
+}
+
+compat_semaphore
+compat_semaphore_create( int value )
+{
+  SceUID id = sceKernelCreateSema( "fuse", 0, value, 0x7fffffff, NULL );
+
+  if( id < 0 ) {
+    ui_error( UI_ERROR_ERROR, "couldn't create semaphore: 0x%08x",
+	      (unsigned)id );
+    return NULL;
+  }
+
+  /* Offset by one so a valid semaphore is never NULL */
+  return (compat_semaphore)(size_t)( id + 1 );
+}
+
+void
+compat_semaphore_wait( compat_semaphore semaphore )
+{
+  sceKernelWaitSema( (SceUID)(size_t)semaphore - 1, 1, NULL );
+}
+
+void
+compat_semaphore_post( compat_semaphore semaphore )
+{
+  sceKernelSignalSema( (SceUID)(size_t)semaphore - 1, 1 );
+}
+
+void
+compat_semaphore_destroy( compat_semaphore semaphore )
+{
+  sceKernelDeleteSema( (SceUID)(size_t)semaphore - 1 );
+}
@@ -85,9 +85,15 @@
 /* Define to 1 if you have the <unistd.h> header file. */
 #define HAVE_UNISTD_H 1
 
+/* Define to 1 if you have the <zlib.h> header file. */
+#define HAVE_ZLIB_H 1
+
 /* Define to 1 if you have the <X11/extensions/XShm.h> header file. */
 /* #undef HAVE_X11_EXTENSIONS_XSHM_H */
 
+/* Defined to time how long each part of the emulator takes */
+/* #undef HOST_PROFILE */
+
 /* Defined if no sound code is present */
 /* #undef NO_SOUND */
 
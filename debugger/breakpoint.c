@@ -42,6 +42,13 @@ GSList *debugger_breakpoints;
 /* The next breakpoint ID to use */
 static size_t next_breakpoint_id;
 
+/* For each type of breakpoint on an address or a port, a bit for every
+   value on which at least one breakpoint of that type might trigger;
+   nothing else can trigger one, so the list of breakpoints need be
+   looked at only when the bit is set */
+#define BREAKPOINT_INDEX_TYPES ( DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE + 1 )
+static libspectrum_byte breakpoint_index[ BREAKPOINT_INDEX_TYPES ][ 0x10000 / 8 ];
+
 /* Textual representations of the breakpoint types and lifetimes */
 const char *debugger_breakpoint_type_text[] = {
   "Execute", "Read", "Write", "Port Read", "Port Write", "Time", "Event",
@@ -76,6 +83,8 @@ static gint find_breakpoint_by_address( gconstpointer data,
 					gconstpointer user_data );
 static void free_breakpoint( gpointer data, gpointer user_data );
 static void add_time_event( gpointer data, gpointer user_data );
+static void index_add( const debugger_breakpoint *bp );
+static void index_rebuild( void );
 
 /* Add a breakpoint */
 int
@@ -209,13 +218,16 @@ breakpoint_add( debugger_breakpoint_type type, debugger_breakpoint_value value,
       free( bp );
       return 1;
     }
+    bp->program = debugger_expression_compile( bp->condition );
   } else {
     bp->condition = NULL;
+    bp->program = NULL;
   }
 
   bp->commands = NULL;
 
   debugger_breakpoints = g_slist_append( debugger_breakpoints, bp );
+  index_add( bp );
 
   if( debugger_mode == DEBUGGER_MODE_INACTIVE )
     debugger_mode = DEBUGGER_MODE_ACTIVE;
@@ -236,20 +248,28 @@ breakpoint_add( debugger_breakpoint_type type, debugger_breakpoint_value value,
 int
 debugger_check( debugger_breakpoint_type type, libspectrum_dword value )
 {
-  GSList *ptr; debugger_breakpoint *bp;
+  GSList *ptr, *next; debugger_breakpoint *bp; char *commands;
 
   switch( debugger_mode ) {
 
   case DEBUGGER_MODE_INACTIVE: return 0;
 
   case DEBUGGER_MODE_ACTIVE:
-    for( ptr = debugger_breakpoints; ptr; ptr = ptr->next ) {
+    if( type < BREAKPOINT_INDEX_TYPES ) {
+      value &= 0xffff;
+      if( !( breakpoint_index[ type ][ value >> 3 ] & ( 1 << ( value & 0x07 ) ) ) )
+	return 0;
+    }
+
+    /* A one shot breakpoint is freed when it triggers */
+    for( ptr = debugger_breakpoints; ptr; ptr = next ) {
 
-      bp = ptr->data;
+      next = ptr->next;
+      bp = ptr->data; commands = bp->commands;
 
       if( breakpoint_check( bp, type, value ) ) {
 	debugger_mode = DEBUGGER_MODE_HALTED;
-	debugger_command_evaluate( bp->commands );
+	debugger_command_evaluate( commands );
       }
 
     }
@@ -349,17 +369,25 @@ debugger_breakpoint_trigger( debugger_breakpoint *bp )
 {
   if( bp->ignore ) { bp->ignore--; return 0; }
 
-  if( bp->condition && !debugger_expression_evaluate( bp->condition ) )
+  /* A condition which couldn't be compiled is evaluated directly */
+  if( bp->program ) {
+    if( !debugger_program_run( bp->program ) ) return 0;
+  } else if( bp->condition && !debugger_expression_evaluate( bp->condition ) ) {
     return 0;
+  }
+
+  if( bp->type == DEBUGGER_BREAKPOINT_TYPE_TIME )
+    bp->value.time.triggered = 1;
 
   if( bp->life == DEBUGGER_BREAKPOINT_LIFE_ONESHOT ) {
     debugger_breakpoints = g_slist_remove( debugger_breakpoints, bp );
+    /* The commands are still wanted by debugger_check() */
+    if( bp->condition ) debugger_expression_delete( bp->condition );
+    if( bp->program ) debugger_program_delete( bp->program );
     free( bp );
+    index_rebuild();
   }
 
-  if( bp->type == DEBUGGER_BREAKPOINT_TYPE_TIME )
-    bp->value.time.triggered = 1;
-
   return 1;
 }
 
@@ -429,6 +457,7 @@ debugger_breakpoint_remove( size_t id )
   debugger_breakpoints = g_slist_remove( debugger_breakpoints, bp );
   if( debugger_mode == DEBUGGER_MODE_ACTIVE && !debugger_breakpoints )
     debugger_mode = DEBUGGER_MODE_INACTIVE;
+  index_rebuild();
 
   /* If this was a timed breakpoint, remove the event as well */
   if( bp->type == DEBUGGER_BREAKPOINT_TYPE_TIME ) {
@@ -441,7 +470,7 @@ debugger_breakpoint_remove( size_t id )
     event_foreach( remove_time, &remove );
   }
 
-  free( bp );
+  free_breakpoint( bp, NULL );
 
   return 0;
 }
@@ -511,6 +540,8 @@ debugger_breakpoint_clear( libspectrum_word address )
       debugger_mode = DEBUGGER_MODE_INACTIVE;
   }
 
+  index_rebuild();
+
   if( !found ) {
     if( debugger_output_base == 10 ) {
       ui_error( UI_ERROR_ERROR, "No breakpoint at %d", address );
@@ -545,6 +576,7 @@ debugger_breakpoint_remove_all( void )
 {
   g_slist_foreach( debugger_breakpoints, free_breakpoint, NULL );
   g_slist_free( debugger_breakpoints ); debugger_breakpoints = NULL;
+  index_rebuild();
 
   if( debugger_mode == DEBUGGER_MODE_ACTIVE )
     debugger_mode = DEBUGGER_MODE_INACTIVE;
@@ -577,11 +609,68 @@ free_breakpoint( gpointer data, gpointer user_data GCC_UNUSED )
   }
 
   if( bp->condition ) debugger_expression_delete( bp->condition );
+  if( bp->program ) debugger_program_delete( bp->program );
   if( bp->commands ) free( bp->commands );
 
   free( bp );
 }
 
+static void
+index_set( debugger_breakpoint_type type, libspectrum_word value )
+{
+  breakpoint_index[ type ][ value >> 3 ] |= 1 << ( value & 0x07 );
+}
+
+/* Mark everything on which 'bp' might trigger */
+static void
+index_add( const debugger_breakpoint *bp )
+{
+  libspectrum_dword port;
+  libspectrum_word offset;
+  int i;
+
+  switch( bp->type ) {
+
+  case DEBUGGER_BREAKPOINT_TYPE_EXECUTE:
+  case DEBUGGER_BREAKPOINT_TYPE_READ:
+  case DEBUGGER_BREAKPOINT_TYPE_WRITE:
+    offset = bp->value.address.offset;
+
+    if( bp->value.address.page == -1 ) {
+      index_set( bp->type, offset );
+    } else if( offset < 0x4000 ) {
+      /* A page may be mapped in anywhere; whether it's there is
+	 checked only when the address is hit */
+      for( i = 0; i < 4; i++ ) index_set( bp->type, i * 0x4000 + offset );
+    }
+    break;
+
+  case DEBUGGER_BREAKPOINT_TYPE_PORT_READ:
+  case DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE:
+    for( port = 0; port < 0x10000; port++ )
+      if( ( port & bp->value.port.mask ) == bp->value.port.port )
+	index_set( bp->type, port );
+    break;
+
+  case DEBUGGER_BREAKPOINT_TYPE_TIME:
+  case DEBUGGER_BREAKPOINT_TYPE_EVENT:
+    /* Not indexed */
+    break;
+  }
+}
+
+/* Start the index again after breakpoints have been removed */
+static void
+index_rebuild( void )
+{
+  GSList *ptr;
+
+  memset( breakpoint_index, 0, sizeof( breakpoint_index ) );
+
+  for( ptr = debugger_breakpoints; ptr; ptr = ptr->next )
+    index_add( ptr->data );
+}
+
 /* Ignore breakpoint 'id' the next 'ignore' times it hits */
 int
 debugger_breakpoint_ignore( size_t id, size_t ignore )
@@ -604,10 +693,13 @@ debugger_breakpoint_set_condition( size_t id, debugger_expression *condition )
   bp = get_breakpoint_by_id( id ); if( !bp ) return 1;
 
   if( bp->condition ) debugger_expression_delete( bp->condition );
+  if( bp->program ) debugger_program_delete( bp->program );
+  bp->program = NULL;
 
   if( condition ) {
     bp->condition = debugger_expression_copy( condition );
     if( !bp->condition ) return 1;
+    bp->program = debugger_expression_compile( bp->condition );
   } else {
     bp->condition = NULL;
   }
@@ -92,6 +92,7 @@ typedef union debugger_breakpoint_value {
 } debugger_breakpoint_value;
 
 typedef struct debugger_expression debugger_expression;
+typedef struct debugger_program debugger_program;
 
 /* The breakpoint structure */
 typedef struct debugger_breakpoint {
@@ -104,6 +105,8 @@ typedef struct debugger_breakpoint {
   debugger_breakpoint_life life;
   debugger_expression *condition; /* Conditional expression to activate this
 				     breakpoint */
+  debugger_program *program;	/* The condition, compiled for evaluating
+				   each time the breakpoint is hit */
 
   char *commands;
 
@@ -51,6 +51,8 @@ int debugger_port_write( libspectrum_word address, libspectrum_byte value );
 
 int debugger_register_hash( const char *reg );
 libspectrum_word debugger_register_get( int which );
+const libspectrum_byte* debugger_register_byte( int which );
+const libspectrum_word* debugger_register_word( int which );
 void debugger_register_set( int which, libspectrum_word value );
 const char* debugger_register_text( int which );
 
@@ -98,6 +100,14 @@ void debugger_expression_delete( debugger_expression* expression );
 libspectrum_dword
 debugger_expression_evaluate( debugger_expression* expression );
 
+/* The deepest an expression may use the stack when compiled; anything
+   deeper is left to be evaluated from its tree */
+#define PROGRAM_STACK_SIZE 16
+
+debugger_program* debugger_expression_compile( debugger_expression *exp );
+void debugger_program_delete( debugger_program *program );
+libspectrum_dword debugger_program_run( const debugger_program *program );
+
 /* Event handling */
 
 int debugger_event_init( void );
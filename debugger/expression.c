@@ -92,9 +92,78 @@ struct debugger_expression {
 
 };
 
+/* A compiled expression is run on a stack machine; each instruction
+   pushes a value, or replaces the top one or two values with the
+   result of an operation on them */
+
+typedef enum program_opcode {
+
+  PROGRAM_OPCODE_INTEGER,
+  PROGRAM_OPCODE_BYTE,		/* An 8-bit register */
+  PROGRAM_OPCODE_WORD,		/* A 16-bit register */
+  PROGRAM_OPCODE_VARIABLE,
+
+  PROGRAM_OPCODE_NOT,
+  PROGRAM_OPCODE_COMPLEMENT,
+  PROGRAM_OPCODE_NEGATE,
+
+  PROGRAM_OPCODE_ADD,
+  PROGRAM_OPCODE_SUBTRACT,
+  PROGRAM_OPCODE_MULTIPLY,
+  PROGRAM_OPCODE_DIVIDE,
+  PROGRAM_OPCODE_EQUAL_TO,
+  PROGRAM_OPCODE_NOT_EQUAL_TO,
+  PROGRAM_OPCODE_LESS_THAN,
+  PROGRAM_OPCODE_GREATER_THAN,
+  PROGRAM_OPCODE_LESS_THAN_OR_EQUAL_TO,
+  PROGRAM_OPCODE_GREATER_THAN_OR_EQUAL_TO,
+  PROGRAM_OPCODE_BITWISE_AND,
+  PROGRAM_OPCODE_BITWISE_XOR,
+  PROGRAM_OPCODE_BITWISE_OR,
+
+  /* If the top value decides the result of && or ||, leave that
+     result and jump to the target; otherwise, drop it and go on to
+     the second operand, which is followed by PROGRAM_OPCODE_TRUTH */
+  PROGRAM_OPCODE_AND_THEN,
+  PROGRAM_OPCODE_OR_ELSE,
+  PROGRAM_OPCODE_TRUTH,
+
+  PROGRAM_OPCODE_END,
+
+} program_opcode;
+
+typedef struct program_instruction {
+
+  program_opcode opcode;
+
+  union {
+    libspectrum_dword integer;
+    const libspectrum_byte *byte;
+    const libspectrum_word *word;
+    const char *variable;
+    size_t target;
+  } operand;
+
+} program_instruction;
+
+struct debugger_program {
+
+  program_instruction *code;
+
+  /* A copy of the names of the variables used */
+  char *variables;
+
+};
+
 static libspectrum_dword evaluate_unaryop( struct unaryop_type *unaryop );
 static libspectrum_dword evaluate_binaryop( struct binaryop_type *binary );
 
+static int compile_measure( debugger_expression *exp, size_t *instructions,
+			    size_t *variables, size_t *depth );
+static void compile_expression( debugger_expression *exp,
+				program_instruction *code, size_t *pc,
+				char **variables );
+
 static int deparse_unaryop( char *buffer, size_t length,
 			    const struct unaryop_type *unaryop );
 static int deparse_binaryop( char *buffer, size_t length,
@@ -436,6 +505,276 @@ evaluate_binaryop( struct binaryop_type *binary )
   fuse_abort();
 }
 
+/* Compile 'exp' into a program which gives the same value as
+   debugger_expression_evaluate() would, but with registers read
+   directly from the processor and without walking the tree. Returns
+   NULL if 'exp' is too deep to compile or memory runs out; 'exp' can
+   still be evaluated directly then */
+debugger_program*
+debugger_expression_compile( debugger_expression *exp )
+{
+  debugger_program *program;
+  size_t instructions = 0, variables = 0, depth = 0, pc = 0;
+  char *variable;
+
+  if( compile_measure( exp, &instructions, &variables, &depth ) ) return NULL;
+
+  program = malloc( sizeof( *program ) );
+  if( !program ) return NULL;
+
+  program->code = malloc( ( instructions + 1 ) * sizeof( *program->code ) );
+  if( !program->code ) { free( program ); return NULL; }
+
+  program->variables = NULL;
+  if( variables ) {
+    program->variables = malloc( variables );
+    if( !program->variables ) {
+      free( program->code ); free( program ); return NULL;
+    }
+  }
+
+  variable = program->variables;
+  compile_expression( exp, program->code, &pc, &variable );
+  program->code[ pc ].opcode = PROGRAM_OPCODE_END;
+
+  return program;
+}
+
+/* Count the instructions and the space for variable names needed by
+   'exp', and check it fits on the stack when started at 'depth' */
+static int
+compile_measure( debugger_expression *exp, size_t *instructions,
+		 size_t *variables, size_t *depth )
+{
+  int error;
+
+  switch( exp->type ) {
+
+  case DEBUGGER_EXPRESSION_TYPE_VARIABLE:
+    *variables += strlen( exp->types.variable ) + 1;
+    /* Fall through */
+
+  case DEBUGGER_EXPRESSION_TYPE_INTEGER:
+  case DEBUGGER_EXPRESSION_TYPE_REGISTER:
+    ( *instructions )++;
+    return *depth >= PROGRAM_STACK_SIZE;
+
+  case DEBUGGER_EXPRESSION_TYPE_UNARYOP:
+    ( *instructions )++;
+    return compile_measure( exp->types.unaryop.op, instructions, variables,
+			    depth );
+
+  case DEBUGGER_EXPRESSION_TYPE_BINARYOP:
+    switch( exp->types.binaryop.operation ) {
+    case DEBUGGER_TOKEN_LOGICAL_AND:
+    case DEBUGGER_TOKEN_LOGICAL_OR:
+      ( *instructions ) += 2; break;
+    default:
+      ( *instructions )++; break;
+    }
+
+    error = compile_measure( exp->types.binaryop.op1, instructions, variables,
+			     depth );
+    if( error ) return error;
+
+    /* The first operand's value stays on the stack under the second */
+    ( *depth )++;
+    error = compile_measure( exp->types.binaryop.op2, instructions, variables,
+			     depth );
+    ( *depth )--;
+    return error;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown expression type %d", exp->type );
+  fuse_abort();
+}
+
+static program_opcode
+unaryop_opcode( int operation )
+{
+  switch( operation ) {
+
+  case '!': return PROGRAM_OPCODE_NOT;
+  case '~': return PROGRAM_OPCODE_COMPLEMENT;
+  case '-': return PROGRAM_OPCODE_NEGATE;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown unary operator %d", operation );
+  fuse_abort();
+}
+
+static program_opcode
+binaryop_opcode( int operation )
+{
+  switch( operation ) {
+
+  case '+': return PROGRAM_OPCODE_ADD;
+  case '-': return PROGRAM_OPCODE_SUBTRACT;
+  case '*': return PROGRAM_OPCODE_MULTIPLY;
+  case '/': return PROGRAM_OPCODE_DIVIDE;
+  case DEBUGGER_TOKEN_EQUAL_TO: return PROGRAM_OPCODE_EQUAL_TO;
+  case DEBUGGER_TOKEN_NOT_EQUAL_TO: return PROGRAM_OPCODE_NOT_EQUAL_TO;
+  case '<': return PROGRAM_OPCODE_LESS_THAN;
+  case '>': return PROGRAM_OPCODE_GREATER_THAN;
+  case DEBUGGER_TOKEN_LESS_THAN_OR_EQUAL_TO:
+    return PROGRAM_OPCODE_LESS_THAN_OR_EQUAL_TO;
+  case DEBUGGER_TOKEN_GREATER_THAN_OR_EQUAL_TO:
+    return PROGRAM_OPCODE_GREATER_THAN_OR_EQUAL_TO;
+  case '&': return PROGRAM_OPCODE_BITWISE_AND;
+  case '^': return PROGRAM_OPCODE_BITWISE_XOR;
+  case '|': return PROGRAM_OPCODE_BITWISE_OR;
+  case DEBUGGER_TOKEN_LOGICAL_AND: return PROGRAM_OPCODE_AND_THEN;
+  case DEBUGGER_TOKEN_LOGICAL_OR: return PROGRAM_OPCODE_OR_ELSE;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown binary operator %d", operation );
+  fuse_abort();
+}
+
+/* Append the instructions for 'exp' to 'code' at '*pc' */
+static void
+compile_expression( debugger_expression *exp, program_instruction *code,
+		    size_t *pc, char **variables )
+{
+  program_instruction *instruction;
+  size_t branch;
+
+  switch( exp->type ) {
+
+  case DEBUGGER_EXPRESSION_TYPE_INTEGER:
+    instruction = &code[ ( *pc )++ ];
+    instruction->opcode = PROGRAM_OPCODE_INTEGER;
+    instruction->operand.integer = exp->types.integer;
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_REGISTER:
+    instruction = &code[ ( *pc )++ ];
+    instruction->operand.byte = debugger_register_byte( exp->types.reg );
+    if( instruction->operand.byte ) {
+      instruction->opcode = PROGRAM_OPCODE_BYTE;
+      return;
+    }
+    instruction->operand.word = debugger_register_word( exp->types.reg );
+    if( instruction->operand.word ) {
+      instruction->opcode = PROGRAM_OPCODE_WORD;
+      return;
+    }
+    /* debugger_register_get() would give 0 for an unknown register */
+    instruction->opcode = PROGRAM_OPCODE_INTEGER;
+    instruction->operand.integer = 0;
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_UNARYOP:
+    compile_expression( exp->types.unaryop.op, code, pc, variables );
+    code[ ( *pc )++ ].opcode = unaryop_opcode( exp->types.unaryop.operation );
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_BINARYOP:
+    compile_expression( exp->types.binaryop.op1, code, pc, variables );
+
+    switch( exp->types.binaryop.operation ) {
+
+    case DEBUGGER_TOKEN_LOGICAL_AND:
+    case DEBUGGER_TOKEN_LOGICAL_OR:
+      branch = ( *pc )++;
+      code[ branch ].opcode =
+	binaryop_opcode( exp->types.binaryop.operation );
+      compile_expression( exp->types.binaryop.op2, code, pc, variables );
+      code[ ( *pc )++ ].opcode = PROGRAM_OPCODE_TRUTH;
+      code[ branch ].operand.target = *pc;
+      return;
+
+    default:
+      compile_expression( exp->types.binaryop.op2, code, pc, variables );
+      code[ ( *pc )++ ].opcode =
+	binaryop_opcode( exp->types.binaryop.operation );
+      return;
+
+    }
+
+  case DEBUGGER_EXPRESSION_TYPE_VARIABLE:
+    /* Variables are created by being set, so can only be looked up by
+       name when the program is run */
+    instruction = &code[ ( *pc )++ ];
+    instruction->opcode = PROGRAM_OPCODE_VARIABLE;
+    strcpy( *variables, exp->types.variable );
+    instruction->operand.variable = *variables;
+    *variables += strlen( exp->types.variable ) + 1;
+    return;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown expression type %d", exp->type );
+  fuse_abort();
+}
+
+void
+debugger_program_delete( debugger_program *program )
+{
+  free( program->variables );
+  free( program->code );
+  free( program );
+}
+
+libspectrum_dword
+debugger_program_run( const debugger_program *program )
+{
+  libspectrum_dword stack[ PROGRAM_STACK_SIZE ], *top = stack - 1;
+  const program_instruction *pc = program->code;
+
+  while( 1 ) {
+
+    switch( pc->opcode ) {
+
+    case PROGRAM_OPCODE_INTEGER: *++top = pc->operand.integer; break;
+    case PROGRAM_OPCODE_BYTE: *++top = *pc->operand.byte; break;
+    case PROGRAM_OPCODE_WORD: *++top = *pc->operand.word; break;
+    case PROGRAM_OPCODE_VARIABLE:
+      *++top = debugger_variable_get( pc->operand.variable ); break;
+
+    case PROGRAM_OPCODE_NOT: *top = !*top; break;
+    case PROGRAM_OPCODE_COMPLEMENT: *top = ~*top; break;
+    case PROGRAM_OPCODE_NEGATE: *top = -*top; break;
+
+    case PROGRAM_OPCODE_ADD: top--; *top = *top + top[1]; break;
+    case PROGRAM_OPCODE_SUBTRACT: top--; *top = *top - top[1]; break;
+    case PROGRAM_OPCODE_MULTIPLY: top--; *top = *top * top[1]; break;
+    case PROGRAM_OPCODE_DIVIDE: top--; *top = *top / top[1]; break;
+    case PROGRAM_OPCODE_EQUAL_TO: top--; *top = *top == top[1]; break;
+    case PROGRAM_OPCODE_NOT_EQUAL_TO: top--; *top = *top != top[1]; break;
+    case PROGRAM_OPCODE_LESS_THAN: top--; *top = *top < top[1]; break;
+    case PROGRAM_OPCODE_GREATER_THAN: top--; *top = *top > top[1]; break;
+    case PROGRAM_OPCODE_LESS_THAN_OR_EQUAL_TO:
+      top--; *top = *top <= top[1]; break;
+    case PROGRAM_OPCODE_GREATER_THAN_OR_EQUAL_TO:
+      top--; *top = *top >= top[1]; break;
+    case PROGRAM_OPCODE_BITWISE_AND: top--; *top = *top & top[1]; break;
+    case PROGRAM_OPCODE_BITWISE_XOR: top--; *top = *top ^ top[1]; break;
+    case PROGRAM_OPCODE_BITWISE_OR: top--; *top = *top | top[1]; break;
+
+    case PROGRAM_OPCODE_AND_THEN:
+      if( !*top ) { pc = &program->code[ pc->operand.target ]; continue; }
+      top--; break;
+
+    case PROGRAM_OPCODE_OR_ELSE:
+      if( *top ) {
+	*top = 1; pc = &program->code[ pc->operand.target ]; continue;
+      }
+      top--; break;
+
+    case PROGRAM_OPCODE_TRUTH: *top = !!*top; break;
+
+    case PROGRAM_OPCODE_END: return *top;
+
+    }
+
+    pc++;
+  }
+}
+
 int
 debugger_expression_deparse( char *buffer, size_t length,
 			     const debugger_expression *exp )
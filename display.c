@@ -31,11 +31,12 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "compat.h"
 #include "display.h"
 #include "event.h"
 #include "fuse.h"
 #include "machine.h"
-#include "screenshot.h"
+#include "movie.h"
 #include "settings.h"
 #include "spectrum.h"
 #include "ui/ui.h"
@@ -127,8 +128,78 @@ static struct border_change_t border_change_end_sentinel =
 /* The current border colour */
 int current_border[ DISPLAY_SCREEN_HEIGHT ][ DISPLAY_SCREEN_WIDTH_COLS ];
 
-static void display_dirty8( libspectrum_word address );
-static void display_dirty64( libspectrum_word address );
+/* A screen write, logged to be drawn once the frame is over */
+struct display_write_t {
+  libspectrum_dword tstates;
+  libspectrum_word offset;
+  libspectrum_byte data;
+};
+
+/* A part of a frame during which the screen page and SCLD mode stayed
+   the same */
+struct display_segment_t {
+  size_t first_write;		/* Index of its first write */
+  libspectrum_dword end;	/* When it ended, unless it was the last */
+  scld mode;
+  int refresh;			/* DISPLAY_REFRESH_* to do as it starts */
+  int has_screen;		/* Set if 'screen' holds the page as it
+				   started; otherwise carry on from the
+				   previous segment */
+  libspectrum_byte *screen;
+};
+
+#define DISPLAY_REFRESH_MAIN 1
+#define DISPLAY_REFRESH_ALL 2
+
+/* Everything needed to draw a frame once it has been emulated */
+typedef struct display_record_t {
+
+  struct border_change_t *border_changes;
+  int border_changes_last, border_changes_size;
+
+  /* Only used if screen writes are being logged */
+  struct display_write_t *writes;
+  size_t writes_count, writes_size;
+  struct display_segment_t *segments;
+  size_t segments_count, segments_size;
+
+  /* Set if the flash state changes once this frame has been drawn */
+  int flash_changed, flash_reversed;
+
+} display_record_t;
+
+/* The record of the frame being emulated; when drawing on another
+   thread, the other record is the one being drawn */
+static display_record_t display_records[2];
+static display_record_t *display_record = &display_records[0];
+
+/* Set if screen writes are being logged this frame rather than acted
+   on as they happen, and if so whether the frame is then drawn on
+   another thread */
+static int display_batch = 0, display_threaded = 0;
+
+/* Whether a segment is accepting writes, and what the next one to be
+   started needs */
+static int display_segment_open = 0, display_need_screen = 1,
+  display_need_refresh = 0;
+
+/* When logging, the screen page and SCLD mode being drawn from. These
+   and all the other state used for drawing belong to the drawing
+   thread, if there is one */
+static libspectrum_byte display_render_screen[ 0x4000 ];
+static scld display_render_scld;
+
+static compat_thread display_thread = NULL;
+static compat_semaphore display_render_idle, display_render_ready;
+static display_record_t *display_render_record;
+static int display_thread_exit;
+
+static void display_dirty8( libspectrum_dword when, libspectrum_word address );
+static void display_dirty64( libspectrum_dword when,
+			     libspectrum_word address );
+static void update_critical( libspectrum_dword when, int x, int y );
+static void display_refresh( int what );
+static void display_set_mode( void );
 
 static void display_get_attr( int x, int y,
 			      libspectrum_byte *ink, libspectrum_byte *paper);
@@ -138,26 +209,23 @@ static int end_line( int y );
 
 static void display_dirty_flashing(void);
 
-static int border_changes_last = 0;
-static struct border_change_t *border_changes = NULL;
-
 static struct border_change_t *
 alloc_change(void)
 {
-  static int border_changes_size = 0;
-
-  if( border_changes_size == border_changes_last ) {
-    border_changes_size += 10;
-    border_changes = realloc( border_changes,
-                              border_changes_size*
-                                sizeof( struct border_change_t )
-                            );
-    if( !border_changes ) {
+  display_record_t *record = display_record;
+
+  if( record->border_changes_size == record->border_changes_last ) {
+    record->border_changes_size += 10;
+    record->border_changes = realloc( record->border_changes,
+                                      record->border_changes_size*
+                                        sizeof( struct border_change_t )
+                                    );
+    if( !record->border_changes ) {
       ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
       fuse_abort();
     }
   }
-  return border_changes + border_changes_last++; 
+  return record->border_changes + record->border_changes_last++; 
 }
 
 static int
@@ -178,6 +246,8 @@ display_init( int *argc, char ***argv )
   int i, j, k, x, y;
   int error;
 
+  uidisplay_expand_init();
+
   if(ui_init(argc, argv))
     return 1;
 
@@ -210,13 +280,10 @@ display_init( int *argc, char ***argv )
 
   display_frame_count=0; display_flash_reversed=0;
 
+  display_set_mode();
   display_refresh_all();
 
-  border_changes_last = 0;
-  if( border_changes ) {
-    free( border_changes );
-  }
-  border_changes = NULL;
+  display_record->border_changes_last = 0;
   error = add_border_sentinel(); if( error ) return error;
   display_last_border = scld_last_dec.name.hires ?
                             display_hires_border : display_lores_border;
@@ -385,20 +452,33 @@ end_line( int y )
   return 0;
 }
 
-/* Mark as 'dirty' the pixels which have been changed by a write to
-   'offset' within the RAM page containing the screen */
-void
-display_dirty( libspectrum_word offset )
+/* The screen memory and SCLD mode which should be drawn from */
+static inline libspectrum_byte*
+display_screen( void )
 {
-  switch ( scld_last_dec.mask.scrnmode ) {
+  return display_batch ? display_render_screen : RAM[ memory_current_screen ];
+}
+
+static inline const scld*
+display_scld( void )
+{
+  return display_batch ? &display_render_scld : &scld_last_dec;
+}
+
+/* Mark as 'dirty' the pixels which have been changed by a write at
+   'when' to 'offset' within the RAM page containing the screen */
+static void
+display_dirty_at( libspectrum_dword when, libspectrum_word offset )
+{
+  switch ( display_scld()->mask.scrnmode ) {
 
     case STANDARD: /* standard Speccy screen */
     case HIRESATTR: /* strange mode */
       if( offset >= 0x1b00 ) break;
       if( offset <  0x1800 ) {		/* 0x1800 = first attributes byte */
-        display_dirty8( offset );
+        display_dirty8( when, offset );
       } else {
-        display_dirty64( offset );
+        display_dirty64( when, offset );
       }
       break;
 
@@ -406,9 +486,9 @@ display_dirty( libspectrum_word offset )
     case HIRESATTRALTD: /* strange mode using second screen */      
       if( offset < 0x2000 || offset >= 0x3b00 ) break;
       if( offset < 0x3800 ) {		/* 0x3800 = first attributes byte */
-        display_dirty8( offset - ALTDFILE_OFFSET );
+        display_dirty8( when, offset - ALTDFILE_OFFSET );
       } else {
-        display_dirty64( offset - ALTDFILE_OFFSET );
+        display_dirty64( when, offset - ALTDFILE_OFFSET );
       }
       break;
 
@@ -417,7 +497,7 @@ display_dirty( libspectrum_word offset )
       if( offset >= 0x3800 ) break;
       if( offset >= 0x1800 && offset < 0x2000 ) break;
       if( offset >= 0x2000 ) offset -= ALTDFILE_OFFSET;
-      display_dirty8( offset );
+      display_dirty8( when, offset );
       break;
 
     default:
@@ -426,11 +506,142 @@ display_dirty( libspectrum_word offset )
     /* case HIRESDOUBLECOL: hires mode, but data taken only from
        second screen */
       if( offset >= 0x2000 && offset < 0x3800 )
-	display_dirty8( offset - ALTDFILE_OFFSET );
+	display_dirty8( when, offset - ALTDFILE_OFFSET );
       break;
   }
 }
 
+static struct display_write_t*
+alloc_write( void )
+{
+  display_record_t *record = display_record;
+
+  if( record->writes_count == record->writes_size ) {
+    record->writes_size = record->writes_size ? 2 * record->writes_size
+                                              : 1024;
+    record->writes = realloc( record->writes,
+                              record->writes_size *
+                                sizeof( struct display_write_t ) );
+    if( !record->writes ) {
+      ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+      fuse_abort();
+    }
+  }
+  return record->writes + record->writes_count++;
+}
+
+/* Start a new segment of the frame as things stand now */
+static void
+open_segment( void )
+{
+  display_record_t *record = display_record;
+  struct display_segment_t *segment;
+
+  if( record->segments_count == record->segments_size ) {
+    size_t new_size = record->segments_size ? 2 * record->segments_size : 4;
+
+    segment = realloc( record->segments, new_size * sizeof( *segment ) );
+    if( !segment ) {
+      ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+      fuse_abort();
+    }
+    memset( &segment[ record->segments_size ], 0,
+            ( new_size - record->segments_size ) * sizeof( *segment ) );
+
+    record->segments = segment; record->segments_size = new_size;
+  }
+
+  segment = &record->segments[ record->segments_count++ ];
+
+  segment->first_write = record->writes_count;
+  segment->mode = scld_last_dec;
+  segment->refresh = display_need_refresh;
+  segment->has_screen = display_need_screen;
+
+  /* Only needed if the page may hold something other than what the
+     logged writes say it does */
+  if( display_need_screen ) {
+    if( !segment->screen ) {
+      segment->screen = malloc( sizeof( display_render_screen ) );
+      if( !segment->screen ) {
+        ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__,
+                  __LINE__ );
+        fuse_abort();
+      }
+    }
+    memcpy( segment->screen, RAM[ memory_current_screen ],
+            sizeof( display_render_screen ) );
+  }
+
+  display_segment_open = 1;
+  display_need_screen = display_need_refresh = 0;
+}
+
+/* End the current segment at 'when'; whatever comes next starts from
+   a fresh copy of the screen */
+static void
+close_segment( libspectrum_dword when )
+{
+  display_record->segments[ display_record->segments_count - 1 ].end = when;
+  display_segment_open = 0;
+  display_need_screen = 1;
+}
+
+/* Called before 'data' is written to 'offset' within the RAM page
+   containing the screen. When batching, just note the write for
+   replay_writes() to deal with later */
+void
+display_dirty( libspectrum_word offset, libspectrum_byte data )
+{
+  struct display_write_t *write;
+
+  if( !display_batch ) {
+    display_dirty_at( tstates, offset );
+    return;
+  }
+
+  if( !display_segment_open ) open_segment();
+
+  write = alloc_write();
+  write->tstates = tstates;
+  write->offset = offset;
+  write->data = data;
+}
+
+/* Replay a frame's logged screen writes in order, drawing each part of
+   the screen as it was when the beam passed it */
+static void
+replay_writes( display_record_t *record )
+{
+  struct display_segment_t *segment;
+  struct display_write_t *write, *end;
+  size_t i;
+
+  for( i = 0; i < record->segments_count; i++ ) {
+
+    segment = &record->segments[i];
+
+    if( segment->has_screen )
+      memcpy( display_render_screen, segment->screen,
+              sizeof( display_render_screen ) );
+    display_render_scld = segment->mode;
+    if( segment->refresh ) display_refresh( segment->refresh );
+
+    write = &record->writes[ segment->first_write ];
+    end = i + 1 < record->segments_count ?
+          &record->writes[ record->segments[ i + 1 ].first_write ] :
+          &record->writes[ record->writes_count ];
+
+    for( ; write < end; write++ ) {
+      display_dirty_at( write->tstates, write->offset );
+      display_render_screen[ write->offset ] = write->data;
+    }
+
+    /* Catch up to the point at which the next segment started */
+    if( i + 1 < record->segments_count ) update_critical( segment->end, 0, 0 );
+  }
+}
+
 /* Get the attribute byte or equivalent for the eight pixels starting at
    ( (8*x) , y ) */
 static inline libspectrum_byte
@@ -438,21 +649,23 @@ display_get_attr_byte( int x, int y )
 {
   libspectrum_byte attr;
 
-  if ( scld_last_dec.name.hires ) {
-    attr = hires_get_attr();
+  const scld *mode = display_scld();
+
+  if ( mode->name.hires ) {
+    attr = hires_convert_dec( mode->byte );
   } else {
 
     libspectrum_word offset;
 
-    if( scld_last_dec.name.b1 ) {
+    if( mode->name.b1 ) {
       offset = display_line_start[y] + x + ALTDFILE_OFFSET;
-    } else if( scld_last_dec.name.altdfile ) {
+    } else if( mode->name.altdfile ) {
       offset = display_attr_start[y] + x + ALTDFILE_OFFSET;
     } else {
       offset = display_attr_start[y] + x;
     }
 
-    attr = RAM[ memory_current_screen ][ offset ];
+    attr = display_screen()[ offset ];
   }
 
   return attr;
@@ -503,18 +716,20 @@ write_if_dirty( int x, int y )
   libspectrum_dword data, data2;
   libspectrum_dword mode_data;
   libspectrum_dword last_chunk_detail;
+  const scld *mode = display_scld();
 
   beam_x = x + DISPLAY_BORDER_WIDTH_COLS;
   beam_y = y + DISPLAY_BORDER_HEIGHT;
-  offset = display_get_addr( x, y );
+  offset = mode->name.altdfile ? display_line_start[y] + x + ALTDFILE_OFFSET :
+                                 display_line_start[y] + x;
 
   /* Read byte, atrr/byte, and screen mode */
-  screen = RAM[ memory_current_screen ];
+  screen = display_screen();
   data = screen[ offset ];
-  mode_data = scld_last_dec.byte;
+  mode_data = mode->byte;
 
-  if( scld_last_dec.name.hires ) {
-    switch( scld_last_dec.mask.scrnmode ) {
+  if( mode->name.hires ) {
+    switch( mode->mask.scrnmode ) {
 
     case HIRESATTRALTD:
       offset = display_attr_start[ y ] + x + ALTDFILE_OFFSET;
@@ -546,11 +761,14 @@ write_if_dirty( int x, int y )
   if( display_last_screen[ index ] != last_chunk_detail ) {
     libspectrum_byte ink, paper;
     display_get_attr( x, y, &ink, &paper );
-    if( scld_last_dec.name.hires ) {
+    if( mode->name.hires ) {
       libspectrum_word hires_data = (data << 8) + data2;
       uidisplay_plot16( beam_x, beam_y, hires_data, ink, paper );
+      if( movie_recording )
+        movie_chunk( beam_x, beam_y, hires_data, ink, paper, 1 );
     } else {
       uidisplay_plot8( beam_x, beam_y, data, ink, paper );
+      if( movie_recording ) movie_chunk( beam_x, beam_y, data, ink, paper, 0 );
     }
 
     /* Update last display record */
@@ -641,27 +859,42 @@ copy_critical_region( int beam_x, int beam_y )
 }
 
 inline static void
-get_beam_position( int *x, int *y )
+get_beam_position( libspectrum_dword when, int *x, int *y )
 {
-  if( tstates < machine_current->line_times[ 0 ] ) {
+  if( when < machine_current->line_times[ 0 ] ) {
     *x = *y = -1;
     return;
   }
 
-  *y = ( tstates - machine_current->line_times[ 0 ] ) /
+  *y = ( when - machine_current->line_times[ 0 ] ) /
     machine_current->timings.tstates_per_line;
 
   if( *y >= 0 && *y <= DISPLAY_SCREEN_HEIGHT )
-    *x = ( tstates - machine_current->line_times[ *y ] ) / 4;
+    *x = ( when - machine_current->line_times[ *y ] ) / 4;
   else *x = 0;
 }
 
+/* Called before anything other than a screen write changes what the
+   screen looks like */
 void
 display_update_critical( int x, int y )
+{
+  if( display_batch ) {
+    /* Note how things were up to now */
+    if( !display_segment_open ) open_segment();
+    close_segment( tstates );
+    return;
+  }
+
+  update_critical( tstates, x, y );
+}
+
+static void
+update_critical( libspectrum_dword when, int x, int y )
 {
   int beam_x, beam_y;
 
-  get_beam_position( &beam_x, &beam_y );
+  get_beam_position( when, &beam_x, &beam_y );
 
   beam_x -= DISPLAY_BORDER_WIDTH_COLS;
   beam_y -= DISPLAY_BORDER_HEIGHT;
@@ -687,39 +920,39 @@ display_update_critical( int x, int y )
 /* Mark the 8-pixel chunk at (x,y) as maybe dirty and update the critical
    region as appropriate */
 inline static void
-display_dirty_chunk( int x, int y )
+display_dirty_chunk( libspectrum_dword when, int x, int y )
 {
   /* If the write is between the start of the critical region and the
      current beam position, then we must copy the critical region now */
   if(   y >  critical_region_y                             ||
       ( y == critical_region_y && x >= critical_region_x )    ) {
 
-    display_update_critical( x, y );
+    update_critical( when, x, y );
   }
 
   display_maybe_dirty[y] |= ( (libspectrum_dword)1 << x );
 }
 
 static void
-display_dirty8( libspectrum_word offset )
+display_dirty8( libspectrum_dword when, libspectrum_word offset )
 {
   int x, y;
 
   x=display_dirty_xtable[ offset ];
   y=display_dirty_ytable[ offset ];
 
-  display_dirty_chunk( x, y );
+  display_dirty_chunk( when, x, y );
 }
 
 static void
-display_dirty64( libspectrum_word offset )
+display_dirty64( libspectrum_dword when, libspectrum_word offset )
 {
   int i, x, y;
 
   x=display_dirty_xtable2[ offset - 0x1800 ];
   y=display_dirty_ytable2[ offset - 0x1800 ];
 
-  for( i = 0; i < 8; i++ ) display_dirty_chunk( x, y + i );
+  for( i = 0; i < 8; i++ ) display_dirty_chunk( when, x, y + i );
 }
 
 /* Get the attributes for the eight pixels starting at
@@ -750,7 +983,7 @@ push_border_change( int colour )
   int beam_x, beam_y;
   struct border_change_t *change;
 
-  get_beam_position( &beam_x, &beam_y );
+  get_beam_position( tstates, &beam_x, &beam_y );
 
   if( beam_y >= DISPLAY_SCREEN_HEIGHT ) return;
 
@@ -809,6 +1042,7 @@ set_border( int y, int start, int end, int colour )
     data and mode will have been the same */
     if( display_last_screen[ index ] != chunk_detail ) {
       uidisplay_plot8( start, y, 0xff, colour, 0 );
+      if( movie_recording ) movie_chunk( start, y, 0xff, colour, 0, 0 );
 
       /* Update last display record */
       display_last_screen[ index ] = chunk_detail;
@@ -891,24 +1125,14 @@ do_border_change( struct border_change_t *first,
 /* Take account of all the border colour changes which happened in this
    frame */
 static void
-update_border( void )
+update_border( display_record_t *record )
 {
   int pos;
-  int error;
 
-  /* Put the final sentinel onto the list */
-  struct border_change_t *end_sentinel = alloc_change();
-
-  memcpy( end_sentinel, &border_change_end_sentinel,
-          sizeof( struct border_change_t ) );
-
-  for( pos = 0; pos < border_changes_last-1; pos++ ) {
-    do_border_change( border_changes+pos, border_changes+pos+1 );
+  for( pos = 0; pos < record->border_changes_last-1; pos++ ) {
+    do_border_change( record->border_changes+pos,
+                      record->border_changes+pos+1 );
   }
-
-  border_changes_last = 0;
-
-  error = add_border_sentinel(); if( error ) return;
 }
 
 /* Send the updated screen to the UI-specific code */
@@ -920,7 +1144,12 @@ update_ui_screen( void )
   size_t i;
   struct rectangle *ptr;
 
-  if( settings_current.frame_rate <= ++frame_count ) {
+  /* In turbo mode, most frames are never seen, so show far fewer of
+     them; the dirty rectangles just accumulate until we do */
+  int frame_rate = settings_current.turbo ? settings_current.turbo_frameskip
+                                          : settings_current.frame_rate;
+
+  if( frame_rate <= ++frame_count ) {
     frame_count = 0;
 
     if( display_redraw_all ) {
@@ -943,99 +1172,218 @@ update_ui_screen( void )
   }
 }
 
-int
-display_frame( void )
+/* Draw whatever of a frame has not yet been drawn and send it to the
+   UI-specific code */
+static void
+display_frame_render( display_record_t *record )
 {
+  if( display_batch ) replay_writes( record );
+
   /* Copy all the critical region to the display */
   copy_critical_region( DISPLAY_WIDTH_COLS, DISPLAY_HEIGHT - 1 );
   critical_region_x = critical_region_y = 0;
 
-  update_border();
+  update_border( record );
+  if( movie_recording ) movie_frame();
   update_dirty_rects();
   update_ui_screen();
 
-  if( screenshot_movie_record == 1 ) {
+  if( record->flash_changed ) {
+    display_flash_reversed = record->flash_reversed;
+    display_dirty_flashing();
+  }
+}
 
-    snprintf( screenshot_movie_name, SCREENSHOT_MOVIE_FILE_MAX,
-              "%s-frame-%09ld.scr", screenshot_movie_file,
-              screenshot_movie_frame++ );
-    screenshot_scr_write( screenshot_movie_name );
+static int
+display_thread_run( void *data GCC_UNUSED )
+{
+  while( 1 ) {
+    compat_semaphore_wait( display_render_ready );
+    if( display_thread_exit ) break;
 
-#ifdef USE_LIBPNG
+    display_frame_render( display_render_record );
 
-  } else if( screenshot_movie_record == 2 ) {
+    compat_semaphore_post( display_render_idle );
+  }
 
-    snprintf( screenshot_movie_name, SCREENSHOT_MOVIE_FILE_MAX,
-              "%s-frame-%09ld.png", screenshot_movie_file,
-              screenshot_movie_frame++ );
-    screenshot_write_fast( screenshot_movie_name, screenshot_movie_scaler );
+  return 0;
+}
 
-#endif                          /* #ifdef USE_LIBPNG */
+/* Wait for the drawing thread, if any, to finish the last frame given
+   to it */
+void
+display_wait( void )
+{
+  if( !display_thread ) return;
 
+  compat_semaphore_wait( display_render_idle );
+  compat_semaphore_post( display_render_idle );
+}
+
+/* Pick up any change in how frames should be drawn; only done between
+   frames */
+static void
+display_set_mode( void )
+{
+  int batch = ( settings_current.display_batch ||
+                settings_current.display_thread ) &&
+              !settings_current.headless;
+  int threaded = batch && settings_current.display_thread;
+
+  if( threaded && !display_thread ) {
+    display_render_idle = compat_semaphore_create( 1 );
+    display_render_ready = compat_semaphore_create( 0 );
+    display_thread_exit = 0;
+    if( display_render_idle && display_render_ready )
+      display_thread = compat_thread_create( display_thread_run, NULL );
+    if( !display_thread ) {
+      if( display_render_idle ) compat_semaphore_destroy( display_render_idle );
+      if( display_render_ready )
+        compat_semaphore_destroy( display_render_ready );
+      threaded = 0;
+    }
   }
 
+  if( batch == display_batch && threaded == display_threaded ) return;
+
+  /* Nothing may be drawn from this thread while the other one is */
+  display_wait();
+
+  /* Whatever was last drawn from may be out of date */
+  if( batch && !display_batch ) display_need_screen = 1;
+
+  display_batch = batch; display_threaded = threaded;
+}
+
+int
+display_frame( void )
+{
+  display_record_t *record = display_record;
+  struct border_change_t *end_sentinel;
+
+  if( display_batch ) {
+    /* Make sure what was last drawn from is the page as it is now if
+       that may not follow from the writes */
+    if( !display_segment_open &&
+        ( display_need_screen || display_need_refresh ) )
+      open_segment();
+    display_segment_open = 0;
+  }
+
+  /* Put the final sentinel onto the list of border changes */
+  end_sentinel = alloc_change();
+  memcpy( end_sentinel, &border_change_end_sentinel,
+          sizeof( struct border_change_t ) );
+
   display_frame_count++;
+  record->flash_changed = 0;
   if(display_frame_count==16) {
-    display_flash_reversed=1;
-    display_dirty_flashing();
+    record->flash_changed = 1; record->flash_reversed = 1;
   } else if(display_frame_count==32) {
-    display_flash_reversed=0;
-    display_dirty_flashing();
+    record->flash_changed = 1; record->flash_reversed = 0;
     display_frame_count=0;
   }
-  
+
+  if( display_threaded ) {
+    compat_semaphore_wait( display_render_idle );
+    display_render_record = record;
+    compat_semaphore_post( display_render_ready );
+
+    display_record = record == &display_records[0] ? &display_records[1]
+                                                   : &display_records[0];
+  } else {
+    display_frame_render( record );
+  }
+
+  display_record->border_changes_last = 0;
+  display_record->writes_count = display_record->segments_count = 0;
+  add_border_sentinel();
+
+  display_set_mode();
+
   return 0;
 }
 
+/* Forget everything recorded for this frame without drawing it, as
+   when running headless; otherwise the border changes just keep piling
+   up */
+void
+display_skip_frame( void )
+{
+  display_segment_open = 0;
+  critical_region_x = critical_region_y = 0;
+
+  display_record->border_changes_last = 0;
+  display_record->writes_count = display_record->segments_count = 0;
+  add_border_sentinel();
+}
+
+void
+display_end( void )
+{
+  if( !display_thread ) return;
+
+  display_wait();
+  display_thread_exit = 1;
+  compat_semaphore_post( display_render_ready );
+  compat_thread_join( display_thread );
+  display_thread = NULL;
+
+  compat_semaphore_destroy( display_render_idle );
+  compat_semaphore_destroy( display_render_ready );
+
+  display_threaded = 0;
+}
+
 static void display_dirty_flashing(void)
 {
   libspectrum_word offset;
   libspectrum_byte *screen, attr;
 
-  screen = RAM[ memory_current_screen ];
+  const scld *mode = display_scld();
+
+  screen = display_screen();
   
-  if( !scld_last_dec.name.hires ) {
-    if( scld_last_dec.name.b1 ) {
+  if( !mode->name.hires ) {
+    if( mode->name.b1 ) {
 
       for( offset = ALTDFILE_OFFSET; offset < 0x3800; offset++ ) {
         attr = screen[ offset ];
-        if( attr & 0x80 ) display_dirty8( offset - ALTDFILE_OFFSET );
+        if( attr & 0x80 ) display_dirty8( 0, offset - ALTDFILE_OFFSET );
       }
 
-    } else if( scld_last_dec.name.altdfile ) {
+    } else if( mode->name.altdfile ) {
 
       for( offset= 0x3800; offset < 0x3b00; offset++ ) {
         attr = screen[ offset ];
-        if( attr & 0x80 ) display_dirty64( offset - ALTDFILE_OFFSET );
+        if( attr & 0x80 )
+          display_dirty64( 0, offset - ALTDFILE_OFFSET );
       }
 
     } else { /* Standard Speccy screen */
 
       for( offset = 0x1800; offset < 0x1b00; offset++ ) {
         attr = screen[ offset ];
-        if( attr & 0x80 ) display_dirty64( offset );
+        if( attr & 0x80 ) display_dirty64( 0, offset );
       }
 
     }
   }
 }
 
-void display_refresh_main_screen(void)
+/* Mark the main screen, or everything, as needing to be redrawn */
+static void
+display_refresh( int what )
 {
   size_t i;
 
   for( i = 0; i < DISPLAY_HEIGHT; i++ )
     display_maybe_dirty[i] = display_all_dirty;
-}
 
-void display_refresh_all(void)
-{
-  size_t i;
+  if( what != DISPLAY_REFRESH_ALL ) return;
 
   display_redraw_all = 1;
 
-  display_refresh_main_screen();
-
   for( i = 0; i < DISPLAY_SCREEN_HEIGHT; i++ )
     display_is_dirty[i] = display_all_dirty;
 
@@ -1044,6 +1392,34 @@ void display_refresh_all(void)
           * sizeof(libspectrum_dword) );
 }
 
+/* When logging, memory may have changed in ways the log doesn't know
+   about, so also start drawing from a fresh copy of the screen */
+static void
+display_refresh_logged( int what )
+{
+  if( display_segment_open ) close_segment( tstates );
+  display_need_screen = 1;
+  if( display_need_refresh < what ) display_need_refresh = what;
+}
+
+void display_refresh_main_screen(void)
+{
+  if( display_batch ) {
+    display_refresh_logged( DISPLAY_REFRESH_MAIN );
+  } else {
+    display_refresh( DISPLAY_REFRESH_MAIN );
+  }
+}
+
+void display_refresh_all(void)
+{
+  if( display_batch ) {
+    display_refresh_logged( DISPLAY_REFRESH_ALL );
+  } else {
+    display_refresh( DISPLAY_REFRESH_ALL );
+  }
+}
+
 /* Fetch pixel (x, y). On a Timex this will be a point on a 640x480 canvas,
    on a Sinclair/Amstrad/Russian clone this will be a point on a 320x240
    canvas */
@@ -75,7 +75,7 @@ extern libspectrum_word display_attr_start[ DISPLAY_HEIGHT ];
 int display_init(int *argc, char ***argv);
 void display_line(void);
 
-void display_dirty( libspectrum_word offset );
+void display_dirty( libspectrum_word offset, libspectrum_byte data );
 
 void display_parse_attr( libspectrum_byte attr, libspectrum_byte *ink,
 			 libspectrum_byte *paper );
@@ -85,6 +85,9 @@ void display_set_hires_border(int colour);
 int display_dirty_border(void);
 
 int display_frame(void);
+void display_skip_frame( void );
+void display_wait( void );
+void display_end( void );
 void display_refresh_main_screen(void);
 void display_refresh_all(void);
 
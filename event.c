@@ -25,11 +25,13 @@
 
 #include <config.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <libspectrum.h>
 
 #include "event.h"
+#include "hostprofile.h"
 #include "ui/ui.h"
 
 /* A large value to mean `no events due' */
@@ -38,11 +40,31 @@ static const libspectrum_dword event_no_events = 0xffffffff;
 /* When will the next event happen? */
 libspectrum_dword event_next_event;
 
-/* The actual list of events */
-static GSList *event_list = NULL;
+/* An entry in the event queue. Times are stored relative to a running
+   epoch rather than the start of the current frame, so the end of
+   frame processing doesn't need to touch every entry */
+typedef struct event_entry_t {
+  libspectrum_qword time;	/* tstates + event_epoch */
+  int order;			/* The type when added; breaks ties on time */
+  libspectrum_dword sequence;	/* Breaks ties on time and order */
+  event_t event;
+} event_entry_t;
 
-/* An event ready to be reused */
-static event_t *event_free = NULL;
+/* The actual queue of events: a binary heap with the next event to
+   occur at index 0 */
+static event_entry_t *event_queue = NULL;
+static size_t event_queue_count = 0, event_queue_size = 0;
+
+/* How many entries to allocate initially; enough that we should never
+   have to grow the queue in normal use */
+static const size_t EVENT_QUEUE_INITIAL_SIZE = 64;
+
+/* How many tstates have been removed by event_frame() since the last
+   reset */
+static libspectrum_qword event_epoch = 0;
+
+/* The sequence number for the next event added */
+static libspectrum_dword event_sequence = 0;
 
 /* A null event */
 int event_type_null;
@@ -52,13 +74,17 @@ typedef struct event_descriptor_t {
   char *description;
 } event_descriptor_t; 
 
-typedef struct event_typeuser_t {
-  int type;
-  gpointer data;
-} event_typeuser_t;
-
 static GArray *registered_events;
 
+/* A copy of the queue as it was when a rewind entry was taken */
+struct event_state {
+  event_entry_t *queue;
+  size_t count, size;
+  libspectrum_qword epoch;
+};
+
+static int event_queue_grow( void );
+
 int
 event_init( void )
 {
@@ -68,6 +94,11 @@ event_init( void )
     return 1;
   }
 
+  if( event_queue_grow() ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d\n", __FILE__, __LINE__ );
+    return 1;
+  }
+
   event_type_null = event_register( NULL, "[Deleted event]" );
   if( event_type_null == -1 ) return 1;
 
@@ -92,39 +123,98 @@ event_register( event_fn_t fn, const char *description )
   return registered_events->len - 1;
 }
 
-static gint
-event_add_cmp( gconstpointer a1, gconstpointer b1 )
+/* Should event 'a' happen before event 'b'? Events are ordered by
+   time, then by type; of two otherwise identical events, the one added
+   most recently happens first */
+static int
+event_before( const event_entry_t *a, const event_entry_t *b )
+{
+  if( a->time != b->time ) return a->time < b->time;
+  if( a->order != b->order ) return a->order < b->order;
+  return (libspectrum_signed_dword)( a->sequence - b->sequence ) > 0;
+}
+
+static int
+event_queue_grow( void )
+{
+  size_t new_size;
+  event_entry_t *new_queue;
+
+  new_size = event_queue_size ? 2 * event_queue_size
+                              : EVENT_QUEUE_INITIAL_SIZE;
+
+  new_queue = realloc( event_queue, new_size * sizeof( *new_queue ) );
+  if( !new_queue ) return 1;
+
+  event_queue = new_queue;
+  event_queue_size = new_size;
+
+  return 0;
+}
+
+static void
+event_sift_up( size_t i )
+{
+  event_entry_t entry = event_queue[i];
+
+  while( i > 0 ) {
+    size_t parent = ( i - 1 ) / 2;
+    if( !event_before( &entry, &event_queue[ parent ] ) ) break;
+    event_queue[i] = event_queue[ parent ];
+    i = parent;
+  }
+
+  event_queue[i] = entry;
+}
+
+static void
+event_sift_down( size_t i )
 {
-  const event_t *a = a1, *b = b1;
+  event_entry_t entry = event_queue[i];
+
+  while( 1 ) {
+    size_t child = 2 * i + 1;
+    if( child >= event_queue_count ) break;
+    if( child + 1 < event_queue_count &&
+        event_before( &event_queue[ child + 1 ], &event_queue[ child ] ) )
+      child++;
+    if( !event_before( &event_queue[ child ], &entry ) ) break;
+    event_queue[i] = event_queue[ child ];
+    i = child;
+  }
 
-  return a->tstates != b->tstates ? a->tstates - b->tstates
-		                  : a->type - b->type;
+  event_queue[i] = entry;
+}
+
+static void
+event_update_next_event( void )
+{
+  event_next_event = event_queue_count ?
+    (libspectrum_dword)( event_queue[0].time - event_epoch ) :
+    event_no_events;
 }
 
 /* Add an event at the correct place in the event list */
 int
 event_add_with_data( libspectrum_dword event_time, int type, void *user_data )
 {
-  event_t *ptr;
-
-  if( event_free ) {
-    ptr = event_free;
-    event_free = NULL;
-  } else {
-    ptr = malloc( sizeof( *ptr ) );
-    if( !ptr ) return 1;
-  }
+  event_entry_t *entry;
+
+  if( event_queue_count == event_queue_size && event_queue_grow() )
+    return 1;
 
-  ptr->tstates = event_time;
-  ptr->type =type;
-  ptr->user_data = user_data;
+  entry = &event_queue[ event_queue_count ];
 
-  if( event_time < event_next_event ) {
-    event_next_event = event_time;
-    event_list = g_slist_prepend( event_list, ptr );
-  } else {
-    event_list = g_slist_insert_sorted( event_list, ptr, event_add_cmp );
-  }
+  entry->time = event_epoch + event_time;
+  entry->order = type;
+  entry->sequence = event_sequence++;
+  entry->event.tstates = event_time;
+  entry->event.type = type;
+  entry->event.user_data = user_data;
+
+  event_sift_up( event_queue_count++ );
+
+  if( event_time < event_next_event ) event_next_event = event_time;
 
   return 0;
 }
@@ -133,51 +223,37 @@ event_add_with_data( libspectrum_dword event_time, int type, void *user_data )
 int
 event_do_events( void )
 {
-  event_t *ptr;
+  event_t event;
 
   while(event_next_event <= tstates) {
-    ptr = event_list->data;
+    event = event_queue[0].event;
+    event.tstates = event_next_event;
     event_descriptor_t descriptor =
-      g_array_index( registered_events, event_descriptor_t, ptr->type );
-
-    /* Remove the event from the list *before* processing */
-    event_list = g_slist_remove( event_list, ptr );
+      g_array_index( registered_events, event_descriptor_t, event.type );
 
-    if( event_list == NULL ) {
-      event_next_event = event_no_events;
-    } else {
-      event_next_event = ((event_t*)(event_list->data))->tstates;
+    /* Remove the event from the queue *before* processing */
+    if( --event_queue_count ) {
+      event_queue[0] = event_queue[ event_queue_count ];
+      event_sift_down( 0 );
     }
+    event_update_next_event();
 
-    if( descriptor.fn ) descriptor.fn( ptr->tstates, ptr->type, ptr->user_data );
-
-    if( event_free ) {
-      free( ptr );
-    } else {
-      event_free = ptr;
+    if( descriptor.fn ) {
+      HOSTPROFILE_ENTER( HOSTPROFILE_EVENT( event.type ) );
+      descriptor.fn( event.tstates, event.type, event.user_data );
+      HOSTPROFILE_LEAVE();
     }
   }
 
   return 0;
 }
 
-static void
-event_reduce_tstates( gpointer data, gpointer user_data )
-{
-  event_t *ptr = data;
-  libspectrum_dword *tstates_per_frame = user_data;
-
-  ptr->tstates -= *tstates_per_frame;
-}
-
 /* Called at end of frame to reduce T-state count of all entries */
 int
 event_frame( libspectrum_dword tstates_per_frame )
 {
-  g_slist_foreach( event_list, event_reduce_tstates, &tstates_per_frame );
-
-  event_next_event = event_list ?
-    ((event_t*)(event_list->data))->tstates : event_no_events;
+  event_epoch += tstates_per_frame;
+  event_update_next_event();
 
   return 0;
 }
@@ -201,74 +277,163 @@ event_force_events( void )
   return 0;
 }
 
-static void
-set_event_null( gpointer data, gpointer user_data )
+/* Remove all events of a specific type from the stack */
+int
+event_remove_type( int type )
 {
-  event_t *ptr = data;
-  int *type = user_data;
+  size_t i;
+
+  for( i = 0; i < event_queue_count; i++ )
+    if( event_queue[i].event.type == type )
+      event_queue[i].event.type = event_type_null;
 
-  if( ptr->type == *type ) ptr->type = event_type_null;
+  return 0;
 }
 
-static void
-set_event_null_2( gpointer data, gpointer user_data )
+/* Remove all events of a specific type and user data from the stack */
+int
+event_remove_type_user_data( int type, gpointer user_data )
 {
-  event_t *ptr = data;
-  event_typeuser_t *e = user_data;
+  size_t i;
 
-  if( ptr->type == e->type && ptr->user_data == e->data )
-    ptr->type = event_type_null;
+  for( i = 0; i < event_queue_count; i++ )
+    if( event_queue[i].event.type == type &&
+        event_queue[i].event.user_data == user_data )
+      event_queue[i].event.type = event_type_null;
+
+  return 0;
 }
 
-/* Remove all events of a specific type from the stack */
+/* Clear the event stack */
 int
-event_remove_type( int type )
+event_reset( void )
 {
-  g_slist_foreach( event_list, set_event_null, &type );
+  event_queue_count = 0;
+  event_epoch = 0;
+
+  event_next_event = event_no_events;
+
   return 0;
 }
 
-/* Remove all events of a specific type and user data from the stack */
+static int
+event_foreach_cmp( const void *a1, const void *b1 )
+{
+  const event_entry_t *a = *(const event_entry_t* const*)a1,
+                      *b = *(const event_entry_t* const*)b1;
+
+  return event_before( a, b ) ? -1 : event_before( b, a );
+}
+
+/* Call a user-supplied function for every event in the current list,
+   in the order in which they will occur */
 int
-event_remove_type_user_data( int type, gpointer user_data )
+event_foreach( GFunc function, gpointer user_data )
 {
-  event_typeuser_t e;
+  event_entry_t **sorted;
+  size_t i;
+
+  if( !event_queue_count ) return 0;
+
+  sorted = malloc( event_queue_count * sizeof( *sorted ) );
+  if( !sorted ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d\n", __FILE__, __LINE__ );
+    return 1;
+  }
+
+  for( i = 0; i < event_queue_count; i++ ) {
+    sorted[i] = &event_queue[i];
+    sorted[i]->event.tstates = sorted[i]->time - event_epoch;
+  }
+
+  qsort( sorted, event_queue_count, sizeof( *sorted ), event_foreach_cmp );
+
+  for( i = 0; i < event_queue_count; i++ )
+    function( &sorted[i]->event, user_data );
+
+  free( sorted );
 
-  e.type = type;
-  e.data = user_data;
-  g_slist_foreach( event_list, set_event_null_2, &e );
   return 0;
 }
 
-/* Free the memory used by a specific entry */
-static void
-event_free_entry( gpointer data, gpointer user_data GCC_UNUSED )
+/* Take a copy of the running queue for rewind; returns NULL if out of
+   memory */
+event_state*
+event_state_copy( void )
 {
-  free( data );
+  event_state *state;
+
+  state = malloc( sizeof( *state ) );
+  if( state )
+    state->queue = malloc( event_queue_count ?
+                           event_queue_count * sizeof( *state->queue ) :
+                           sizeof( *state->queue ) );
+  if( !state || !state->queue ) {
+    free( state );
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d\n", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  memcpy( state->queue, event_queue,
+          event_queue_count * sizeof( *state->queue ) );
+  state->count = state->size = event_queue_count;
+  state->epoch = event_epoch;
+
+  return state;
 }
 
-/* Clear the event stack */
+/* Put back the events of the 'count' types listed in 'types' from a
+   copy taken by event_state_copy(); events of any other type are left
+   as they are, at the same point in the frame */
 int
-event_reset( void )
+event_state_restore_types( const event_state *state, const int *types,
+                           size_t count )
 {
-  g_slist_foreach( event_list, event_free_entry, NULL );
-  g_slist_free( event_list );
-  event_list = NULL;
+  size_t i, j, kept = 0;
 
-  event_next_event = event_no_events;
+  while( event_queue_size < event_queue_count + state->count )
+    if( event_queue_grow() ) {
+      ui_error( UI_ERROR_ERROR, "out of memory at %s:%d\n", __FILE__,
+                __LINE__ );
+      return 1;
+    }
+
+  for( i = 0; i < event_queue_count; i++ ) {
+    for( j = 0; j < count && event_queue[i].event.type != types[j]; j++ )
+      ;
+    if( j < count ) continue;
+    event_queue[ kept ] = event_queue[i];
+    event_queue[ kept ].time += state->epoch - event_epoch;
+    kept++;
+  }
+
+  for( i = 0; i < state->count; i++ ) {
+    for( j = 0; j < count && state->queue[i].event.type != types[j]; j++ )
+      ;
+    if( j < count ) event_queue[ kept++ ] = state->queue[i];
+  }
 
-  free( event_free );
-  event_free = NULL;
+  /* The running sequence number is already past any in the copy */
+  event_queue_count = kept;
+  event_epoch = state->epoch;
+  for( i = 1; i < event_queue_count; i++ ) event_sift_up( i );
+  event_update_next_event();
 
   return 0;
 }
 
-/* Call a user-supplied function for every event in the current list */
-int
-event_foreach( GFunc function, gpointer user_data )
+/* How much memory does a copied queue use? */
+size_t
+event_state_size( const event_state *state )
 {
-  g_slist_foreach( event_list, function, user_data );
-  return 0;
+  return sizeof( *state ) + state->size * sizeof( *state->queue );
+}
+
+void
+event_state_free( event_state *state )
+{
+  free( state->queue );
+  free( state );
 }
 
 /* A textual representation of each event type */
@@ -282,5 +447,13 @@ event_name( int type )
 int
 event_end( void )
 {
-  return event_reset();
+  int error;
+
+  error = event_reset(); if( error ) return error;
+
+  free( event_queue );
+  event_queue = NULL;
+  event_queue_size = 0;
+
+  return 0;
 }
@@ -91,4 +91,13 @@ const char *event_name( int type );
 /* Called on exit to clean up */
 int event_end(void);
 
+/* A copy of the event queue, as kept with each rewind entry */
+typedef struct event_state event_state;
+
+event_state* event_state_copy( void );
+int event_state_restore_types( const event_state *state, const int *types,
+                               size_t count );
+size_t event_state_size( const event_state *state );
+void event_state_free( event_state *state );
+
 #endif				/* #ifndef FUSE_EVENT_H */
@@ -52,6 +52,8 @@
 #include "divide.h"
 #include "event.h"
 #include "fuse.h"
+#include "headless.h"
+#include "hostprofile.h"
 #include "if1.h"
 #include "if2.h"
 #include "joystick.h"
@@ -59,10 +61,12 @@
 #include "kempmouse.h"
 #include "machine.h"
 #include "memory.h"
+#include "movie.h"
 #include "pokefinder/pokefinder.h"
 #include "printer.h"
 #include "profile.h"
 #include "psg.h"
+#include "rewind.h"
 #include "rzx.h"
 #include "scld.h"
 #include "settings.h"
@@ -162,10 +166,17 @@ int main(int argc, char **argv)
 
   if( settings_current.unittests ) {
     r = unittests_run();
+  } else if( settings_current.headless ) {
+    r = headless_run();
   } else {
     while( !fuse_exiting ) {
+      HOSTPROFILE_ENTER( HOSTPROFILE_Z80 );
       z80_do_opcodes();
+      HOSTPROFILE_LEAVE();
+
+      HOSTPROFILE_ENTER( HOSTPROFILE_EVENTS );
       event_do_events();
+      HOSTPROFILE_LEAVE();
     }
     r = 0;
   }
@@ -208,6 +219,8 @@ static int fuse_init(int argc, char **argv)
     return 0;
   }
 
+  if( headless_init() ) return 1;
+
   start_scaler = strdup( settings_current.start_scaler_mode );
   if( !start_scaler ) {
     ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__, __LINE__ );
@@ -262,6 +275,10 @@ static int fuse_init(int argc, char **argv)
   if( printer_init() ) return 1;
   if( rzx_init() ) return 1;
   if( psg_init() ) return 1;
+  if( movie_init() ) return 1;
+#ifdef HOST_PROFILE
+  if( hostprofile_init() ) return 1;
+#endif				/* #ifdef HOST_PROFILE */
   if( beta_init() ) return 1;
   if( plusd_init() ) return 1;
   if( fdd_init_events() ) return 1;
@@ -276,6 +293,7 @@ static int fuse_init(int argc, char **argv)
   if( ay_init() ) return 1;
   if( slt_init() ) return 1;
   if( profile_init() ) return 1;
+  if( rewind_init() ) return 1;
   if( kempmouse_init() ) return 1;
 
   error = pokefinder_clear(); if( error ) return error;
@@ -401,6 +419,10 @@ static void fuse_show_help( void )
    "--auto-load            Automatically load tape files when opened.\n"
    "--beeper-stereo        Add fake stereo to beeper emulation.\n"
    "--compress-rzx         Write RZX files out compressed.\n"
+   "--display-batch        Log screen writes and draw them at the end of\n"
+   "                       each frame rather than as they happen.\n"
+   "--display-thread       Draw each frame on a separate thread while the\n"
+   "                       next one is emulated; implies --display-batch.\n"
    "--double-screen        Write screenshots out as double size.\n"
    "--issue2               Emulate an Issue 2 Spectrum.\n"
    "--kempston             Emulate the Kempston joystick on QAOP<space>.\n"
@@ -409,16 +431,29 @@ static void fuse_show_help( void )
    "--sound                Produce sound.\n"
    "--sound-force-8bit     Generate 8-bit sound even if 16-bit is available.\n"
    "--slt                  Turn SLT traps on.\n"
-   "--traps                Turn tape traps on.\n\n"
+   "--traps                Turn tape traps on.\n"
+   "--turbo                Run as fast as possible, showing only some frames\n"
+   "                       and producing no sound.\n\n"
    "Other options:\n\n"
+   "--frames <count>       Stop after <count> frames when running headless.\n"
+   "--headless             Run without display, sound or speed throttling and\n"
+   "                       report emulation speed on exit.\n"
    "--help                 This information.\n"
    "--machine <type>       Which machine should be emulated?\n"
    "--playback <filename>  Play back RZX file <filename>.\n"
    "--record <filename>    Record to RZX file <filename>.\n"
+   "--rewind-frames <n>    Store a state to rewind to every <n> frames.\n"
+   "--rewind-size <MB>     Use at most <MB> megabytes for rewinding; 0 to\n"
+   "                       turn rewinding off.\n"
+   "--rzx-flush <n>        Write RZX recordings out every <n> frames rather\n"
+   "                       than at the end; disables rollback.\n"
+   "--rzx-verify <dir>     Play back every RZX file in <dir> headless and\n"
+   "                       report on each.\n"
    "--snapshot <filename>  Load snapshot <filename>.\n"
    "--speed <percentage>   How fast should emulation run?\n"
    "--svga-mode <mode>     Which mode should be used for SVGAlib?\n"
    "--tape <filename>      Open tape file <filename>.\n"
+   "--turbo-frameskip <n>  Show only every <n>th frame in turbo mode.\n"
    "--version              Print version number and exit.\n\n" );
 }
 
@@ -764,6 +799,9 @@ do_start_files( start_files_t *start_files )
 /* Tidy-up function called at end of emulation */
 static int fuse_end(void)
 {
+  /* Stop drawing before anything used to draw goes away */
+  display_end();
+
   /* Must happen before memory is deallocated as we read the character
      set from memory for the text output */
   printer_end();
@@ -773,6 +811,11 @@ static int fuse_end(void)
   settings_end();
 
   psg_end();
+  movie_end();
+#ifdef HOST_PROFILE
+  hostprofile_end();
+#endif				/* #ifdef HOST_PROFILE */
+  rewind_end();
   rzx_end();
   debugger_end();
   simpleide_end();
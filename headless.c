@@ -0,0 +1,293 @@
+/* headless.c: run the emulation core with no user interface
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <config.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libspectrum.h>
+
+#include "compat.h"
+#include "display.h"
+#include "event.h"
+#include "fuse.h"
+#include "headless.h"
+#include "machine.h"
+#include "memory.h"
+#include "rzx.h"
+#include "settings.h"
+#include "spectrum.h"
+#include "timer/timer.h"
+#include "ui/ui.h"
+#include "z80/z80.h"
+#include "z80/z80_macros.h"
+
+/* The number of frames and tstates emulated since headless_run() was
+   called */
+static libspectrum_dword headless_frame_count;
+static libspectrum_qword headless_tstates;
+
+/* Must be called before the machine is selected so that the sound
+   device is never opened */
+int
+headless_init( void )
+{
+  /* Verifying .rzx files is always done headless */
+  if( settings_current.rzx_verify ) settings_current.headless = 1;
+
+  if( !settings_current.headless ) return 0;
+
+  settings_current.sound = 0;
+
+  return 0;
+}
+
+/* Run the emulation loop flat out until either the requested number
+   of frames has been emulated or something else asks us to exit, then
+   report how fast we went */
+static int headless_rzx_verify( const char *directory );
+
+int
+headless_run( void )
+{
+  timer_type start_time, end_time;
+  float seconds, tstates_per_second;
+  int error;
+
+  if( settings_current.rzx_verify )
+    return headless_rzx_verify( settings_current.rzx_verify );
+
+  headless_frame_count = 0;
+  headless_tstates = 0;
+
+  error = timer_get_real_time( &start_time ); if( error ) return error;
+
+  while( !fuse_exiting ) {
+    z80_do_opcodes();
+    event_do_events();
+  }
+
+  error = timer_get_real_time( &end_time ); if( error ) return error;
+
+  seconds = timer_get_time_difference( &end_time, &start_time );
+  if( seconds <= 0 ) seconds = 1e-6;
+
+  tstates_per_second = headless_tstates / seconds;
+
+  printf( "%s: %lu frames (%.0f tstates) in %.3f seconds\n", fuse_progname,
+	  (unsigned long)headless_frame_count, (double)headless_tstates,
+	  seconds );
+  printf( "%s: %.2f frames/sec, %.3f MHz, %.1f%% of real speed\n",
+	  fuse_progname, headless_frame_count / seconds,
+	  tstates_per_second / 1e6,
+	  100.0 * tstates_per_second /
+	  machine_current->timings.processor_speed );
+
+  return 0;
+}
+
+/* FNV-1a, used to summarise the state of the machine at the end of an
+   .rzx file */
+static libspectrum_dword
+hash_bytes( libspectrum_dword hash, const libspectrum_byte *data,
+	    size_t length )
+{
+  size_t i;
+
+  for( i = 0; i < length; i++ ) {
+    hash ^= data[i];
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
+
+static libspectrum_dword
+hash_word( libspectrum_dword hash, libspectrum_word word )
+{
+  libspectrum_byte data[2] = { word & 0xff, word >> 8 };
+  return hash_bytes( hash, data, 2 );
+}
+
+/* Hash the registers and every RAM page present on this machine; pages
+   which aren't present may hold leftovers from an earlier file */
+static libspectrum_dword
+state_hash( void )
+{
+  libspectrum_dword hash = 2166136261UL;
+  libspectrum_byte data[6];
+  size_t i;
+
+  hash = hash_word( hash, AF  ); hash = hash_word( hash, BC  );
+  hash = hash_word( hash, DE  ); hash = hash_word( hash, HL  );
+  hash = hash_word( hash, AF_ ); hash = hash_word( hash, BC_ );
+  hash = hash_word( hash, DE_ ); hash = hash_word( hash, HL_ );
+  hash = hash_word( hash, IX  ); hash = hash_word( hash, IY  );
+  hash = hash_word( hash, SP  ); hash = hash_word( hash, PC  );
+
+  data[0] = I; data[1] = ( R7 & 0x80 ) | ( R & 0x7f );
+  data[2] = IFF1; data[3] = IFF2; data[4] = IM; data[5] = z80.halted;
+  hash = hash_bytes( hash, data, 6 );
+
+  for( i = 0; i < SPECTRUM_RAM_PAGES; i++ )
+    if( memory_map_ram[ 2 * i ].writable )
+      hash = hash_bytes( hash, RAM[i], 0x4000 );
+
+  return hash;
+}
+
+static const char*
+playback_result_string( rzx_playback_result result )
+{
+  switch( result ) {
+  case RZX_PLAYBACK_FINISHED: return "ok";
+  case RZX_PLAYBACK_UNDERRUN: return "underrun";
+  case RZX_PLAYBACK_OVERRUN: return "overrun";
+  case RZX_PLAYBACK_ERROR: return "error";
+  }
+
+  return "unknown";
+}
+
+/* Play back one .rzx file flat out from a hard reset. Returns 0 if the
+   file played back to the end without any problems */
+static int
+verify_rzx_file( const char *filename )
+{
+  timer_type start_time, end_time;
+  float seconds;
+  int error;
+
+  headless_frame_count = 0;
+  headless_tstates = 0;
+
+  error = machine_reset( 1 ); if( error ) return error;
+
+  error = timer_get_real_time( &start_time ); if( error ) return error;
+
+  if( rzx_start_playback( filename ) ) {
+    printf( "%s: %s: couldn't start playback\n", fuse_progname, filename );
+    return 1;
+  }
+
+  while( rzx_playback && !fuse_exiting ) {
+    z80_do_opcodes();
+    event_do_events();
+  }
+
+  error = timer_get_real_time( &end_time ); if( error ) return error;
+
+  seconds = timer_get_time_difference( &end_time, &start_time );
+
+  printf( "%s: %s: %lu frames, hash %08lx, %s, %.3f seconds\n",
+	  fuse_progname, filename, (unsigned long)headless_frame_count,
+	  (unsigned long)state_hash(),
+	  playback_result_string( rzx_last_playback_result ), seconds );
+
+  return rzx_last_playback_result != RZX_PLAYBACK_FINISHED;
+}
+
+static gint
+compare_filenames( gconstpointer a, gconstpointer b )
+{
+  return strcmp( a, b );
+}
+
+static void
+free_filename( gpointer data, gpointer user_data GCC_UNUSED )
+{
+  free( data );
+}
+
+/* Play back every .rzx file in 'directory' in turn, in name order, and
+   report on each */
+static int
+headless_rzx_verify( const char *directory )
+{
+  compat_dir dir;
+  compat_dir_result_t result;
+  char name[ PATH_MAX ], *path;
+  size_t length;
+  GSList *files = NULL, *ptr;
+  unsigned long count = 0, failures = 0;
+
+  dir = compat_opendir( directory );
+  if( !dir ) {
+    ui_error( UI_ERROR_ERROR, "couldn't open directory '%s'", directory );
+    return 1;
+  }
+
+  while( ( result = compat_readdir( dir, name, sizeof( name ) ) ) ==
+	 COMPAT_DIR_RESULT_OK ) {
+
+    length = strlen( name );
+    if( length < 4 || strcasecmp( name + length - 4, ".rzx" ) ) continue;
+
+    path = malloc( strlen( directory ) + length + 2 );
+    if( !path ) {
+      ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__,
+		__LINE__ );
+      result = COMPAT_DIR_RESULT_ERROR;
+      break;
+    }
+    sprintf( path, "%s" FUSE_DIR_SEP_STR "%s", directory, name );
+
+    files = g_slist_insert_sorted( files, path, compare_filenames );
+  }
+
+  compat_closedir( dir );
+
+  if( result == COMPAT_DIR_RESULT_ERROR ) {
+    g_slist_foreach( files, free_filename, NULL );
+    g_slist_free( files );
+    return 1;
+  }
+
+  for( ptr = files; ptr && !fuse_exiting; ptr = ptr->next ) {
+    count++;
+    if( verify_rzx_file( ptr->data ) ) failures++;
+  }
+
+  g_slist_foreach( files, free_filename, NULL );
+  g_slist_free( files );
+
+  printf( "%s: %lu files verified, %lu failures\n", fuse_progname, count,
+	  failures );
+
+  return failures ? 1 : 0;
+}
+
+void
+headless_frame( libspectrum_dword frame_length )
+{
+  headless_frame_count++;
+  headless_tstates += frame_length;
+
+  display_skip_frame();
+
+  if( settings_current.headless_frames > 0 &&
+      headless_frame_count >=
+        (libspectrum_dword)settings_current.headless_frames )
+    fuse_exiting = 1;
+}
@@ -0,0 +1,31 @@
+/* headless.h: run the emulation core with no user interface
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef FUSE_HEADLESS_H
+#define FUSE_HEADLESS_H
+
+#include <libspectrum.h>
+
+int headless_init( void );
+int headless_run( void );
+void headless_frame( libspectrum_dword frame_length );
+
+#endif			/* #ifndef FUSE_HEADLESS_H */
@@ -0,0 +1,260 @@
+/* hostprofile.c: Timing how long each part of the emulator takes
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Only built if HOST_PROFILE is defined; otherwise the scopes compile
+   to nothing. Each frame's time in each scope is kept for the last few
+   seconds, along with a histogram of those times, and written out when
+   the emulator exits */
+
+#include <config.h>
+
+#ifdef HOST_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libspectrum.h>
+
+#include "event.h"
+#include "hostprofile.h"
+#include "timer/timer.h"
+#include "ui/ui.h"
+
+#define HOSTPROFILE_ALL_SCOPES ( HOSTPROFILE_SCOPES + HOSTPROFILE_EVENT_TYPES )
+
+/* About five seconds' worth */
+#define HOSTPROFILE_FRAMES 256
+
+/* Bucket 0 is up to 1us a frame; bucket n is 2^n to 2^(n+1)-1us,
+   except the last, which is everything more */
+#define HOSTPROFILE_BUCKETS 16
+
+#define HOSTPROFILE_DEPTH 16
+
+#define HOSTPROFILE_FILENAME "hostprofile.txt"
+
+#define HOSTPROFILE_SUMMARY_LENGTH 64
+
+static const char * const scope_names[ HOSTPROFILE_SCOPES ] = {
+  "Other", "Z80", "Event queue", "Display", "Sound", "RZX", "UI"
+};
+
+/* Microseconds spent in each scope this frame, and in each of the last
+   HOSTPROFILE_FRAMES */
+static libspectrum_dword frame_time[ HOSTPROFILE_ALL_SCOPES ];
+static libspectrum_dword history[ HOSTPROFILE_FRAMES ][ HOSTPROFILE_ALL_SCOPES ];
+static size_t history_next, history_count;
+
+/* Over the frames in the history */
+static libspectrum_dword window_total[ HOSTPROFILE_ALL_SCOPES ];
+static libspectrum_word histogram[ HOSTPROFILE_ALL_SCOPES ][ HOSTPROFILE_BUCKETS ];
+
+/* Since we started */
+static libspectrum_qword total[ HOSTPROFILE_ALL_SCOPES ];
+static libspectrum_dword frames;
+
+/* The scopes we're in; the bottom one is always HOSTPROFILE_OTHER */
+static int scope_stack[ HOSTPROFILE_DEPTH ];
+static size_t depth;
+
+static libspectrum_dword last_time;
+
+/* Two, so one can be shown while the other is written */
+static char summaries[2][ HOSTPROFILE_SUMMARY_LENGTH ];
+static int summary_current;
+
+int
+hostprofile_init( void )
+{
+  scope_stack[0] = HOSTPROFILE_OTHER; depth = 1;
+  last_time = timer_get_microseconds();
+
+  return 0;
+}
+
+/* Count the time since we last looked against the current scope */
+static void
+charge( void )
+{
+  libspectrum_dword now = timer_get_microseconds();
+  size_t top = depth < HOSTPROFILE_DEPTH ? depth : HOSTPROFILE_DEPTH;
+
+  frame_time[ scope_stack[ top - 1 ] ] += now - last_time;
+  last_time = now;
+}
+
+void
+hostprofile_enter( int scope )
+{
+  charge();
+
+  /* Any deeper is counted against the deepest we can keep */
+  if( depth < HOSTPROFILE_DEPTH ) scope_stack[ depth ] = scope;
+  depth++;
+}
+
+void
+hostprofile_leave( void )
+{
+  charge();
+
+  if( depth > 1 ) depth--;
+}
+
+static int
+bucket( libspectrum_dword time )
+{
+  int i = 0;
+
+  while( time > 1 && i < HOSTPROFILE_BUCKETS - 1 ) { time >>= 1; i++; }
+
+  return i;
+}
+
+static float
+window_average( int scope )
+{
+  return history_count ?
+	 (float)window_total[ scope ] / history_count / 1000 : 0;
+}
+
+static void
+update_summary( void )
+{
+  float events = window_average( HOSTPROFILE_EVENTS );
+  char *summary = summaries[ !summary_current ];
+  int i;
+
+  for( i = HOSTPROFILE_SCOPES; i < HOSTPROFILE_ALL_SCOPES; i++ )
+    events += window_average( i );
+
+  snprintf( summary, HOSTPROFILE_SUMMARY_LENGTH,
+	    "Z80 %.1f Scr %.1f Snd %.1f Ev %.1f UI %.1f ms",
+	    window_average( HOSTPROFILE_Z80 ),
+	    window_average( HOSTPROFILE_DISPLAY ),
+	    window_average( HOSTPROFILE_SOUND ), events,
+	    window_average( HOSTPROFILE_UI ) );
+
+  summary_current = !summary_current;
+}
+
+void
+hostprofile_frame( void )
+{
+  libspectrum_dword *slot = history[ history_next ];
+  int i;
+
+  charge();
+
+  for( i = 0; i < HOSTPROFILE_ALL_SCOPES; i++ ) {
+
+    /* The oldest frame drops out of the window */
+    if( history_count == HOSTPROFILE_FRAMES ) {
+      window_total[i] -= slot[i];
+      histogram[i][ bucket( slot[i] ) ]--;
+    }
+
+    slot[i] = frame_time[i];
+    window_total[i] += frame_time[i];
+    histogram[i][ bucket( frame_time[i] ) ]++;
+    total[i] += frame_time[i];
+
+    frame_time[i] = 0;
+  }
+
+  history_next = ( history_next + 1 ) % HOSTPROFILE_FRAMES;
+  if( history_count < HOSTPROFILE_FRAMES ) history_count++;
+  frames++;
+
+  update_summary();
+}
+
+const char*
+hostprofile_summary( void )
+{
+  return summaries[ summary_current ];
+}
+
+static void
+write_scope( FILE *f, const char *name, int scope )
+{
+  libspectrum_dword longest = 0;
+  size_t i;
+
+  if( !total[ scope ] ) return;
+
+  for( i = 0; i < history_count; i++ )
+    if( history[i][ scope ] > longest ) longest = history[i][ scope ];
+
+  fprintf( f, "%-20s %10.1f %10.1f %10lu ", name,
+	   (double)total[ scope ] / frames,
+	   history_count ? (double)window_total[ scope ] / history_count : 0,
+	   (unsigned long)longest );
+
+  for( i = 0; i < HOSTPROFILE_BUCKETS; i++ )
+    fprintf( f, " %3u", (unsigned)histogram[ scope ][i] );
+
+  fprintf( f, "\n" );
+}
+
+int
+hostprofile_write( const char *filename )
+{
+  FILE *f;
+  int i;
+
+  f = fopen( filename, "w" );
+  if( !f ) {
+    ui_error( UI_ERROR_ERROR, "unable to open host profile '%s' for writing",
+	      filename );
+    return 1;
+  }
+
+  fprintf( f, "# %lu frames; microseconds per frame: mean over all frames, "
+	   "then mean and longest\n# over the last %lu, and a histogram of "
+	   "those frames: 0-1, 2-3, 4-7, ...\n",
+	   (unsigned long)frames, (unsigned long)history_count );
+
+  for( i = 0; i < HOSTPROFILE_SCOPES; i++ )
+    write_scope( f, scope_names[i], i );
+
+  /* Only registered events have had any time counted against them */
+  for( i = 0; i < HOSTPROFILE_EVENT_TYPES; i++ )
+    if( total[ HOSTPROFILE_SCOPES + i ] )
+      write_scope( f, event_name( i ), HOSTPROFILE_SCOPES + i );
+
+  if( fclose( f ) ) {
+    ui_error( UI_ERROR_ERROR, "error writing host profile '%s'", filename );
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+hostprofile_end( void )
+{
+  if( !frames ) return 0;
+
+  return hostprofile_write( HOSTPROFILE_FILENAME );
+}
+
+#endif				/* #ifdef HOST_PROFILE */
@@ -0,0 +1,77 @@
+/* hostprofile.h: Timing how long each part of the emulator takes
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef FUSE_HOSTPROFILE_H
+#define FUSE_HOSTPROFILE_H
+
+/* The parts of the emulator timed. Time is counted against the most
+   recently entered scope only, so an event's time doesn't also count
+   as time spent running the event queue */
+typedef enum hostprofile_scope {
+
+  HOSTPROFILE_OTHER,		/* Not in any other scope */
+  HOSTPROFILE_Z80,
+  HOSTPROFILE_EVENTS,		/* The event queue itself */
+  HOSTPROFILE_DISPLAY,
+  HOSTPROFILE_SOUND,
+  HOSTPROFILE_RZX,
+  HOSTPROFILE_UI,
+
+  HOSTPROFILE_SCOPES
+
+} hostprofile_scope;
+
+/* Each type of event is timed separately, up to this many */
+#define HOSTPROFILE_EVENT_TYPES 32
+
+#define HOSTPROFILE_EVENT( type ) \
+  ( (type) < HOSTPROFILE_EVENT_TYPES ? HOSTPROFILE_SCOPES + (type) : \
+				       HOSTPROFILE_EVENTS )
+
+#ifdef HOST_PROFILE
+
+int hostprofile_init( void );
+
+void hostprofile_enter( int scope );
+void hostprofile_leave( void );
+
+/* Everything in this frame has been done */
+void hostprofile_frame( void );
+
+/* A line of average times over the last few seconds, to be shown on
+   the screen */
+const char* hostprofile_summary( void );
+
+int hostprofile_write( const char *filename );
+
+int hostprofile_end( void );
+
+#define HOSTPROFILE_ENTER( scope ) hostprofile_enter( scope )
+#define HOSTPROFILE_LEAVE() hostprofile_leave()
+
+#else				/* #ifdef HOST_PROFILE */
+
+#define HOSTPROFILE_ENTER( scope )
+#define HOSTPROFILE_LEAVE()
+
+#endif				/* #ifdef HOST_PROFILE */
+
+#endif			/* #ifndef FUSE_HOSTPROFILE_H */
@@ -348,7 +348,6 @@ machine_load_rom( size_t which, int page_num, const char *filename,
 int
 machine_reset( int hard_reset )
 {
-  size_t i;
   int error;
 
   sound_ay_reset();
@@ -368,11 +367,8 @@ machine_reset( int hard_reset )
 
   error = machine_current->memory_map(); if( error ) return error;
 
-  /* Set up the contention array */
-  for( i = 0; i < machine_current->timings.tstates_per_frame; i++ ) {
-    ula_contention[ i ] = machine_current->ram.contend_delay( i );
-    ula_contention_no_mreq[ i ] = machine_current->ram.contend_delay_no_mreq( i );
-  }
+  /* Select the contention tables */
+  error = ula_select_contention(); if( error ) return error;
 
   /* Check for an Interface I ROM */
   ui_statusbar_update( UI_STATUSBAR_ITEM_MICRODRIVE,
@@ -230,6 +230,12 @@ writebyte_internal( libspectrum_word address, libspectrum_byte b )
   mapping = &memory_map_write[ bank ];
   memory = mapping->page;
 
+  /* The common case: nothing to do but store the byte */
+  if( mapping->write_class == MEMORY_WRITE_RAM ) {
+    memory[ offset ] = b;
+    return;
+  }
+
   if( mapping->writable || settings_current.writable_roms ) {
 
     /* The offset into the 16Kb RAM page (as opposed to the 8Kb chunk) */
@@ -241,17 +247,48 @@ writebyte_internal( libspectrum_word address, libspectrum_byte b )
 	mapping->page_num == memory_current_screen &&
 	( offset2 & memory_screen_mask ) < 0x1b00 &&
 	memory[ offset ] != b )
-      display_dirty( offset2 );
+      display_dirty( offset2, b );
 
     memory[ offset ] = b;
   }
 }
 
+static memory_write_class
+memory_write_class_of( memory_page *mapping )
+{
+  if( !mapping->writable ) return MEMORY_WRITE_ROM;
+
+  /* Only the chunk(s) actually holding the display file count as
+     screen memory */
+  if( mapping->bank == MEMORY_BANK_HOME &&
+      mapping->page_num == memory_current_screen &&
+      ( mapping->offset & memory_screen_mask ) < 0x1b00 )
+    return MEMORY_WRITE_SCREEN;
+
+  if( mapping->source == MEMORY_SOURCE_PERIPHERAL ||
+      mapping->bank == MEMORY_BANK_ROMCS )
+    return MEMORY_WRITE_PERIPHERAL;
+
+  return MEMORY_WRITE_RAM;
+}
+
+void
+memory_update_write_classes( void )
+{
+  size_t i;
+
+  for( i = 0; i < 8; i++ )
+    memory_map_write[i].write_class =
+      memory_write_class_of( &memory_map_write[i] );
+}
+
+/* Called at the end of every machine's memory_map() function, so this
+   is also where the write classes get updated */
 void
 memory_romcs_map( void )
 {
   /* Nothing changes if /ROMCS is not set */
-  if( !machine_current->ram.romcs ) return;
+  if( machine_current->ram.romcs ) {
 
   /* FIXME: what should we do if more than one of these devices is
      active? What happen in the real situation? e.g. if1+if2 with cartridge?
@@ -270,7 +307,10 @@ memory_romcs_map( void )
      
    */
 
-  module_romcs();
+    module_romcs();
+  }
+
+  memory_update_write_classes();
 }
 
 static void
@@ -50,6 +50,18 @@ typedef enum memory_page_source {
   
 } memory_page_source;
 
+/* What needs to happen on a write to a page; worked out whenever the
+   memory map changes so that writebyte_internal() can deal with plain
+   RAM without looking at anything else */
+typedef enum memory_write_class {
+
+  MEMORY_WRITE_ROM,		/* Not writable (unless writable_roms) */
+  MEMORY_WRITE_RAM,		/* Plain RAM: just store the byte */
+  MEMORY_WRITE_SCREEN,		/* RAM containing the current screen */
+  MEMORY_WRITE_PERIPHERAL,	/* Writable memory from a peripheral */
+
+} memory_write_class;
+
 typedef struct memory_page {
 
   libspectrum_byte *page;	/* The data for this page */
@@ -62,6 +74,8 @@ typedef struct memory_page {
 
   memory_page_source source;	/* Where did this page come from? */
 
+  memory_write_class write_class; /* Only valid in memory_map_write */
+
 } memory_page;
 
 #define MEMORY_PAGE_SIZE 0x2000
@@ -97,6 +111,9 @@ const char *memory_bank_name( memory_page *page );
 /* Map in alternate bank if ROMCS is set */
 void memory_romcs_map( void );
 
+/* Recalculate the write class of each chunk of memory_map_write */
+void memory_update_write_classes( void );
+
 /* Have we loaded any custom ROMs? */
 int memory_custom_rom( void );
 
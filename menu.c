@@ -37,6 +37,7 @@
 #include "if2.h"
 #include "joystick.h"
 #include "menu.h"
+#include "movie.h"
 #include "profile.h"
 #include "psg.h"
 #include "rzx.h"
@@ -190,9 +191,11 @@ MENU_CALLBACK( menu_file_openscrscreenshot )
 
 MENU_CALLBACK( menu_file_movies_stopmovierecording )
 {
+  if( !movie_recording ) return;
+
   WIDGET_END;
 
-  screenshot_movie_record = 0;
+  movie_stop_recording();
   ui_menu_activate( UI_MENU_ITEM_FILE_MOVIES_RECORDING, 0 );
 }
 
@@ -679,54 +682,26 @@ MENU_CALLBACK( menu_file_savescreenaspng )
 }
 #endif
 
-MENU_CALLBACK( menu_file_movies_recordmovieasscr )
+MENU_CALLBACK( menu_file_movies_recordmovie )
 {
   char *filename;
 
-  WIDGET_END;
-  
-  fuse_emulation_pause();
-
-  filename = ui_get_save_filename( "Fuse - Record Movie as SCR" );
-  if( !filename ) { fuse_emulation_unpause(); return; }
-
-  snprintf( screenshot_movie_file, PATH_MAX-SCREENSHOT_MOVIE_FILE_MAX, "%s",
-            filename );
-
-  screenshot_movie_record = 1;
-  ui_menu_activate( UI_MENU_ITEM_FILE_MOVIES_RECORDING, 1 );
-
-  free( filename );
-
-  fuse_emulation_unpause();
-}
-
-#ifdef USE_LIBPNG
-MENU_CALLBACK( menu_file_movies_recordmovieaspng )
-{
-  scaler_type scaler;
-  char *filename;
+  if( movie_recording ) return;
 
   WIDGET_END;
 
   fuse_emulation_pause();
 
-  scaler = menu_get_scaler( screenshot_available_scalers );
-  if( scaler == SCALER_NUM ) {
-    fuse_emulation_unpause();
-    return;
-  }
-
-  filename = ui_get_save_filename( "Fuse - Save Screenshot as PNG" );
+  filename = ui_get_save_filename( "Fuse - Record Movie" );
   if( !filename ) { fuse_emulation_unpause(); return; }
 
-  screenshot_write( filename, scaler );
+  if( !movie_start_recording( filename ) )
+    ui_menu_activate( UI_MENU_ITEM_FILE_MOVIES_RECORDING, 1 );
 
   free( filename );
 
   fuse_emulation_unpause();
 }
-#endif
 
 MENU_CALLBACK( menu_file_recording_record )
 {
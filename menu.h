@@ -123,8 +123,7 @@ MENU_CALLBACK( menu_file_aylogging_record );
 MENU_CALLBACK( menu_file_savescreenasscr );
 MENU_CALLBACK( menu_file_savescreenaspng );
 
-MENU_CALLBACK( menu_file_movies_recordmovieasscr );
-MENU_CALLBACK( menu_file_movies_recordmovieaspng );
+MENU_CALLBACK( menu_file_movies_recordmovie );
 
 MENU_CALLBACK( menu_options_general );
 MENU_CALLBACK( menu_options_sound );
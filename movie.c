@@ -0,0 +1,401 @@
+/* movie.c: Recording the screen and sound to a movie file
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Each frame is stored as just the 8x1 chunks which have changed since
+   the one before, which on most frames is very few of them. Building
+   the frame is cheap and done wherever the frame is drawn; compressing
+   and writing it out is left to a thread of its own so the emulation
+   never waits for the memory stick unless that falls a long way
+   behind. See movie.h for the file format. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+#include "compat.h"
+#include "display.h"
+#include "machine.h"
+#include "movie.h"
+#include "ui/ui.h"
+
+#define MOVIE_CHUNKS ( DISPLAY_SCREEN_WIDTH_COLS * DISPLAY_SCREEN_HEIGHT )
+
+/* How many blocks may be waiting to be written before the emulation
+   has to wait; a couple of seconds' worth */
+#define MOVIE_QUEUE_LENGTH 200
+
+/* Worst case for a frame: every chunk changed, each in a run of its
+   own */
+#define MOVIE_FRAME_MAX ( MOVIE_CHUNKS * 7 )
+
+/* Are we currently recording a movie? */
+int movie_recording;
+
+/* What each chunk looks like now, and what it looked like in the last
+   frame written, as hires << 24 | paper << 20 | ink << 16 | bitmap */
+static libspectrum_dword movie_screen[ MOVIE_CHUNKS ];
+static libspectrum_dword movie_written[ MOVIE_CHUNKS ];
+
+/* Which chunks have been drawn since the last frame */
+static libspectrum_qword movie_drawn[ DISPLAY_SCREEN_HEIGHT ];
+
+static libspectrum_byte movie_frame_buffer[ MOVIE_FRAME_MAX ];
+
+static int movie_sound_rate, movie_sound_channels;
+
+typedef struct movie_block_t {
+  libspectrum_byte type;
+  size_t length;
+  libspectrum_byte *data;
+  struct movie_block_t *next;
+} movie_block_t;
+
+static FILE *movie_file;
+static int movie_write_error;
+
+static compat_thread movie_writer;
+
+/* Queued last of all to stop the writer */
+static movie_block_t movie_end_block = { 0, 0, NULL, NULL };
+
+/* Blocks waiting to be written, oldest first */
+static movie_block_t *movie_queue_head, *movie_queue_tail;
+static compat_semaphore movie_queue_lock, movie_queue_waiting,
+                        movie_queue_space;
+
+static void
+write_dword( libspectrum_byte *buffer, libspectrum_dword value )
+{
+  buffer[0] = value & 0xff; buffer[1] = ( value >>  8 ) & 0xff;
+  buffer[2] = ( value >> 16 ) & 0xff; buffer[3] = value >> 24;
+}
+
+static void
+write_word( libspectrum_byte *buffer, libspectrum_word value )
+{
+  buffer[0] = value & 0xff; buffer[1] = value >> 8;
+}
+
+static int
+write_block( movie_block_t *block )
+{
+  libspectrum_byte header[9];
+  const libspectrum_byte *data = block->data;
+  size_t header_length = 5, length = block->length;
+  libspectrum_byte type = block->type;
+
+#ifdef HAVE_ZLIB_H
+  libspectrum_byte *compressed = NULL;
+
+  /* Sound barely compresses, so isn't worth the time */
+  if( type == MOVIE_BLOCK_VIDEO && length ) {
+    uLongf compressed_length = compressBound( length );
+
+    compressed = malloc( compressed_length );
+    if( compressed &&
+	compress2( compressed, &compressed_length, data, length,
+		   Z_BEST_SPEED ) == Z_OK &&
+	compressed_length < length ) {
+      write_dword( &header[5], length );
+      header_length = 9;
+      type |= MOVIE_BLOCK_COMPRESSED;
+      data = compressed; length = compressed_length;
+    }
+  }
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+  header[0] = type;
+  write_dword( &header[1], length + header_length - 5 );
+
+  if( fwrite( header, header_length, 1, movie_file ) != 1 ||
+      ( length && fwrite( data, length, 1, movie_file ) != 1 ) )
+    movie_write_error = 1;
+
+#ifdef HAVE_ZLIB_H
+  free( compressed );
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+  return movie_write_error;
+}
+
+static int
+movie_writer_run( void *data GCC_UNUSED )
+{
+  movie_block_t *block;
+  int done = 0;
+
+  while( !done ) {
+    compat_semaphore_wait( movie_queue_waiting );
+
+    compat_semaphore_wait( movie_queue_lock );
+    block = movie_queue_head;
+    movie_queue_head = block->next;
+    if( !movie_queue_head ) movie_queue_tail = NULL;
+    compat_semaphore_post( movie_queue_lock );
+
+    if( block->type ) {
+      /* After an error, just keep the queue moving */
+      if( !movie_write_error ) write_block( block );
+      free( block );
+    } else {
+      done = 1;
+    }
+
+    compat_semaphore_post( movie_queue_space );
+  }
+
+  return 0;
+}
+
+/* Get a block with room for 'length' bytes of data */
+static movie_block_t*
+alloc_block( libspectrum_byte type, size_t length )
+{
+  movie_block_t *block = malloc( sizeof( *block ) + length );
+
+  if( !block ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  block->type = type;
+  block->length = length;
+  block->data = (libspectrum_byte*)( block + 1 );
+  block->next = NULL;
+
+  return block;
+}
+
+/* Hand a block over to the writer, which will free it */
+static void
+queue_block( movie_block_t *block )
+{
+  compat_semaphore_wait( movie_queue_space );
+
+  compat_semaphore_wait( movie_queue_lock );
+  if( movie_queue_tail ) {
+    movie_queue_tail->next = block;
+  } else {
+    movie_queue_head = block;
+  }
+  movie_queue_tail = block;
+  compat_semaphore_post( movie_queue_lock );
+
+  compat_semaphore_post( movie_queue_waiting );
+}
+
+static void
+destroy_semaphores( void )
+{
+  if( movie_queue_lock ) compat_semaphore_destroy( movie_queue_lock );
+  if( movie_queue_waiting ) compat_semaphore_destroy( movie_queue_waiting );
+  if( movie_queue_space ) compat_semaphore_destroy( movie_queue_space );
+  movie_queue_lock = movie_queue_waiting = movie_queue_space = NULL;
+}
+
+int
+movie_init( void )
+{
+  movie_recording = 0;
+  return 0;
+}
+
+int
+movie_start_recording( const char *filename )
+{
+  libspectrum_byte header[ MOVIE_HEADER_LENGTH ];
+
+  if( movie_recording ) return 1;
+
+  movie_file = fopen( filename, "wb" );
+  if( !movie_file ) {
+    ui_error( UI_ERROR_ERROR, "unable to open movie file for writing" );
+    return 1;
+  }
+
+  memcpy( header, MOVIE_SIGNATURE, MOVIE_SIGNATURE_LENGTH );
+  header[8] = machine_current->timex ? MOVIE_FLAG_TIMEX : 0;
+  header[9] = DISPLAY_SCREEN_WIDTH_COLS;
+  write_word( &header[10], DISPLAY_SCREEN_HEIGHT );
+  write_dword( &header[12], machine_current->timings.processor_speed );
+  write_dword( &header[16], machine_current->timings.tstates_per_frame );
+
+  if( fwrite( header, MOVIE_HEADER_LENGTH, 1, movie_file ) != 1 ) {
+    ui_error( UI_ERROR_ERROR, "unable to write movie file header" );
+    fclose( movie_file );
+    return 1;
+  }
+
+  movie_queue_head = movie_queue_tail = NULL;
+  movie_queue_lock = compat_semaphore_create( 1 );
+  movie_queue_waiting = compat_semaphore_create( 0 );
+  movie_queue_space = compat_semaphore_create( MOVIE_QUEUE_LENGTH );
+  movie_write_error = 0;
+
+  if( movie_queue_lock && movie_queue_waiting && movie_queue_space )
+    movie_writer = compat_thread_create( movie_writer_run, NULL );
+  if( !movie_writer ) {
+    destroy_semaphores();
+    fclose( movie_file );
+    return 1;
+  }
+
+  /* Nothing has been written yet, so the whole of the first frame is */
+  memset( movie_written, 0xff, sizeof( movie_written ) );
+  memset( movie_drawn, 0, sizeof( movie_drawn ) );
+  movie_sound_rate = movie_sound_channels = 0;
+
+  /* Frames may be being drawn on another thread, which must see either
+     all of this or none of it */
+  display_wait();
+  movie_recording = 1;
+
+  /* And have every chunk drawn again, so the first frame is complete */
+  display_refresh_all();
+
+  return 0;
+}
+
+int
+movie_stop_recording( void )
+{
+  if( !movie_recording ) return 1;
+
+  display_wait();
+  movie_recording = 0;
+
+  /* Let the writer finish everything queued, then stop */
+  movie_end_block.next = NULL;
+  queue_block( &movie_end_block );
+  compat_thread_join( movie_writer );
+  movie_writer = NULL;
+
+  destroy_semaphores();
+
+  if( fclose( movie_file ) ) movie_write_error = 1;
+
+  if( movie_write_error ) {
+    ui_error( UI_ERROR_ERROR, "error writing movie file" );
+    return 1;
+  }
+
+  return 0;
+}
+
+void
+movie_chunk( int x, int y, libspectrum_word data, libspectrum_byte ink,
+	     libspectrum_byte paper, int hires )
+{
+  movie_screen[ x + y * DISPLAY_SCREEN_WIDTH_COLS ] =
+    ( hires ? 0x1000000 : 0 ) | paper << 20 | ink << 16 | data;
+  movie_drawn[y] |= (libspectrum_qword)1 << x;
+}
+
+void
+movie_frame( void )
+{
+  libspectrum_byte *ptr = movie_frame_buffer, *run = NULL;
+  movie_block_t *block;
+  libspectrum_qword drawn;
+  libspectrum_dword chunk;
+  size_t index, run_end = 0, run_length = 0;
+  int x, y, run_hires = 0, hires;
+
+  for( y = 0; y < DISPLAY_SCREEN_HEIGHT; y++ ) {
+
+    for( drawn = movie_drawn[y], x = 0; drawn; drawn >>= 1, x++ ) {
+
+      if( !( drawn & 0x01 ) ) continue;
+
+      index = x + y * DISPLAY_SCREEN_WIDTH_COLS;
+      chunk = movie_screen[ index ];
+      if( chunk == movie_written[ index ] ) continue;
+      movie_written[ index ] = chunk;
+
+      hires = chunk >> 24;
+
+      /* Start a new run unless this chunk carries on the last one */
+      if( !run || index != run_end || hires != run_hires ) {
+	if( run ) write_word( run + 2, run_length << 1 | run_hires );
+	write_word( ptr, index - run_end );
+	run = ptr; ptr += 4;
+	run_length = 0; run_hires = hires;
+      }
+
+      if( hires ) *ptr++ = ( chunk >> 8 ) & 0xff;
+      *ptr++ = chunk & 0xff;
+      *ptr++ = ( chunk >> 16 ) & 0xff;
+
+      run_length++; run_end = index + 1;
+    }
+
+    movie_drawn[y] = 0;
+  }
+
+  if( run ) write_word( run + 2, run_length << 1 | run_hires );
+
+  block = alloc_block( MOVIE_BLOCK_VIDEO, ptr - movie_frame_buffer );
+  if( !block ) return;
+
+  memcpy( block->data, movie_frame_buffer, block->length );
+  queue_block( block );
+}
+
+void
+movie_add_sound( const libspectrum_signed_word *samples, size_t count,
+		 int channels, int rate )
+{
+  movie_block_t *block;
+  size_t i;
+
+  if( rate != movie_sound_rate || channels != movie_sound_channels ) {
+    block = alloc_block( MOVIE_BLOCK_FORMAT, 6 );
+    if( !block ) return;
+
+    write_dword( block->data, rate );
+    write_word( block->data + 4, channels );
+    queue_block( block );
+
+    movie_sound_rate = rate; movie_sound_channels = channels;
+  }
+
+  count *= channels;
+
+  block = alloc_block( MOVIE_BLOCK_AUDIO, count * 2 );
+  if( !block ) return;
+
+  for( i = 0; i < count; i++ )
+    write_word( block->data + 2 * i, samples[i] );
+
+  queue_block( block );
+}
+
+int
+movie_end( void )
+{
+  if( movie_recording ) return movie_stop_recording();
+  return 0;
+}
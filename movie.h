@@ -0,0 +1,92 @@
+/* movie.h: Recording the screen and sound to a movie file
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef FUSE_MOVIE_H
+#define FUSE_MOVIE_H
+
+#include <libspectrum.h>
+
+/* The file format. All values are little-endian.
+
+   Header:
+     8 bytes  MOVIE_SIGNATURE
+     1 byte   flags (MOVIE_FLAG_TIMEX: drawn on a 640 pixel wide canvas)
+     1 byte   width of the screen in 8 pixel chunks
+     2 bytes  height of the screen in lines
+     4 bytes  processor speed in Hz
+     4 bytes  tstates per frame
+
+   Then any number of blocks:
+     1 byte   type
+     4 bytes  length of what follows
+   If the type has MOVIE_BLOCK_COMPRESSED set, what follows is the
+   length of the data once uncompressed (4 bytes) and then the data as
+   compressed by zlib.
+
+   MOVIE_BLOCK_VIDEO: one frame, as the chunks which have changed since
+   the one before. Any number of runs of
+     2 bytes  chunks since the end of the last run (or the top left)
+     2 bytes  ( chunks in the run << 1 ) | hires
+   each followed by the chunks in the run, each as
+     1 or 2   bitmap (2 if hires, the leftmost pixel in the top bit)
+     1 byte   ink | ( paper << 4 )
+
+   MOVIE_BLOCK_FORMAT: the format of the sound which follows
+     4 bytes  samples per second
+     2 bytes  channels
+
+   MOVIE_BLOCK_AUDIO: one frame's sound, as 16 bit signed samples,
+   interleaved if stereo */
+
+#define MOVIE_SIGNATURE "FUSEMOV1"
+#define MOVIE_SIGNATURE_LENGTH 8
+#define MOVIE_HEADER_LENGTH 20
+
+#define MOVIE_FLAG_TIMEX 0x01
+
+#define MOVIE_BLOCK_VIDEO 'V'
+#define MOVIE_BLOCK_FORMAT 'F'
+#define MOVIE_BLOCK_AUDIO 'A'
+#define MOVIE_BLOCK_COMPRESSED 0x20
+
+/* Are we currently recording a movie? */
+extern int movie_recording;
+
+int movie_init( void );
+
+int movie_start_recording( const char *filename );
+int movie_stop_recording( void );
+
+/* The chunk at ( x, y ) on the whole screen, border included, has been
+   drawn */
+void movie_chunk( int x, int y, libspectrum_word data, libspectrum_byte ink,
+		  libspectrum_byte paper, int hires );
+
+/* Everything in this frame has been drawn */
+void movie_frame( void );
+
+/* One frame's sound, 'count' samples from each of 'channels' */
+void movie_add_sound( const libspectrum_signed_word *samples, size_t count,
+		      int channels, int rate );
+
+int movie_end( void );
+
+#endif			/* #ifndef FUSE_MOVIE_H */
@@ -0,0 +1,423 @@
+/* movieconv.c: Convert a Fuse movie to standard video and sound files
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Runs on the host rather than the PSP. The video is written as
+   uncompressed YUV4MPEG2 and the sound as a WAV file, both of which
+   most encoders will take directly; for example
+
+     movieconv game.fmv game.y4m game.wav
+     ffmpeg -i game.y4m -i game.wav game.mp4
+
+   Timex machines are written at 640x480, everything else at 320x240, as
+   for screenshots. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+#include <libspectrum.h>
+
+#include "movie.h"
+
+static const char *progname;
+
+/* The screen is kept at Timex resolution whatever the machine, one
+   palette index per pixel */
+static libspectrum_byte *canvas;
+static size_t width_cols, height;
+static int timex;
+
+static libspectrum_byte palette_y[16], palette_cb[16], palette_cr[16];
+
+static libspectrum_byte *plane;
+static size_t out_width, out_height;
+
+/* The sound format of the WAV file, and whether the sound currently
+   being read is in it */
+static int wav_rate, wav_channels, wav_skipping;
+static libspectrum_dword wav_length;
+
+static void
+make_palette( void )
+{
+  static const			      /*  R    G    B */
+  libspectrum_byte palette[16][3] = { {   0,   0,   0 },
+				      {   0,   0, 192 },
+				      { 192,   0,   0 },
+				      { 192,   0, 192 },
+				      {   0, 192,   0 },
+				      {   0, 192, 192 },
+				      { 192, 192,   0 },
+				      { 192, 192, 192 },
+				      {   0,   0,   0 },
+				      {   0,   0, 255 },
+				      { 255,   0,   0 },
+				      { 255,   0, 255 },
+				      {   0, 255,   0 },
+				      {   0, 255, 255 },
+				      { 255, 255,   0 },
+				      { 255, 255, 255 } };
+  size_t i;
+
+  /* ITU-R BT.601, studio range */
+  for( i = 0; i < 16; i++ ) {
+    double r = palette[i][0], g = palette[i][1], b = palette[i][2];
+
+    palette_y[i]  =  16 + (  65.481 * r + 128.553 * g +  24.966 * b ) / 255
+                        + 0.5;
+    palette_cb[i] = 128 + ( -37.797 * r -  74.203 * g + 112.0   * b ) / 255
+                        + 0.5;
+    palette_cr[i] = 128 + ( 112.0   * r -  93.786 * g -  18.214 * b ) / 255
+                        + 0.5;
+  }
+}
+
+static libspectrum_dword
+read_dword( const libspectrum_byte *buffer )
+{
+  return buffer[0] | buffer[1] << 8 | buffer[2] << 16 |
+         (libspectrum_dword)buffer[3] << 24;
+}
+
+static libspectrum_word
+read_word( const libspectrum_byte *buffer )
+{
+  return buffer[0] | buffer[1] << 8;
+}
+
+static void
+write_dword( FILE *f, libspectrum_dword value )
+{
+  putc( value & 0xff, f ); putc( ( value >> 8 ) & 0xff, f );
+  putc( ( value >> 16 ) & 0xff, f ); putc( value >> 24, f );
+}
+
+static void
+write_word( FILE *f, libspectrum_word value )
+{
+  putc( value & 0xff, f ); putc( value >> 8, f );
+}
+
+/* Apply one frame's changes to the canvas */
+static int
+decode_frame( const libspectrum_byte *data, size_t length )
+{
+  const libspectrum_byte *end = data + length;
+  size_t index = 0, count, chunks = width_cols * height;
+  libspectrum_word bitmap;
+  libspectrum_byte ink, paper, *pixel;
+  int hires, i;
+
+  while( data < end ) {
+
+    if( end - data < 4 ) return 1;
+
+    index += read_word( data );
+    count = read_word( data + 2 ) >> 1;
+    hires = read_word( data + 2 ) & 0x01;
+    data += 4;
+
+    if( index + count > chunks ||
+	(size_t)( end - data ) < count * ( hires ? 3 : 2 ) )
+      return 1;
+
+    for( ; count; count--, index++ ) {
+
+      if( hires ) {
+	bitmap = data[0] << 8 | data[1];
+	data += 2;
+      } else {
+	bitmap = data[0];
+	data++;
+      }
+      ink = *data & 0x0f; paper = *data >> 4;
+      data++;
+
+      pixel = &canvas[ ( index / width_cols ) * width_cols * 16 +
+		       ( index % width_cols ) * 16 ];
+
+      if( hires ) {
+	for( i = 15; i >= 0; i-- )
+	  *pixel++ = ( bitmap >> i ) & 0x01 ? ink : paper;
+      } else {
+	for( i = 7; i >= 0; i-- ) {
+	  *pixel++ = ( bitmap >> i ) & 0x01 ? ink : paper;
+	  *pixel++ = ( bitmap >> i ) & 0x01 ? ink : paper;
+	}
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Write one plane of the canvas through 'palette' */
+static void
+write_plane( FILE *f, const libspectrum_byte *palette )
+{
+  size_t x, y, in_width = width_cols * 16;
+  const libspectrum_byte *line;
+  libspectrum_byte *out;
+
+  for( y = 0; y < out_height; y++ ) {
+
+    line = &canvas[ ( timex ? y / 2 : y ) * in_width ];
+
+    out = plane;
+    if( timex ) {
+      for( x = 0; x < out_width; x++ ) *out++ = palette[ line[x] ];
+    } else {
+      for( x = 0; x < out_width; x++ ) *out++ = palette[ line[ 2 * x ] ];
+    }
+
+    fwrite( plane, out_width, 1, f );
+  }
+}
+
+static void
+write_frame( FILE *f )
+{
+  fprintf( f, "FRAME\n" );
+  write_plane( f, palette_y );
+  write_plane( f, palette_cb );
+  write_plane( f, palette_cr );
+}
+
+static void
+write_wav_header( FILE *f )
+{
+  fwrite( "RIFF", 4, 1, f ); write_dword( f, 36 + wav_length );
+  fwrite( "WAVEfmt ", 8, 1, f ); write_dword( f, 16 );
+  write_word( f, 1 );				/* PCM */
+  write_word( f, wav_channels );
+  write_dword( f, wav_rate );
+  write_dword( f, wav_rate * wav_channels * 2 );
+  write_word( f, wav_channels * 2 );
+  write_word( f, 16 );
+  fwrite( "data", 4, 1, f ); write_dword( f, wav_length );
+}
+
+static void
+sound_format( const libspectrum_byte *data, size_t length )
+{
+  int rate, channels;
+
+  if( length < 6 ) return;
+
+  rate = read_dword( data ); channels = read_word( data + 4 );
+
+  if( !wav_rate ) {
+    wav_rate = rate; wav_channels = channels;
+  }
+
+  if( rate != wav_rate || channels != wav_channels ) {
+    if( !wav_skipping )
+      fprintf( stderr, "%s: sound format changed to %d Hz, %d channel(s); "
+	       "leaving it out\n", progname, rate, channels );
+    wav_skipping = 1;
+  } else {
+    wav_skipping = 0;
+  }
+}
+
+/* Read the next block, uncompressing it if need be; returns -1 at the
+   end of the file and 1 if the block is corrupt */
+static int
+read_block( FILE *f, int *type, libspectrum_byte **data, size_t *length )
+{
+  libspectrum_byte header[5], *compressed = NULL;
+  size_t compressed_length = 0;
+  int packed, error = 1;
+
+  *data = NULL;
+
+  if( fread( header, 5, 1, f ) != 1 ) return feof( f ) ? -1 : 1;
+
+  *type = header[0];
+  *length = read_dword( &header[1] );
+
+  packed = *type & MOVIE_BLOCK_COMPRESSED;
+  if( packed ) {
+    *type &= ~MOVIE_BLOCK_COMPRESSED;
+    if( *length < 4 || fread( header, 4, 1, f ) != 1 ) return 1;
+    compressed_length = *length - 4;
+    *length = read_dword( header );
+  }
+
+  *data = malloc( *length ? *length : 1 );
+  if( !*data ) return 1;
+
+  if( !packed ) {
+    if( !*length || fread( *data, *length, 1, f ) == 1 ) return 0;
+    free( *data ); *data = NULL;
+    return 1;
+  }
+
+  compressed = malloc( compressed_length ? compressed_length : 1 );
+  if( compressed && fread( compressed, compressed_length, 1, f ) == 1 ) {
+
+#ifdef HAVE_ZLIB_H
+    uLongf uncompressed_length = *length;
+    if( uncompress( *data, &uncompressed_length, compressed,
+		    compressed_length ) == Z_OK &&
+	uncompressed_length == *length )
+      error = 0;
+#else				/* #ifdef HAVE_ZLIB_H */
+    fprintf( stderr, "%s: compressed frames need zlib\n", progname );
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+  }
+
+  free( compressed );
+  if( error ) { free( *data ); *data = NULL; }
+
+  return error;
+}
+
+int
+main( int argc, char **argv )
+{
+  FILE *in, *video, *sound = NULL;
+  libspectrum_byte header[ MOVIE_HEADER_LENGTH ], *data;
+  libspectrum_dword speed, tstates_per_frame;
+  size_t length;
+  long frames = 0;
+  int type, error;
+
+  progname = argv[0];
+
+  if( argc < 3 || argc > 4 ) {
+    fprintf( stderr, "usage: %s <movie> <video.y4m> [<sound.wav>]\n",
+	     progname );
+    return 1;
+  }
+
+  in = fopen( argv[1], "rb" );
+  if( !in ) {
+    fprintf( stderr, "%s: couldn't open `%s'\n", progname, argv[1] );
+    return 1;
+  }
+
+  if( fread( header, MOVIE_HEADER_LENGTH, 1, in ) != 1 ||
+      memcmp( header, MOVIE_SIGNATURE, MOVIE_SIGNATURE_LENGTH ) ) {
+    fprintf( stderr, "%s: `%s' is not a Fuse movie\n", progname, argv[1] );
+    return 1;
+  }
+
+  timex = header[8] & MOVIE_FLAG_TIMEX;
+  width_cols = header[9];
+  height = read_word( &header[10] );
+  speed = read_dword( &header[12] );
+  tstates_per_frame = read_dword( &header[16] );
+
+  if( !width_cols || !height || !speed || !tstates_per_frame ) {
+    fprintf( stderr, "%s: `%s' has a bad header\n", progname, argv[1] );
+    return 1;
+  }
+
+  out_width = width_cols * ( timex ? 16 : 8 );
+  out_height = height * ( timex ? 2 : 1 );
+
+  canvas = calloc( width_cols * 16 * height, 1 );
+  plane = malloc( out_width );
+  if( !canvas || !plane ) {
+    fprintf( stderr, "%s: out of memory\n", progname );
+    return 1;
+  }
+
+  make_palette();
+
+  video = fopen( argv[2], "wb" );
+  if( !video ) {
+    fprintf( stderr, "%s: couldn't open `%s'\n", progname, argv[2] );
+    return 1;
+  }
+  fprintf( video, "YUV4MPEG2 W%lu H%lu F%lu:%lu Ip A1:1 C444\n",
+	   (unsigned long)out_width, (unsigned long)out_height,
+	   (unsigned long)speed, (unsigned long)tstates_per_frame );
+
+  if( argc == 4 ) {
+    sound = fopen( argv[3], "wb" );
+    if( !sound ) {
+      fprintf( stderr, "%s: couldn't open `%s'\n", progname, argv[3] );
+      return 1;
+    }
+    /* Filled in properly once the length is known */
+    write_wav_header( sound );
+  }
+
+  while( !( error = read_block( in, &type, &data, &length ) ) ) {
+
+    switch( type ) {
+
+    case MOVIE_BLOCK_VIDEO:
+      if( decode_frame( data, length ) )
+	fprintf( stderr, "%s: frame %ld is corrupt\n", progname, frames );
+      write_frame( video );
+      frames++;
+      break;
+
+    case MOVIE_BLOCK_FORMAT:
+      sound_format( data, length );
+      break;
+
+    case MOVIE_BLOCK_AUDIO:
+      if( sound && wav_rate && !wav_skipping ) {
+	fwrite( data, length, 1, sound );
+	wav_length += length;
+      }
+      break;
+
+    }
+
+    free( data );
+  }
+
+  if( error > 0 )
+    fprintf( stderr, "%s: stopped at a corrupt block\n", progname );
+
+  fclose( in );
+
+  if( fclose( video ) ) {
+    fprintf( stderr, "%s: error writing `%s'\n", progname, argv[2] );
+    return 1;
+  }
+
+  if( sound ) {
+    if( !wav_rate ) { wav_rate = 44100; wav_channels = 1; }
+    rewind( sound );
+    write_wav_header( sound );
+    if( fclose( sound ) ) {
+      fprintf( stderr, "%s: error writing `%s'\n", progname, argv[3] );
+      return 1;
+    }
+  }
+
+  printf( "%ld frames\n", frames );
+
+  return 0;
+}
@@ -60,6 +60,14 @@ typedef struct periph_private_t {
 static GSList *peripherals = NULL;
 static int last_id = 0;
 
+/* The active peripherals which may respond to a port with a given low
+   byte, in the order they were registered; each list is terminated by
+   NULL. Built when first needed after the peripherals change, so most
+   port accesses look at only one or two handlers */
+static const periph_t **decode_read[ 0x100 ], **decode_write[ 0x100 ];
+static const periph_t **decode_lists = NULL;
+static int decode_valid = 0;
+
 /* The strings used for debugger events */
 static const char *page_event_string = "page",
   *unpage_event_string = "unpage";
@@ -85,6 +93,7 @@ periph_register( const periph_t *peripheral )
   private->peripheral = *peripheral;
 
   peripherals = g_slist_append( peripherals, private );
+  decode_valid = 0;
 
   return private->id;
 }
@@ -119,6 +128,7 @@ periph_set_active( int id, int active )
   private = ptr->data;
 
   private->active = active;
+  decode_valid = 0;
 
   return 0;
 }
@@ -141,6 +151,7 @@ periph_clear( void )
   peripherals = NULL;
 
   last_id = 0;
+  decode_valid = 0;
 }
 
 static void
@@ -151,6 +162,86 @@ free_peripheral( gpointer data, gpointer user_data GCC_UNUSED )
   free( private );
 }
 
+/*
+ * Building the port decode tables
+ */
+
+/* Does 'peripheral' respond to any port with the low byte 'low'? */
+static int
+decodes_low_byte( const periph_t *peripheral, int low )
+{
+  return ( ( low ^ peripheral->value ) & peripheral->mask & 0xff ) == 0;
+}
+
+/* Fill in the lists in 'table' from 'ptr' onwards, taking only
+   peripherals with a read or write function as 'want_read' says;
+   returns the first entry after the lists */
+static const periph_t**
+fill_decode_table( const periph_t ***table, const periph_t **ptr,
+		   int want_read )
+{
+  GSList *list;
+  periph_private_t *private;
+  int low;
+
+  for( low = 0; low < 0x100; low++ ) {
+
+    table[ low ] = ptr;
+
+    for( list = peripherals; list; list = list->next ) {
+
+      private = list->data;
+      if( !private->active ) continue;
+      if( want_read ? !private->peripheral.read
+	            : !private->peripheral.write ) continue;
+
+      if( decodes_low_byte( &private->peripheral, low ) )
+	*ptr++ = &private->peripheral;
+    }
+
+    *ptr++ = NULL;
+  }
+
+  return ptr;
+}
+
+static int
+build_decode_tables( void )
+{
+  GSList *list;
+  periph_private_t *private;
+  size_t count = 0;
+  int low;
+
+  for( list = peripherals; list; list = list->next ) {
+
+    private = list->data;
+    if( !private->active ) continue;
+
+    for( low = 0; low < 0x100; low++ ) {
+      if( !decodes_low_byte( &private->peripheral, low ) ) continue;
+      if( private->peripheral.read ) count++;
+      if( private->peripheral.write ) count++;
+    }
+  }
+
+  /* Plus the terminator on each list */
+  count += 2 * 0x100;
+
+  /* Without the tables, every peripheral is looked at instead; slower,
+     but still right */
+  free( decode_lists );
+  decode_lists = malloc( count * sizeof( *decode_lists ) );
+  if( !decode_lists ) return 1;
+
+  fill_decode_table( decode_write,
+		     fill_decode_table( decode_read, decode_lists, 1 ), 0 );
+
+  decode_valid = 1;
+
+  return 0;
+}
+
 /*
  * The actual routines to read and write a port
  */
@@ -206,6 +297,7 @@ readport_internal( libspectrum_word port )
 
     error = libspectrum_rzx_playback( rzx, &value );
     if( error ) {
+      rzx_last_playback_result = RZX_PLAYBACK_OVERRUN;
       rzx_stop_playback( 1 );
 
       /* Add a null event to mean we pick up the RZX state change in
@@ -222,7 +314,17 @@ readport_internal( libspectrum_word port )
   callback_info.attached = 0;
   callback_info.value = 0xff;
 
-  g_slist_foreach( peripherals, read_peripheral, &callback_info );
+  if( decode_valid || !build_decode_tables() ) {
+
+    const periph_t **ptr;
+
+    for( ptr = decode_read[ port & 0xff ]; *ptr; ptr++ )
+      if( ( port & (*ptr)->mask ) == (*ptr)->value )
+	callback_info.value &= (*ptr)->read( port, &callback_info.attached );
+
+  } else {
+    g_slist_foreach( peripherals, read_peripheral, &callback_info );
+  }
 
   if( !callback_info.attached )
     callback_info.value = machine_current->unattached_port();
@@ -267,6 +369,18 @@ writeport_internal( libspectrum_word port, libspectrum_byte b )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE, port );
 
+  if( decode_valid || !build_decode_tables() ) {
+
+    const periph_t **ptr;
+
+    for( ptr = decode_write[ port & 0xff ]; *ptr; ptr++ )
+      if( ( port & (*ptr)->mask ) == (*ptr)->value )
+	(*ptr)->write( port, b );
+
+    return;
+  }
+
+  /* Fall back to looking at every peripheral */
   callback_info.port = port;
   callback_info.value = b;
   
@@ -479,6 +593,8 @@ periph_update( void )
   update_ide_menu();
   if1_update_menu();
   machine_current->memory_map();
+
+  if( !decode_valid ) build_decode_tables();
 }
 
 int
@@ -25,6 +25,7 @@
 
 #include <config.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -32,18 +33,93 @@
 
 #include "event.h"
 #include "fuse.h"
+#include "memory.h"
 #include "module.h"
 #include "profile.h"
+#include "spectrum.h"
 #include "ui/ui.h"
 #include "z80/z80.h"
 
 int profile_active = 0;
 
-static int total_tstates[ 0x10000 ];
-static libspectrum_word profile_last_pc;
+/* Where code was run from: which bank, then which page of that bank */
+enum {
+
+  PROFILE_BANK_NONE,
+  PROFILE_BANK_RAM,
+  PROFILE_BANK_ROM,
+  PROFILE_BANK_DOCK,
+  PROFILE_BANK_EXROM,
+  PROFILE_BANK_ROMCS,
+
+  PROFILE_BANKS
+
+};
+
+static const char * const profile_bank_names[ PROFILE_BANKS ] = {
+  "None", "RAM", "ROM", "Dock", "Exrom", "ROMCS"
+};
+
+#define PROFILE_PAGES SPECTRUM_RAM_PAGES
+
+/* A location is ( bank << 24 ) | ( page << 16 ) | address */
+#define PROFILE_LOCATION_BANK( location ) ( (location) >> 24 )
+#define PROFILE_LOCATION_PAGE( location ) ( ( (location) >> 16 ) & 0xff )
+#define PROFILE_LOCATION_ADDRESS( location ) ( (location) & 0xffff )
+
+/* Enough for any location's name */
+#define PROFILE_NAME_LENGTH 20
+
+/* The T-states spent on each instruction, by the page it was in and
+   the 16Kb of the address space the page was mapped into; allocated
+   only once code has been run from there */
+static libspectrum_dword *total_tstates[ PROFILE_BANKS ][ PROFILE_PAGES ][ 4 ];
+
+/* Somewhere to count T-states if there was no memory to allocate the
+   place they should have gone */
+static libspectrum_dword profile_lost_tstates;
+
+/* Each different chain of calls which has been seen */
+typedef struct profile_node {
+
+  libspectrum_dword routine;	/* The location called */
+  libspectrum_dword calls;
+
+  libspectrum_qword tstates;	/* Spent in the routine itself */
+  libspectrum_qword inclusive;	/* And in everything it called; only
+				   worked out when writing the profile */
+
+  struct profile_node *parent, *child, *sibling;
+
+} profile_node;
+
+/* Everything run while we don't know what called it */
+static profile_node profile_root;
+
+/* The routines called and not yet returned from */
+typedef struct profile_call {
+
+  profile_node *node;
+  libspectrum_word sp;		/* Where the return address is */
+
+} profile_call;
+
+/* Deeper calls are counted as part of the routine which made them */
+#define PROFILE_STACK_DEPTH 256
+
+static profile_call profile_stack[ PROFILE_STACK_DEPTH ];
+static size_t profile_depth;
+
+static int profile_out_of_memory;
+
+/* The instruction now being run */
+static libspectrum_word profile_last_sp;
 static libspectrum_dword profile_last_tstates;
+static libspectrum_dword *profile_last_total;
+static int profile_last_call;
 
 static void profile_from_snapshot( libspectrum_snap *snap GCC_UNUSED );
+static void free_profile( void );
 
 static module_info_t profile_module_info = {
 
@@ -63,17 +139,135 @@ profile_init( void )
   return 0;
 }
 
+/* Where the code at 'address' is coming from */
+static libspectrum_dword
+profile_location( libspectrum_word address )
+{
+  memory_page *page = &memory_map_read[ address >> 13 ];
+  libspectrum_dword bank, page_num;
+
+  switch( page->bank ) {
+  case MEMORY_BANK_HOME:
+    bank = page->writable ? PROFILE_BANK_RAM : PROFILE_BANK_ROM; break;
+  case MEMORY_BANK_DOCK: bank = PROFILE_BANK_DOCK; break;
+  case MEMORY_BANK_EXROM: bank = PROFILE_BANK_EXROM; break;
+  case MEMORY_BANK_ROMCS: bank = PROFILE_BANK_ROMCS; break;
+  default: bank = PROFILE_BANK_NONE; break;
+  }
+
+  page_num = page->page_num >= 0 && page->page_num < PROFILE_PAGES ?
+             page->page_num : 0;
+
+  return ( bank << 24 ) | ( page_num << 16 ) | address;
+}
+
 static void
-init_profiling_counters( void )
+location_name( char *buffer, size_t length, libspectrum_dword location )
 {
-  profile_last_pc = z80.pc.w;
+  snprintf( buffer, length, "%s%d:0x%04x",
+	    profile_bank_names[ PROFILE_LOCATION_BANK( location ) ],
+	    (int)PROFILE_LOCATION_PAGE( location ),
+	    (unsigned)PROFILE_LOCATION_ADDRESS( location ) );
+}
+
+/* Note the state as the instruction at 'pc' starts */
+static void
+start_instruction( libspectrum_word pc )
+{
+  libspectrum_dword location = profile_location( pc );
+  libspectrum_dword **totals;
+  libspectrum_word address = pc;
+  libspectrum_byte opcode;
+  int prefixes = 0;
+
+  totals = &total_tstates[ PROFILE_LOCATION_BANK( location ) ]
+			 [ PROFILE_LOCATION_PAGE( location ) ][ pc >> 14 ];
+  if( !*totals ) {
+    *totals = calloc( 0x4000, sizeof( **totals ) );
+    if( !*totals ) profile_out_of_memory = 1;
+  }
+  profile_last_total = *totals ? &( *totals )[ pc & 0x3fff ] :
+				 &profile_lost_tstates;
+
+  /* An index prefix with no effect on the opcode after it is run as
+     part of the same instruction */
+  do {
+    opcode = readbyte_internal( address ); address++;
+  } while( ( opcode == 0xdd || opcode == 0xfd ) && ++prefixes < 8 );
+
+  /* CALL nn, CALL cc,nn or RST */
+  profile_last_call = opcode == 0xcd || ( opcode & 0xc7 ) == 0xc4 ||
+		      ( opcode & 0xc7 ) == 0xc7;
+
+  profile_last_sp = z80.sp.w;
   profile_last_tstates = tstates;
 }
 
+/* 'pc', with its return address at 'sp', has just been called */
+static void
+call( libspectrum_word pc, libspectrum_word sp )
+{
+  profile_node *parent, *node;
+  libspectrum_dword routine;
+
+  if( profile_depth == PROFILE_STACK_DEPTH ) return;
+
+  parent = profile_stack[ profile_depth - 1 ].node;
+  routine = profile_location( pc );
+
+  for( node = parent->child; node; node = node->sibling )
+    if( node->routine == routine ) break;
+
+  if( !node ) {
+    node = calloc( 1, sizeof( *node ) );
+    if( !node ) { profile_out_of_memory = 1; return; }
+
+    node->routine = routine;
+    node->parent = parent;
+    node->sibling = parent->child; parent->child = node;
+  }
+
+  node->calls++;
+
+  profile_stack[ profile_depth ].node = node;
+  profile_stack[ profile_depth ].sp = sp;
+  profile_depth++;
+}
+
+/* Count the T-states taken by the last instruction, which has left the
+   stack pointer at 'sp' and would go on to 'pc' */
+static void
+finish_instruction( libspectrum_word pc, libspectrum_word sp )
+{
+  libspectrum_dword delta = tstates - profile_last_tstates;
+
+  *profile_last_total += delta;
+  profile_stack[ profile_depth - 1 ].node->tstates += delta;
+
+  /* Everything whose return address is no longer on the stack has
+     returned, however it did so */
+  while( profile_depth > 1 && profile_stack[ profile_depth - 1 ].sp < sp )
+    profile_depth--;
+
+  /* A call which wasn't taken leaves the stack alone */
+  if( profile_last_call && sp == (libspectrum_word)( profile_last_sp - 2 ) )
+    call( pc, sp );
+}
+
+static void
+init_profiling_counters( void )
+{
+  profile_stack[0].node = &profile_root;
+  profile_stack[0].sp = 0xffff;
+  profile_depth = 1;
+
+  start_instruction( z80.pc.w );
+}
+
 void
 profile_start( void )
 {
-  memset( total_tstates, 0, sizeof( total_tstates ) );
+  free_profile();
 
   profile_active = 1;
   init_profiling_counters();
@@ -91,10 +285,21 @@ profile_map( libspectrum_word pc )
 {
   if( tstates - profile_last_tstates > 256 ) fuse_abort();
 
-  total_tstates[ profile_last_pc ] += tstates - profile_last_tstates;
+  finish_instruction( pc, z80.sp.w );
+  start_instruction( pc );
+}
 
-  profile_last_pc = z80.pc.w;
-  profile_last_tstates = tstates;
+void
+profile_interrupt( void )
+{
+  libspectrum_word sp = z80.sp.w, pc;
+
+  /* The interrupted code would have gone on to the address just pushed */
+  pc = readbyte_internal( sp ) | ( readbyte_internal( sp + 1 ) << 8 );
+  finish_instruction( pc, sp + 2 );
+
+  call( z80.pc.w, sp );
+  start_instruction( z80.pc.w );
 }
 
 void
@@ -103,37 +308,199 @@ profile_frame( libspectrum_dword frame_length )
   profile_last_tstates -= frame_length;
 }
 
-/* On snapshot load, PC and the tstate counter will jump so reset our
-   current views of these */
+/* On snapshot load, PC and the tstate counter will jump and the stack
+   is replaced, so reset our current views of these */
 static void
 profile_from_snapshot( libspectrum_snap *snap GCC_UNUSED )
 {
-  init_profiling_counters();
+  if( profile_active ) init_profiling_counters();
 }
 
-void
-profile_finish( const char *filename )
+static FILE*
+open_output( const char *filename, const char *extension )
 {
+  char *name;
   FILE *f;
-  size_t i;
 
-  f = fopen( filename, "w" );
-  if( !f ) {
+  name = malloc( strlen( filename ) + strlen( extension ) + 1 );
+  if( !name ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+  strcpy( name, filename ); strcat( name, extension );
+
+  f = fopen( name, "w" );
+  if( !f )
     ui_error( UI_ERROR_ERROR, "unable to open profile map '%s' for writing",
-	      filename );
+	      name );
+
+  free( name );
+
+  return f;
+}
+
+static void
+write_map( FILE *f )
+{
+  size_t bank, page, slot, i;
+  libspectrum_dword *totals;
+
+  for( bank = 0; bank < PROFILE_BANKS; bank++ )
+    for( page = 0; page < PROFILE_PAGES; page++ )
+      for( slot = 0; slot < 4; slot++ ) {
+
+	totals = total_tstates[ bank ][ page ][ slot ];
+	if( !totals ) continue;
+
+	for( i = 0; i < 0x4000; i++ ) {
+
+	  if( !totals[ i ] ) continue;
+
+	  fprintf( f, "0x%04lx,%lu,%s%lu\n", (unsigned long)( slot << 14 | i ),
+		   (unsigned long)totals[ i ], profile_bank_names[ bank ],
+		   (unsigned long)page );
+	}
+      }
+}
+
+/* One line for each chain of calls, as used to draw flame graphs */
+static void
+write_stacks( FILE *f, const profile_node *node, char *path, size_t length )
+{
+  const profile_node *child;
+
+  if( node != &profile_root ) {
+    if( length ) path[ length++ ] = ';';
+    location_name( &path[ length ], PROFILE_NAME_LENGTH, node->routine );
+    length += strlen( &path[ length ] );
+  }
+
+  if( node->tstates )
+    fprintf( f, "%s %llu\n", length ? path : "[unknown]",
+	     (unsigned long long)node->tstates );
+
+  for( child = node->child; child; child = child->sibling )
+    write_stacks( f, child, path, length );
+}
+
+/* Work out the inclusive T-states for 'node', and put it and
+   everything it called into 'list' */
+static libspectrum_qword
+gather_nodes( profile_node *node, profile_node ***list )
+{
+  profile_node *child;
+
+  *( *list )++ = node;
+
+  node->inclusive = node->tstates;
+  for( child = node->child; child; child = child->sibling )
+    node->inclusive += gather_nodes( child, list );
+
+  return node->inclusive;
+}
+
+static size_t
+count_nodes( const profile_node *node )
+{
+  const profile_node *child;
+  size_t count = 1;
+
+  for( child = node->child; child; child = child->sibling )
+    count += count_nodes( child );
+
+  return count;
+}
+
+static int
+compare_routine( const void *a, const void *b )
+{
+  libspectrum_dword routine1 = ( *(profile_node* const*)a )->routine,
+		    routine2 = ( *(profile_node* const*)b )->routine;
+
+  return routine1 < routine2 ? -1 : routine1 > routine2;
+}
+
+/* Each routine called, with the calls made to it and the T-states
+   spent in it, including and excluding the routines it called */
+static void
+write_routines( FILE *f )
+{
+  profile_node **nodes, **end, **group, **ptr;
+  const profile_node *ancestor;
+  libspectrum_qword inclusive, exclusive;
+  libspectrum_dword calls;
+  char name[ PROFILE_NAME_LENGTH ];
+  size_t count;
+
+  /* Not including the root */
+  count = count_nodes( &profile_root ) - 1;
+  if( !count ) return;
+
+  nodes = malloc( ( count + 1 ) * sizeof( *nodes ) );
+  if( !nodes ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
     return;
   }
 
-  for( i = 0; i < 0x10000; i++ ) {
+  end = nodes;
+  gather_nodes( &profile_root, &end );
+  qsort( nodes + 1, count, sizeof( *nodes ), compare_routine );
+
+  for( group = nodes + 1; group < end; group = ptr ) {
+
+    inclusive = exclusive = 0; calls = 0;
+
+    for( ptr = group; ptr < end && ( *ptr )->routine == ( *group )->routine;
+	 ptr++ ) {
 
-    if( !total_tstates[ i ] ) continue;
+      calls += ( *ptr )->calls;
+      exclusive += ( *ptr )->tstates;
 
-    fprintf( f, "0x%04lx,%d\n", (unsigned long)i, total_tstates[ i ] );
+      /* When a routine is called from within itself, the inner call's
+	 time is already included in the outer one's */
+      for( ancestor = ( *ptr )->parent; ancestor != &profile_root;
+	   ancestor = ancestor->parent )
+	if( ancestor->routine == ( *ptr )->routine ) break;
+      if( ancestor == &profile_root ) inclusive += ( *ptr )->inclusive;
+    }
 
+    location_name( name, sizeof( name ), ( *group )->routine );
+    fprintf( f, "%s,%lu,%llu,%llu\n", name, (unsigned long)calls,
+	     (unsigned long long)inclusive, (unsigned long long)exclusive );
   }
 
+  free( nodes );
+}
+
+void
+profile_finish( const char *filename )
+{
+  char path[ PROFILE_STACK_DEPTH * PROFILE_NAME_LENGTH ];
+  FILE *f;
+
+  f = open_output( filename, "" );
+  if( !f ) return;
+  write_map( f );
   fclose( f );
 
+  f = open_output( filename, ".stacks" );
+  if( f ) {
+    write_stacks( f, &profile_root, path, 0 );
+    fclose( f );
+  }
+
+  f = open_output( filename, ".routines" );
+  if( f ) {
+    write_routines( f );
+    fclose( f );
+  }
+
+  if( profile_out_of_memory )
+    ui_error( UI_ERROR_WARNING,
+	      "ran out of memory while profiling; profile is incomplete" );
+
+  free_profile();
+
   profile_active = 0;
 
   /* Again, schedule an event to ensure this change is picked up by
@@ -142,3 +509,34 @@ profile_finish( const char *filename )
 
   ui_menu_activate( UI_MENU_ITEM_MACHINE_PROFILER, 0 );
 }
+
+static void
+free_node( profile_node *node )
+{
+  profile_node *child, *next;
+
+  for( child = node->child; child; child = next ) {
+    next = child->sibling;
+    free_node( child );
+    free( child );
+  }
+}
+
+static void
+free_profile( void )
+{
+  size_t bank, page, slot;
+
+  for( bank = 0; bank < PROFILE_BANKS; bank++ )
+    for( page = 0; page < PROFILE_PAGES; page++ )
+      for( slot = 0; slot < 4; slot++ ) {
+	free( total_tstates[ bank ][ page ][ slot ] );
+	total_tstates[ bank ][ page ][ slot ] = NULL;
+      }
+
+  free_node( &profile_root );
+  memset( &profile_root, 0, sizeof( profile_root ) );
+  profile_root.routine = 0xffffffff;
+
+  profile_out_of_memory = 0;
+}
@@ -32,6 +32,16 @@ int profile_init( void );
 void profile_start( void );
 void profile_map( libspectrum_word pc );
 void profile_frame( libspectrum_dword frame_length );
+
+/* An interrupt has just been accepted */
+void profile_interrupt( void );
+
+/* Write the T-states spent on each instruction to 'filename', one
+   address, total and page per line; the T-states spent in each chain
+   of calls to 'filename'.stacks, in the collapsed stack format read by
+   flame graph tools; and the calls made to each routine and the
+   T-states spent in it, including and excluding what it called, to
+   'filename'.routines */
 void profile_finish( const char *filename );
 
 #endif			/* #ifndef FUSE_PROFILE_H */
@@ -1127,6 +1127,10 @@ libspectrum_rzx_write( libspectrum_byte **buffer, size_t *length,
 		       libspectrum_rzx *rzx, libspectrum_id_t snap_format,
 		       libspectrum_creator *creator, int compress,
 		       libspectrum_rzx_dsa_key *key );
+libspectrum_error
+libspectrum_rzx_flush( libspectrum_byte **buffer, size_t *length,
+		       libspectrum_rzx *rzx, libspectrum_id_t snap_format,
+		       libspectrum_creator *creator, int compress );
 
 /* Something to step through all the blocks in an input recording */
 typedef struct _GSList *libspectrum_rzx_iterator;
@@ -127,6 +127,9 @@ struct libspectrum_rzx {
   const libspectrum_byte *signed_start;
   size_t signed_length;
 
+  /* Has libspectrum_rzx_flush() written the file header yet? */
+  int flushed;
+
 };
 
 static libspectrum_error
@@ -149,6 +152,11 @@ static libspectrum_error
 rzx_read_sign_end( libspectrum_rzx *rzx, const libspectrum_byte **ptr,
 		   const libspectrum_byte *end );
 
+static libspectrum_error
+rzx_write_block( rzx_block_t *block, libspectrum_byte **buffer,
+		 libspectrum_byte **ptr, size_t *length,
+		 libspectrum_id_t snap_format, libspectrum_creator *creator,
+		 int compress );
 static void
 rzx_write_header( libspectrum_byte **buffer, libspectrum_byte **ptr,
 		  size_t *length, ptrdiff_t *sign_offset, int sign );
@@ -264,6 +272,7 @@ libspectrum_rzx_alloc( void )
   rzx->current_block = NULL;
   rzx->current_input = NULL;
   rzx->signed_start = NULL;
+  rzx->flushed = 0;
   return rzx;
 }
 
@@ -1251,39 +1260,91 @@ libspectrum_rzx_write( libspectrum_byte **buffer, size_t *length,
   }
 
   for( list = rzx->blocks; list; list = list->next ) {
+    error = rzx_write_block( list->data, buffer, &ptr, length, snap_format,
+			     creator, compress );
+    if( error != LIBSPECTRUM_ERROR_NONE ) return error;
+  }
 
-    rzx_block_t *block = list->data;
+  if( key ) {
+    error = rzx_write_signed_end( buffer, &ptr, length, sign_offset, key );
+    if( error != LIBSPECTRUM_ERROR_NONE ) return error;
+  }
+  
+  /* *length is the allocated size; we want to return how much is used */
+  *length = ptr - *buffer;
 
-    switch( block->type ) {
+  return LIBSPECTRUM_ERROR_NONE;
+}
 
-    case LIBSPECTRUM_RZX_SNAPSHOT_BLOCK:
-      error = rzx_write_snapshot( buffer, &ptr, length, block->types.snap.snap,
-				  snap_format, creator, compress );
-      if( error != LIBSPECTRUM_ERROR_NONE ) return error;
-      break;
+/* Write out all the blocks recorded so far and then forget about them,
+   so a long recording can be written to disk as it is made rather than
+   held in memory. The first call also writes the file header; append
+   the output of each call to the file. Signing is not supported as the
+   whole file is never available at once */
+libspectrum_error
+libspectrum_rzx_flush( libspectrum_byte **buffer, size_t *length,
+		       libspectrum_rzx *rzx, libspectrum_id_t snap_format,
+		       libspectrum_creator *creator, int compress )
+{
+  libspectrum_error error;
+  libspectrum_byte *ptr = *buffer;
+  GSList *list;
+  ptrdiff_t sign_offset;
 
-    case LIBSPECTRUM_RZX_INPUT_BLOCK:
-      error = rzx_write_input( &( block->types.input ), buffer, &ptr, length,
-			       compress );
-      if( error != LIBSPECTRUM_ERROR_NONE ) return error;
-      break;
+  if( !rzx->flushed ) {
+    rzx_write_header( buffer, &ptr, length, &sign_offset, 0 );
+    if( creator ) rzx_write_creator( buffer, &ptr, length, creator );
+  }
 
-    case LIBSPECTRUM_RZX_CREATOR_BLOCK:
-    case LIBSPECTRUM_RZX_SIGN_START_BLOCK:
-    case LIBSPECTRUM_RZX_SIGN_END_BLOCK:
-      break;
+  for( list = rzx->blocks; list; list = list->next ) {
 
-    }
-  }
+    rzx_block_t *block = list->data;
 
-  if( key ) {
-    error = rzx_write_signed_end( buffer, &ptr, length, sign_offset, key );
+    /* Don't bother writing input blocks with nothing in them */
+    if( block->type == LIBSPECTRUM_RZX_INPUT_BLOCK &&
+	!block->types.input.count )
+      continue;
+
+    error = rzx_write_block( block, buffer, &ptr, length, snap_format,
+			     creator, compress );
     if( error != LIBSPECTRUM_ERROR_NONE ) return error;
   }
-  
-  /* *length is the allocated size; we want to return how much is used */
+
   *length = ptr - *buffer;
 
+  g_slist_foreach( rzx->blocks, block_free_wrapper, NULL );
+  g_slist_free( rzx->blocks );
+  rzx->blocks = NULL;
+  rzx->current_input = NULL;
+
+  rzx->flushed = 1;
+
+  return LIBSPECTRUM_ERROR_NONE;
+}
+
+static libspectrum_error
+rzx_write_block( rzx_block_t *block, libspectrum_byte **buffer,
+		 libspectrum_byte **ptr, size_t *length,
+		 libspectrum_id_t snap_format, libspectrum_creator *creator,
+		 int compress )
+{
+  switch( block->type ) {
+
+  case LIBSPECTRUM_RZX_SNAPSHOT_BLOCK:
+    return rzx_write_snapshot( buffer, ptr, length, block->types.snap.snap,
+			       snap_format, creator, compress );
+
+  case LIBSPECTRUM_RZX_INPUT_BLOCK:
+    return rzx_write_input( &( block->types.input ), buffer, ptr, length,
+			    compress );
+
+  case LIBSPECTRUM_RZX_CREATOR_BLOCK:
+  case LIBSPECTRUM_RZX_SIGN_START_BLOCK:
+  case LIBSPECTRUM_RZX_SIGN_END_BLOCK:
+    break;
+
+  }
+
   return LIBSPECTRUM_ERROR_NONE;
 }
 
@@ -0,0 +1,519 @@
+/* rewind.c: Step back through recent emulation
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Every settings_current.rewind_frames frames, the state of the machine
+   is stored without going through libspectrum: the Z80, ULA, paging,
+   AY and event queue are copied as they are, and RAM is stored as the
+   8K chunks which have changed since the previous state, XORed with
+   their old contents and run-length encoded.
+
+   A reference copy of RAM as it was when the newest state was stored is
+   kept; going back restores RAM from the reference and then undoes the
+   newest state's changes to the reference, so that it matches the next
+   newest state. Old states are thrown away once more than
+   settings_current.rewind_size megabytes are in use.
+
+   Peripherals (tape, disks, interfaces) are not rewound, so only the
+   frame and interrupt events are taken from a stored state; the
+   peripherals' pending events are left as they are */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libspectrum.h>
+
+#include "display.h"
+#include "event.h"
+#include "machine.h"
+#include "memory.h"
+#include "module.h"
+#include "rewind.h"
+#include "rzx.h"
+#include "scld.h"
+#include "settings.h"
+#include "sound.h"
+#include "spectrum.h"
+#include "ui/ui.h"
+#include "ula.h"
+#include "z80/z80.h"
+
+/* RAM is stored in chunks of this many bytes */
+#define REWIND_CHUNK_SIZE MEMORY_PAGE_SIZE
+#define REWIND_CHUNKS ( 2 * SPECTRUM_RAM_PAGES )
+
+/* The worst case for the encoding used by rewind_encode() */
+#define REWIND_ENCODED_MAX ( 3 * REWIND_CHUNK_SIZE / 2 + 2 )
+
+/* The changes to one chunk of RAM */
+typedef struct rewind_delta {
+  int chunk;
+  size_t length;
+  libspectrum_byte *data;
+} rewind_delta;
+
+typedef struct rewind_entry {
+
+  libspectrum_machine machine;
+
+  processor z80;
+  libspectrum_dword tstates;
+
+  spectrum_raminfo ram;
+  ayinfo ay;
+  scld scld_dec;
+  libspectrum_byte scld_hsr;
+
+  ula_state ula;
+  event_state *event;
+
+  /* How RAM differs from the previous entry */
+  rewind_delta *deltas;
+  size_t delta_count;
+
+  size_t size;			/* Total memory used by this entry */
+
+} rewind_entry;
+
+/* The stored states, oldest first, in a ring */
+static rewind_entry **entries = NULL;
+static size_t entries_allocated = 0, entries_first = 0, entries_count = 0;
+
+/* RAM as it was when the newest state was stored */
+static libspectrum_byte *reference[ REWIND_CHUNKS ];
+static size_t reference_chunks = 0;
+
+/* Memory used by the stored states and the reference copy */
+static size_t rewind_used = 0;
+
+static int rewind_held = 0;
+static int rewind_frame_count = 0;
+
+static void rewind_module_reset( int hard_reset );
+
+static module_info_t rewind_module_info = {
+
+  rewind_module_reset,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+
+};
+
+int
+rewind_init( void )
+{
+  module_register( &rewind_module_info );
+
+  return 0;
+}
+
+/* How many 16K RAM pages could the current machine be using? Every
+   page a machine can map is marked writable when it is set up, so this
+   is found from the highest writable one; this also covers the SE's
+   extra page and its dock and EXROM banks */
+static size_t
+rewind_ram_pages( void )
+{
+  size_t i;
+
+  for( i = 2 * SPECTRUM_RAM_PAGES; i > 0; i-- )
+    if( memory_map_ram[ i - 1 ].writable ) break;
+
+  return ( i + 1 ) / 2;
+}
+
+static libspectrum_byte*
+rewind_chunk( int chunk )
+{
+  return RAM[ chunk / 2 ] + ( chunk % 2 ) * REWIND_CHUNK_SIZE;
+}
+
+/* Encode 'data' XOR 'old' as a series of (count of unchanged bytes,
+   count of changed bytes, changed bytes XOR old) runs */
+static size_t
+rewind_encode( libspectrum_byte *dest, const libspectrum_byte *data,
+	       const libspectrum_byte *old )
+{
+  size_t i = 0, length = 0, count_pos, count;
+
+  while( i < REWIND_CHUNK_SIZE ) {
+
+    count = 0;
+    while( i < REWIND_CHUNK_SIZE && count < 0xff && data[i] == old[i] ) {
+      count++; i++;
+    }
+    dest[ length++ ] = count;
+
+    count_pos = length++; count = 0;
+    while( i < REWIND_CHUNK_SIZE && count < 0xff && data[i] != old[i] ) {
+      dest[ length++ ] = data[i] ^ old[i];
+      count++; i++;
+    }
+    dest[ count_pos ] = count;
+
+  }
+
+  return length;
+}
+
+/* Apply (or undo; XOR is its own inverse) an encoded delta */
+static void
+rewind_decode( libspectrum_byte *dest, const libspectrum_byte *data,
+	       size_t length )
+{
+  size_t i = 0, pos = 0, count;
+
+  while( pos < length ) {
+    i += data[ pos++ ];
+    count = data[ pos++ ];
+    while( count-- ) dest[ i++ ] ^= data[ pos++ ];
+  }
+}
+
+static void
+rewind_free_deltas( rewind_entry *entry )
+{
+  size_t i;
+
+  for( i = 0; i < entry->delta_count; i++ ) {
+    entry->size -= sizeof( entry->deltas[i] ) + entry->deltas[i].length;
+    free( entry->deltas[i].data );
+  }
+
+  free( entry->deltas );
+  entry->deltas = NULL;
+  entry->delta_count = 0;
+}
+
+static void
+rewind_free_entry( rewind_entry *entry )
+{
+  rewind_free_deltas( entry );
+  if( entry->event ) event_state_free( entry->event );
+  free( entry );
+}
+
+static rewind_entry*
+rewind_newest( void )
+{
+  return entries[ ( entries_first + entries_count - 1 ) % entries_allocated ];
+}
+
+static void
+rewind_drop_oldest( void )
+{
+  rewind_entry *entry = entries[ entries_first ];
+
+  rewind_used -= entry->size;
+  rewind_free_entry( entry );
+
+  entries_first = ( entries_first + 1 ) % entries_allocated;
+  entries_count--;
+
+  /* The oldest state's changes are only needed to go back to the state
+     before it, which has now gone */
+  if( entries_count ) {
+    entry = entries[ entries_first ];
+    rewind_used -= entry->size;
+    rewind_free_deltas( entry );
+    rewind_used += entry->size;
+  }
+}
+
+static int
+rewind_push( rewind_entry *entry )
+{
+  rewind_entry **new_entries;
+  size_t new_allocated, i;
+
+  if( entries_count == entries_allocated ) {
+
+    new_allocated = entries_allocated ? 2 * entries_allocated : 64;
+
+    new_entries = malloc( new_allocated * sizeof( *new_entries ) );
+    if( !new_entries ) {
+      ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__, __LINE__ );
+      return 1;
+    }
+
+    for( i = 0; i < entries_count; i++ )
+      new_entries[i] = entries[ ( entries_first + i ) % entries_allocated ];
+
+    free( entries );
+    entries = new_entries; entries_allocated = new_allocated;
+    entries_first = 0;
+  }
+
+  entries[ ( entries_first + entries_count ) % entries_allocated ] = entry;
+  entries_count++;
+
+  rewind_used += entry->size;
+
+  return 0;
+}
+
+/* Store the changes to RAM since the last call in 'entry', and bring
+   the reference copy up to date */
+static int
+rewind_store_ram( rewind_entry *entry )
+{
+  static libspectrum_byte buffer[ REWIND_ENCODED_MAX ];
+  rewind_delta deltas[ REWIND_CHUNKS ];
+  size_t i, count = 0;
+
+  /* The first state needs no changes, just a copy to start from */
+  if( !reference_chunks ) {
+
+    for( i = 0; i < 2 * rewind_ram_pages(); i++ ) {
+      reference[i] = malloc( REWIND_CHUNK_SIZE );
+      if( !reference[i] ) {
+	ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__,
+		  __LINE__ );
+	return 1;
+      }
+      memcpy( reference[i], rewind_chunk( i ), REWIND_CHUNK_SIZE );
+      reference_chunks++;
+      rewind_used += REWIND_CHUNK_SIZE;
+    }
+
+    return 0;
+  }
+
+  for( i = 0; i < reference_chunks; i++ ) {
+
+    libspectrum_byte *chunk = rewind_chunk( i );
+
+    if( !memcmp( chunk, reference[i], REWIND_CHUNK_SIZE ) ) continue;
+
+    deltas[ count ].chunk = i;
+    deltas[ count ].length = rewind_encode( buffer, chunk, reference[i] );
+    deltas[ count ].data = malloc( deltas[ count ].length );
+    if( !deltas[ count ].data ) break;
+    memcpy( deltas[ count ].data, buffer, deltas[ count ].length );
+
+    memcpy( reference[i], chunk, REWIND_CHUNK_SIZE );
+    count++;
+  }
+
+  /* If we ran out of memory, the reference no longer matches any
+     stored state */
+  if( i < reference_chunks ) {
+    while( count-- ) free( deltas[ count ].data );
+    ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__, __LINE__ );
+    return 1;
+  }
+
+  if( !count ) return 0;
+
+  entry->deltas = malloc( count * sizeof( *entry->deltas ) );
+  if( !entry->deltas ) {
+    while( count-- ) free( deltas[ count ].data );
+    ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__, __LINE__ );
+    return 1;
+  }
+
+  memcpy( entry->deltas, deltas, count * sizeof( *entry->deltas ) );
+  entry->delta_count = count;
+  for( i = 0; i < count; i++ )
+    entry->size += sizeof( deltas[i] ) + deltas[i].length;
+
+  return 0;
+}
+
+static int
+rewind_store( void )
+{
+  rewind_entry *entry;
+  size_t limit;
+
+  entry = calloc( 1, sizeof( *entry ) );
+  if( !entry ) {
+    ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__, __LINE__ );
+    return 1;
+  }
+
+  entry->machine = machine_current->machine;
+  entry->z80 = z80;
+  entry->tstates = tstates;
+  entry->ram = machine_current->ram;
+  entry->ay = machine_current->ay;
+  entry->scld_dec = scld_last_dec;
+  entry->scld_hsr = scld_last_hsr;
+
+  ula_state_save( &entry->ula );
+  entry->event = event_state_copy();
+  if( !entry->event ) {
+    rewind_free_entry( entry );
+    return 1;
+  }
+
+  entry->size = sizeof( *entry ) + event_state_size( entry->event );
+
+  if( rewind_store_ram( entry ) ) {
+    rewind_free_entry( entry );
+    rewind_reset();
+    return 1;
+  }
+
+  if( rewind_push( entry ) ) {
+    rewind_free_entry( entry );
+    rewind_reset();
+    return 1;
+  }
+
+  limit = (size_t)settings_current.rewind_size * 1024 * 1024;
+  while( rewind_used > limit && entries_count > 1 ) rewind_drop_oldest();
+
+  return 0;
+}
+
+int
+rewind_step( void )
+{
+  rewind_entry *entry;
+  int machine_events[] = {
+    spectrum_frame_event, z80_interrupt_event, z80_nmi_event
+  };
+  size_t machine_event_count =
+    sizeof( machine_events ) / sizeof( machine_events[0] );
+  size_t i;
+
+  if( !entries_count ) return 1;
+
+  entry = rewind_newest();
+
+  /* Shouldn't happen as changing machine resets everything */
+  if( entry->machine != machine_current->machine ) {
+    rewind_reset();
+    return 1;
+  }
+
+  for( i = 0; i < reference_chunks; i++ ) {
+    libspectrum_byte *chunk = rewind_chunk( i );
+    if( memcmp( chunk, reference[i], REWIND_CHUNK_SIZE ) )
+      memcpy( chunk, reference[i], REWIND_CHUNK_SIZE );
+  }
+
+  z80 = entry->z80;
+  tstates = entry->tstates;
+  machine_current->ram = entry->ram;
+  machine_current->ay = entry->ay;
+  scld_last_dec = entry->scld_dec;
+  scld_last_hsr = entry->scld_hsr;
+  ula_state_load( &entry->ula );
+  if( event_state_restore_types( entry->event, machine_events,
+				 machine_event_count ) )
+    return 1;
+
+  machine_current->memory_map();
+
+  for( i = 0; i < AY_REGISTERS; i++ )
+    sound_ay_write( i, machine_current->ay.registers[i], tstates );
+
+  display_set_lores_border( ula_last_byte() & 0x07 );
+  display_refresh_all();
+
+  /* Keep the oldest state around so holding the control just stays
+     there */
+  if( entries_count > 1 ) {
+
+    for( i = 0; i < entry->delta_count; i++ )
+      rewind_decode( reference[ entry->deltas[i].chunk ],
+		     entry->deltas[i].data, entry->deltas[i].length );
+
+    rewind_used -= entry->size;
+    rewind_free_entry( entry );
+    entries_count--;
+  }
+
+  rewind_frame_count = 0;
+
+  return 0;
+}
+
+void
+rewind_frame( void )
+{
+  /* Going back would desynchronise any RZX file in use, and storing
+     states would only slow down headless or turbo running */
+  if( !settings_current.rewind_size || rzx_recording || rzx_playback ||
+      settings_current.headless || settings_current.turbo )
+    return;
+
+  if( rewind_held ) {
+    rewind_step();
+    return;
+  }
+
+  if( ++rewind_frame_count < settings_current.rewind_frames ) return;
+  rewind_frame_count = 0;
+
+  rewind_store();
+}
+
+void
+rewind_hold( int active )
+{
+  rewind_held = active;
+}
+
+void
+rewind_reset( void )
+{
+  size_t i;
+
+  while( entries_count ) {
+    rewind_free_entry( entries[ entries_first ] );
+    entries_first = ( entries_first + 1 ) % entries_allocated;
+    entries_count--;
+  }
+  entries_first = 0;
+
+  for( i = 0; i < reference_chunks; i++ ) {
+    free( reference[i] );
+    reference[i] = NULL;
+  }
+  reference_chunks = 0;
+
+  rewind_used = 0;
+  rewind_frame_count = 0;
+}
+
+static void
+rewind_module_reset( int hard_reset GCC_UNUSED )
+{
+  rewind_reset();
+}
+
+int
+rewind_end( void )
+{
+  rewind_reset();
+
+  free( entries );
+  entries = NULL;
+  entries_allocated = 0;
+
+  return 0;
+}
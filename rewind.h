@@ -0,0 +1,42 @@
+/* rewind.h: Step back through recent emulation
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef FUSE_REWIND_H
+#define FUSE_REWIND_H
+
+int rewind_init( void );
+
+/* Called at the end of every frame to either store the current state
+   or, if rewinding, go back to an earlier one */
+void rewind_frame( void );
+
+/* Start or stop going back one stored state per frame */
+void rewind_hold( int active );
+
+/* Go back to the most recently stored state; returns non-zero if there
+   is nothing to go back to */
+int rewind_step( void );
+
+void rewind_reset( void );
+
+int rewind_end( void );
+
+#endif			/* #ifndef FUSE_REWIND_H */
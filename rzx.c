@@ -25,7 +25,9 @@
 
 #include <config.h>
 
+#include <errno.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -76,6 +78,11 @@ int rzx_competition_mode;
 /* The filename we'll save this recording into */
 static char *rzx_filename;
 
+/* If the recording is being written out as it is made, the file it is
+   going into, and the number of frames since it was last written to */
+static FILE *rzx_stream;
+static size_t rzx_stream_frames;
+
 /* Are we currently playing back a .rzx file? */
 int rzx_playback;
 
@@ -85,6 +92,9 @@ size_t rzx_instruction_count;
 /* The current RZX data */
 libspectrum_rzx *rzx;
 
+/* Why did the last playback end? */
+rzx_playback_result rzx_last_playback_result = RZX_PLAYBACK_FINISHED;
+
 /* Fuse's DSA key */
 libspectrum_rzx_dsa_key rzx_key = {
   "A9E3BD74E136A9ABD41E614383BB1B01EB24B2CD7B920ED6A62F786A879AC8B00F2FF318BF96F81654214B1A064889FF6D8078858ED00CF61D2047B2AAB7888949F35D166A2BBAAE23A331BD4728A736E76901D74B195B68C4A2BBFB9F005E3655BDE8256C279A626E00C7087A2D575F78D7DC5CA6E392A535FFE47A816BA503", /* p */
@@ -109,6 +119,7 @@ int end_event;
 
 static int start_playback( libspectrum_rzx *rzx );
 static int recording_frame( void );
+static int stream_flush( int restart );
 static int playback_frame( void );
 static int counter_reset( void );
 static void rzx_sentinel( libspectrum_dword tstates, int type,
@@ -144,6 +155,7 @@ int rzx_start_recording( const char *filename, int embed_snapshot )
   rzx_filename = strdup( filename );
   if( rzx_filename == NULL ) {
     ui_error( UI_ERROR_ERROR, "out of memory in rzx_start_recording" );
+    libspectrum_rzx_free( rzx );
     return 1;
   }
 
@@ -155,25 +167,52 @@ int rzx_start_recording( const char *filename, int embed_snapshot )
     error = snapshot_copy_to( snap );
     if( error ) {
       libspectrum_snap_free( snap );
+      free( rzx_filename );
+      libspectrum_rzx_free( rzx );
       return 1;
     }
 
     error = libspectrum_rzx_add_snap( rzx, snap, 0 );
     if( error ) {
       libspectrum_snap_free( snap );
+      free( rzx_filename );
+      libspectrum_rzx_free( rzx );
       return error;
     }
 
   }
 
+  /* Competition mode recordings have to be signed as a whole, so can
+     only be written out at the end. The file is only created once
+     everything which could fail before recording starts has succeeded */
+  rzx_stream = NULL;
+  if( settings_current.rzx_flush_frames &&
+      !settings_current.competition_mode ) {
+    rzx_stream = fopen( filename, "wb" );
+    if( !rzx_stream ) {
+      ui_error( UI_ERROR_ERROR, "couldn't open '%s': %s", filename,
+		strerror( errno ) );
+      free( rzx_filename );
+      libspectrum_rzx_free( rzx );
+      return 1;
+    }
+  }
+
   libspectrum_rzx_start_input( rzx, tstates );
 
   counter_reset();
   rzx_in_count = 0;
   autosave_frame_count = 0;
+  rzx_stream_frames = 0;
 
   rzx_recording = 1;
 
+  /* Get the header and any embedded snapshot out of the way */
+  if( rzx_stream ) {
+    error = stream_flush( 1 );
+    if( error ) { rzx_stop_recording(); return error; }
+  }
+
   ui_menu_activate( UI_MENU_ITEM_RECORDING, 1 );
 
   if( settings_current.competition_mode ) {
@@ -187,7 +226,8 @@ int rzx_start_recording( const char *filename, int embed_snapshot )
     
   } else {
 
-    ui_menu_activate( UI_MENU_ITEM_RECORDING_ROLLBACK, 1 );
+    /* Anything we could roll back to has already been written out */
+    if( !rzx_stream ) ui_menu_activate( UI_MENU_ITEM_RECORDING_ROLLBACK, 1 );
     rzx_competition_mode = 0;
 
   }
@@ -208,6 +248,23 @@ int rzx_stop_recording( void )
   ui_menu_activate( UI_MENU_ITEM_RECORDING, 0 );
   ui_menu_activate( UI_MENU_ITEM_RECORDING_ROLLBACK, 0 );
 
+  if( rzx_stream ) {
+
+    error = stream_flush( 0 );
+
+    if( fclose( rzx_stream ) && !error ) {
+      ui_error( UI_ERROR_ERROR, "error closing '%s': %s", rzx_filename,
+		strerror( errno ) );
+      error = 1;
+    }
+    rzx_stream = NULL;
+
+    free( rzx_filename );
+    libspectrum_rzx_free( rzx );
+
+    return error;
+  }
+
   libspectrum_creator_set_competition_code(
     fuse_creator, settings_current.competition_code
   );
@@ -312,6 +369,7 @@ start_playback( libspectrum_rzx *rzx )
   tstates = libspectrum_rzx_tstates( rzx );
   rzx_instruction_count = libspectrum_rzx_instructions( rzx );
   rzx_playback = 1;
+  rzx_last_playback_result = RZX_PLAYBACK_FINISHED;
   counter_reset();
 
   ui_menu_activate( UI_MENU_ITEM_RECORDING, 1 );
@@ -442,9 +500,52 @@ autosave_frame( void )
   libspectrum_rzx_add_snap( rzx, snap, 1 );
   libspectrum_rzx_start_input( rzx, tstates );
 
+  /* When streaming, the snapshot goes straight out to the file; it can't
+     be pruned later */
+  if( rzx_stream ) {
+    rzx_stream_frames = 0;
+    if( stream_flush( 1 ) ) rzx_stop_recording();
+    return;
+  }
+
   autosave_prune();
 }
 
+/* Append everything recorded since the last call to the file being
+   streamed to and free it; each call writes complete blocks, so the
+   file is a valid recording of everything up to the last call. Start a
+   new input recording block afterwards if 'restart' is set */
+static int
+stream_flush( int restart )
+{
+  libspectrum_byte *buffer = NULL; size_t length = 0;
+  libspectrum_error libspec_error;
+
+  libspectrum_rzx_stop_input( rzx );
+
+  libspec_error = libspectrum_rzx_flush( &buffer, &length, rzx,
+					 LIBSPECTRUM_ID_UNKNOWN, fuse_creator,
+					 settings_current.rzx_compression );
+  if( libspec_error != LIBSPECTRUM_ERROR_NONE ) {
+    free( buffer );
+    return libspec_error;
+  }
+
+  if( fwrite( buffer, 1, length, rzx_stream ) != length ||
+      fflush( rzx_stream ) ) {
+    ui_error( UI_ERROR_ERROR, "error writing to '%s': %s", rzx_filename,
+	      strerror( errno ) );
+    free( buffer );
+    return 1;
+  }
+
+  free( buffer );
+
+  if( restart ) libspectrum_rzx_start_input( rzx, tstates );
+
+  return 0;
+}
+
 static int recording_frame( void )
 {
   libspectrum_error error;
@@ -459,6 +560,16 @@ static int recording_frame( void )
   /* Reset the instruction counter */
   rzx_in_count = 0; counter_reset();
 
+  if( rzx_stream &&
+      ++rzx_stream_frames >= (size_t)settings_current.rzx_flush_frames ) {
+    rzx_stream_frames = 0;
+    error = stream_flush( 1 );
+    if( error ) {
+      rzx_stop_recording();
+      return error;
+    }
+  }
+
   /* If we're in competition mode, check we're running at close to 100%
      speed */
   if( rzx_competition_mode && 
@@ -485,8 +596,13 @@ static int playback_frame( void )
   int error, finished;
   libspectrum_snap *snap;
 
+  /* The only error here is the wrong number of INs in the frame; too
+     many would have been caught in readport() */
   error = libspectrum_rzx_playback_frame( rzx, &finished, &snap );
-  if( error ) return rzx_stop_playback( 0 );
+  if( error ) {
+    rzx_last_playback_result = RZX_PLAYBACK_UNDERRUN;
+    return rzx_stop_playback( 0 );
+  }
 
   if( finished ) {
     ui_error( UI_ERROR_INFO, "Finished RZX playback" );
@@ -501,7 +617,10 @@ static int playback_frame( void )
 
   if( snap ) {
     error = snapshot_copy_from( snap );
-    if( error ) return rzx_stop_playback( 0 );
+    if( error ) {
+      rzx_last_playback_result = RZX_PLAYBACK_ERROR;
+      return rzx_stop_playback( 0 );
+    }
   }
 
   /* If we've got another frame to do, fetch the new instruction count and
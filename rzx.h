@@ -59,6 +59,16 @@ extern size_t rzx_instruction_count;
 /* The actual RZX data */
 extern libspectrum_rzx *rzx;
 
+/* Why did the last .rzx playback end? */
+typedef enum rzx_playback_result {
+  RZX_PLAYBACK_FINISHED,	/* Ran to the end, or stopped by the user */
+  RZX_PLAYBACK_UNDERRUN,	/* Fewer INs in a frame than were recorded */
+  RZX_PLAYBACK_OVERRUN,		/* More INs in a frame than were recorded */
+  RZX_PLAYBACK_ERROR,		/* Anything else */
+} rzx_playback_result;
+
+extern rzx_playback_result rzx_last_playback_result;
+
 int rzx_init( void );
 
 int rzx_start_recording( const char *filename, int embed_snapshot );
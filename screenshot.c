@@ -68,8 +68,6 @@ static libspectrum_byte
   rgb_data2[ MAX_SIZE * DISPLAY_SCREEN_HEIGHT * 3 * DISPLAY_ASPECT_WIDTH * 4 ],
    png_data[ MAX_SIZE * DISPLAY_SCREEN_HEIGHT * 3 * DISPLAY_ASPECT_WIDTH * 3 ];
 
-scaler_type screenshot_movie_scaler = SCALER_NUM;
-
 static int
 screenshot_write2( const char *filename, scaler_type scaler, int compression )
 {
@@ -176,12 +174,6 @@ screenshot_write( const char *filename, scaler_type scaler )
   return screenshot_write2( filename, scaler, Z_BEST_COMPRESSION );
 }
 
-int
-screenshot_write_fast( const char *filename, scaler_type scaler )
-{
-  return screenshot_write2( filename, scaler, Z_BEST_SPEED );
-}
-
 static int
 get_rgb32_data( libspectrum_byte *rgb32_data, size_t stride,
 		size_t height, size_t width )
@@ -214,6 +206,9 @@ get_rgb32_data( libspectrum_byte *rgb32_data, size_t stride,
 			0.587 * palette[i][1] +
 			0.114 * palette[i][2]   ) + 0.5;
 
+  /* Read what has been drawn only once the drawing is done */
+  display_wait();
+
   for( y = 0; y < height; y++ ) {
     for( x = 0; x < width; x++ ) {
 
@@ -297,11 +292,6 @@ screenshot_available_scalers( scaler_type scaler )
 
 #endif				/* #ifdef USE_LIBPNG */
 
-char screenshot_movie_name[PATH_MAX+1];
-char screenshot_movie_file[SCREENSHOT_MOVIE_FILE_MAX+1];
-long int screenshot_movie_frame = 0;
-int screenshot_movie_record = 0;
-
 int
 screenshot_scr_write( const char *filename )
 {
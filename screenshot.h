@@ -33,7 +33,6 @@
 #ifdef USE_LIBPNG
 
 int screenshot_write( const char *filename, scaler_type scaler );
-int screenshot_write_fast( const char *filename, scaler_type scaler );
 int screenshot_available_scalers( scaler_type scaler );
 
 #endif				/* #ifdef USE_LIBPNG */
@@ -41,12 +40,4 @@ int screenshot_available_scalers( scaler_type scaler );
 int screenshot_scr_write( const char *filename );
 int screenshot_scr_read( const char *filename );
 
-extern char screenshot_movie_name[];
-extern char screenshot_movie_file[];
-extern long int screenshot_movie_frame;
-extern int screenshot_movie_record;
-extern scaler_type screenshot_movie_scaler;
-
-#define SCREENSHOT_MOVIE_FILE_MAX 256
-
 #endif				/* #ifndef FUSE_SCREENSHOT_H */
@@ -81,6 +81,8 @@ settings_info settings_default = {
   /* dck_file */ NULL,
   /* debugger_command */ NULL,
   /* detect_loader */ 1,
+  /* display_batch */ 0,
+  /* display_thread */ 0,
   /* divide_enabled */ 0,
   /* divide_master_file */ NULL,
   /* divide_slave_file */ NULL,
@@ -91,6 +93,8 @@ settings_info settings_default = {
   /* fastload */ 1,
   /* frame_rate */ 1,
   /* full_screen */ 0,
+  /* headless */ 0,
+  /* headless_frames */ 0,
   /* if2_file */ NULL,
   /* interface1 */ 0,
   /* interface2 */ 1,
@@ -149,6 +153,8 @@ settings_info settings_default = {
   /* printer_text_filename */ "printout.txt",
   /* raw_s_net */ 0,
   /* record_file */ NULL,
+  /* rewind_frames */ 5,
+  /* rewind_size */ 0,
   /* rom_128_0 */ "128-0.rom",
   /* rom_128_1 */ "128-1.rom",
   /* rom_16 */ "48.rom",
@@ -197,6 +203,8 @@ settings_info settings_default = {
   /* rs232_tx */ NULL,
   /* rzx_autosaves */ 1,
   /* rzx_compression */ 1,
+  /* rzx_flush_frames */ 0,
+  /* rzx_verify */ NULL,
   /* simpleide_active */ 0,
   /* simpleide_master_file */ NULL,
   /* simpleide_slave_file */ NULL,
@@ -218,6 +226,8 @@ settings_info settings_default = {
   /* svga_mode */ 320,
   /* tape_file */ NULL,
   /* tape_traps */ 1,
+  /* turbo */ 0,
+  /* turbo_frameskip */ 16,
   /* unittests */ 0,
   /* writable_roms */ 0,
   /* zxatasp_active */ 0,
@@ -395,6 +405,16 @@ parse_xml( xmlDocPtr doc, settings_info *settings )
       settings->detect_loader = atoi( (char*)xmlstring );
       xmlFree( xmlstring );
     } else
+    if( !strcmp( (const char*)node->name, "displaybatch" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->display_batch = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
+    if( !strcmp( (const char*)node->name, "displaythread" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->display_thread = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
     if( !strcmp( (const char*)node->name, "divide" ) ) {
       xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
       settings->divide_enabled = atoi( (char*)xmlstring );
@@ -450,6 +470,16 @@ parse_xml( xmlDocPtr doc, settings_info *settings )
       settings->full_screen = atoi( (char*)xmlstring );
       xmlFree( xmlstring );
     } else
+    if( !strcmp( (const char*)node->name, "headless" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->headless = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
+    if( !strcmp( (const char*)node->name, "frames" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->headless_frames = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
     if( !strcmp( (const char*)node->name, "if2cart" ) ) {
       xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
       free( settings->if2_file );
@@ -760,6 +790,16 @@ parse_xml( xmlDocPtr doc, settings_info *settings )
       settings->record_file = strdup( (char*)xmlstring );
       xmlFree( xmlstring );
     } else
+    if( !strcmp( (const char*)node->name, "rewindframes" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->rewind_frames = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
+    if( !strcmp( (const char*)node->name, "rewindsize" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->rewind_size = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
     if( !strcmp( (const char*)node->name, "rom1280" ) ) {
       xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
       free( settings->rom_128_0 );
@@ -1045,6 +1085,17 @@ parse_xml( xmlDocPtr doc, settings_info *settings )
       settings->rzx_compression = atoi( (char*)xmlstring );
       xmlFree( xmlstring );
     } else
+    if( !strcmp( (const char*)node->name, "rzxflush" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->rzx_flush_frames = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
+    if( !strcmp( (const char*)node->name, "rzxverify" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      free( settings->rzx_verify );
+      settings->rzx_verify = strdup( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
     if( !strcmp( (const char*)node->name, "simpleide" ) ) {
       xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
       settings->simpleide_active = atoi( (char*)xmlstring );
@@ -1161,6 +1212,16 @@ parse_xml( xmlDocPtr doc, settings_info *settings )
       settings->tape_traps = atoi( (char*)xmlstring );
       xmlFree( xmlstring );
     } else
+    if( !strcmp( (const char*)node->name, "turbo" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->turbo = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
+    if( !strcmp( (const char*)node->name, "turboframeskip" ) ) {
+      xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
+      settings->turbo_frameskip = atoi( (char*)xmlstring );
+      xmlFree( xmlstring );
+    } else
     if( !strcmp( (const char*)node->name, "unittests" ) ) {
       xmlstring = xmlNodeListGetString( doc, node->xmlChildrenNode, 1 );
       settings->unittests = atoi( (char*)xmlstring );
@@ -1263,6 +1324,8 @@ settings_write_config( settings_info *settings )
   if( settings->debugger_command )
     xmlNewTextChild( root, NULL, (const xmlChar*)"debuggercommand", (const xmlChar*)settings->debugger_command );
   xmlNewTextChild( root, NULL, (const xmlChar*)"detectloader", (const xmlChar*)(settings->detect_loader ? "1" : "0") );
+  xmlNewTextChild( root, NULL, (const xmlChar*)"displaybatch", (const xmlChar*)(settings->display_batch ? "1" : "0") );
+  xmlNewTextChild( root, NULL, (const xmlChar*)"displaythread", (const xmlChar*)(settings->display_thread ? "1" : "0") );
   xmlNewTextChild( root, NULL, (const xmlChar*)"divide", (const xmlChar*)(settings->divide_enabled ? "1" : "0") );
   if( settings->divide_master_file )
     xmlNewTextChild( root, NULL, (const xmlChar*)"dividemasterfile", (const xmlChar*)settings->divide_master_file );
@@ -1284,6 +1347,11 @@ settings_write_config( settings_info *settings )
     xmlNewTextChild( root, NULL, (const xmlChar*)"rate", (const xmlChar*)buffer );
   }
   xmlNewTextChild( root, NULL, (const xmlChar*)"fullscreen", (const xmlChar*)(settings->full_screen ? "1" : "0") );
+  xmlNewTextChild( root, NULL, (const xmlChar*)"headless", (const xmlChar*)(settings->headless ? "1" : "0") );
+  if( settings->headless_frames ) {
+    snprintf( buffer, 80, "%d", settings->headless_frames );
+    xmlNewTextChild( root, NULL, (const xmlChar*)"frames", (const xmlChar*)buffer );
+  }
   if( settings->if2_file )
     xmlNewTextChild( root, NULL, (const xmlChar*)"if2cart", (const xmlChar*)settings->if2_file );
   xmlNewTextChild( root, NULL, (const xmlChar*)"interface1", (const xmlChar*)(settings->interface1 ? "1" : "0") );
@@ -1446,6 +1514,14 @@ settings_write_config( settings_info *settings )
   xmlNewTextChild( root, NULL, (const xmlChar*)"rawsnet", (const xmlChar*)(settings->raw_s_net ? "1" : "0") );
   if( settings->record_file )
     xmlNewTextChild( root, NULL, (const xmlChar*)"recordfile", (const xmlChar*)settings->record_file );
+  if( settings->rewind_frames ) {
+    snprintf( buffer, 80, "%d", settings->rewind_frames );
+    xmlNewTextChild( root, NULL, (const xmlChar*)"rewindframes", (const xmlChar*)buffer );
+  }
+  if( settings->rewind_size ) {
+    snprintf( buffer, 80, "%d", settings->rewind_size );
+    xmlNewTextChild( root, NULL, (const xmlChar*)"rewindsize", (const xmlChar*)buffer );
+  }
   if( settings->rom_128_0 )
     xmlNewTextChild( root, NULL, (const xmlChar*)"rom1280", (const xmlChar*)settings->rom_128_0 );
   if( settings->rom_128_1 )
@@ -1539,6 +1615,12 @@ settings_write_config( settings_info *settings )
     xmlNewTextChild( root, NULL, (const xmlChar*)"rs232tx", (const xmlChar*)settings->rs232_tx );
   xmlNewTextChild( root, NULL, (const xmlChar*)"rzxautosaves", (const xmlChar*)(settings->rzx_autosaves ? "1" : "0") );
   xmlNewTextChild( root, NULL, (const xmlChar*)"compressrzx", (const xmlChar*)(settings->rzx_compression ? "1" : "0") );
+  if( settings->rzx_flush_frames ) {
+    snprintf( buffer, 80, "%d", settings->rzx_flush_frames );
+    xmlNewTextChild( root, NULL, (const xmlChar*)"rzxflush", (const xmlChar*)buffer );
+  }
+  if( settings->rzx_verify )
+    xmlNewTextChild( root, NULL, (const xmlChar*)"rzxverify", (const xmlChar*)settings->rzx_verify );
   xmlNewTextChild( root, NULL, (const xmlChar*)"simpleide", (const xmlChar*)(settings->simpleide_active ? "1" : "0") );
   if( settings->simpleide_master_file )
     xmlNewTextChild( root, NULL, (const xmlChar*)"simpleidemasterfile", (const xmlChar*)settings->simpleide_master_file );
@@ -1574,6 +1656,11 @@ settings_write_config( settings_info *settings )
   if( settings->tape_file )
     xmlNewTextChild( root, NULL, (const xmlChar*)"tapefile", (const xmlChar*)settings->tape_file );
   xmlNewTextChild( root, NULL, (const xmlChar*)"tapetraps", (const xmlChar*)(settings->tape_traps ? "1" : "0") );
+  xmlNewTextChild( root, NULL, (const xmlChar*)"turbo", (const xmlChar*)(settings->turbo ? "1" : "0") );
+  if( settings->turbo_frameskip ) {
+    snprintf( buffer, 80, "%d", settings->turbo_frameskip );
+    xmlNewTextChild( root, NULL, (const xmlChar*)"turboframeskip", (const xmlChar*)buffer );
+  }
   xmlNewTextChild( root, NULL, (const xmlChar*)"unittests", (const xmlChar*)(settings->unittests ? "1" : "0") );
   xmlNewTextChild( root, NULL, (const xmlChar*)"writableroms", (const xmlChar*)(settings->writable_roms ? "1" : "0") );
   xmlNewTextChild( root, NULL, (const xmlChar*)"zxatasp", (const xmlChar*)(settings->zxatasp_active ? "1" : "0") );
@@ -1628,6 +1715,10 @@ settings_command_line( settings_info *settings, int *first_arg,
     { "debugger-command", 1, NULL, 259 },
     {    "detect-loader", 0, &(settings->detect_loader), 1 },
     { "no-detect-loader", 0, &(settings->detect_loader), 0 },
+    {    "display-batch", 0, &(settings->display_batch), 1 },
+    { "no-display-batch", 0, &(settings->display_batch), 0 },
+    {    "display-thread", 0, &(settings->display_thread), 1 },
+    { "no-display-thread", 0, &(settings->display_thread), 0 },
     {    "divide", 0, &(settings->divide_enabled), 1 },
     { "no-divide", 0, &(settings->divide_enabled), 0 },
     { "divide-masterfile", 1, NULL, 260 },
@@ -1643,6 +1734,9 @@ settings_command_line( settings_info *settings, int *first_arg,
     { "rate", 1, NULL, 264 },
     {    "full-screen", 0, &(settings->full_screen), 1 },
     { "no-full-screen", 0, &(settings->full_screen), 0 },
+    {    "headless", 0, &(settings->headless), 1 },
+    { "no-headless", 0, &(settings->headless), 0 },
+    { "frames", 1, NULL, 361 },
     { "if2cart", 1, NULL, 265 },
     {    "interface1", 0, &(settings->interface1), 1 },
     { "no-interface1", 0, &(settings->interface1), 0 },
@@ -1713,6 +1807,8 @@ settings_command_line( settings_info *settings, int *first_arg,
     {    "raw-s-net", 0, &(settings->raw_s_net), 1 },
     { "no-raw-s-net", 0, &(settings->raw_s_net), 0 },
     { "record", 1, NULL, 'r' },
+    { "rewind-frames", 1, NULL, 364 },
+    { "rewind-size", 1, NULL, 365 },
     { "rom-128-0", 1, NULL, 309 },
     { "rom-128-1", 1, NULL, 310 },
     { "rom-16", 1, NULL, 311 },
@@ -1764,6 +1860,8 @@ settings_command_line( settings_info *settings, int *first_arg,
     { "no-rzx-autosaves", 0, &(settings->rzx_autosaves), 0 },
     {    "compress-rzx", 0, &(settings->rzx_compression), 1 },
     { "no-compress-rzx", 0, &(settings->rzx_compression), 0 },
+    { "rzx-flush", 1, NULL, 366 },
+    { "rzx-verify", 1, NULL, 362 },
     {    "simpleide", 0, &(settings->simpleide_active), 1 },
     { "no-simpleide", 0, &(settings->simpleide_active), 0 },
     { "simpleide-masterfile", 1, NULL, 354 },
@@ -1796,6 +1894,9 @@ settings_command_line( settings_info *settings, int *first_arg,
     { "tape", 1, NULL, 't' },
     {    "traps", 0, &(settings->tape_traps), 1 },
     { "no-traps", 0, &(settings->tape_traps), 0 },
+    {    "turbo", 0, &(settings->turbo), 1 },
+    { "no-turbo", 0, &(settings->turbo), 0 },
+    { "turbo-frameskip", 1, NULL, 363 },
     {    "unittests", 0, &(settings->unittests), 1 },
     { "no-unittests", 0, &(settings->unittests), 0 },
     {    "writable-roms", 0, &(settings->writable_roms), 1 },
@@ -1848,6 +1949,7 @@ settings_command_line( settings_info *settings, int *first_arg,
     case 'D': settings->doublescan_mode = atoi( optarg ); break;
     case 263: settings->emulation_speed = atoi( optarg ); break;
     case 264: settings->frame_rate = atoi( optarg ); break;
+    case 361: settings->headless_frames = atoi( optarg ); break;
     case 265: settings_set_string( &settings->if2_file, optarg ); break;
     case 'j': settings_set_string( &settings->joystick_1, optarg ); break;
     case 266: settings->joystick_1_fire_1 = atoi( optarg ); break;
@@ -1894,6 +1996,8 @@ settings_command_line( settings_info *settings, int *first_arg,
     case 306: settings_set_string( &settings->printer_graphics_filename, optarg ); break;
     case 307: settings_set_string( &settings->printer_text_filename, optarg ); break;
     case 'r': settings_set_string( &settings->record_file, optarg ); break;
+    case 364: settings->rewind_frames = atoi( optarg ); break;
+    case 365: settings->rewind_size = atoi( optarg ); break;
     case 309: settings_set_string( &settings->rom_128_0, optarg ); break;
     case 310: settings_set_string( &settings->rom_128_1, optarg ); break;
     case 311: settings_set_string( &settings->rom_16, optarg ); break;
@@ -1939,6 +2043,8 @@ settings_command_line( settings_info *settings, int *first_arg,
     case 351: settings_set_string( &settings->rom_ts2068_1, optarg ); break;
     case 352: settings_set_string( &settings->rs232_rx, optarg ); break;
     case 353: settings_set_string( &settings->rs232_tx, optarg ); break;
+    case 366: settings->rzx_flush_frames = atoi( optarg ); break;
+    case 362: settings_set_string( &settings->rzx_verify, optarg ); break;
     case 354: settings_set_string( &settings->simpleide_master_file, optarg ); break;
     case 355: settings_set_string( &settings->simpleide_slave_file, optarg ); break;
     case 's': settings_set_string( &settings->snapshot, optarg ); break;
@@ -1949,6 +2055,7 @@ settings_command_line( settings_info *settings, int *first_arg,
     case 'g': settings_set_string( &settings->start_scaler_mode, optarg ); break;
     case 'v': settings->svga_mode = atoi( optarg ); break;
     case 't': settings_set_string( &settings->tape_file, optarg ); break;
+    case 363: settings->turbo_frameskip = atoi( optarg ); break;
     case 358: settings_set_string( &settings->zxatasp_master_file, optarg ); break;
     case 359: settings_set_string( &settings->zxatasp_slave_file, optarg ); break;
     case 360: settings_set_string( &settings->zxcf_pri_file, optarg ); break;
@@ -2013,6 +2120,8 @@ settings_copy_internal( settings_info *dest, settings_info *src )
     if( !dest->debugger_command ) { settings_free( dest ); return 1; }
   }
   dest->detect_loader = src->detect_loader;
+  dest->display_batch = src->display_batch;
+  dest->display_thread = src->display_thread;
   dest->divide_enabled = src->divide_enabled;
   dest->divide_master_file = NULL;
   if( src->divide_master_file ) {
@@ -2031,6 +2140,8 @@ settings_copy_internal( settings_info *dest, settings_info *src )
   dest->fastload = src->fastload;
   dest->frame_rate = src->frame_rate;
   dest->full_screen = src->full_screen;
+  dest->headless = src->headless;
+  dest->headless_frames = src->headless_frames;
   dest->if2_file = NULL;
   if( src->if2_file ) {
     dest->if2_file = strdup( src->if2_file );
@@ -2157,6 +2268,8 @@ settings_copy_internal( settings_info *dest, settings_info *src )
     dest->record_file = strdup( src->record_file );
     if( !dest->record_file ) { settings_free( dest ); return 1; }
   }
+  dest->rewind_frames = src->rewind_frames;
+  dest->rewind_size = src->rewind_size;
   dest->rom_128_0 = NULL;
   if( src->rom_128_0 ) {
     dest->rom_128_0 = strdup( src->rom_128_0 );
@@ -2385,6 +2498,12 @@ settings_copy_internal( settings_info *dest, settings_info *src )
   }
   dest->rzx_autosaves = src->rzx_autosaves;
   dest->rzx_compression = src->rzx_compression;
+  dest->rzx_flush_frames = src->rzx_flush_frames;
+  dest->rzx_verify = NULL;
+  if( src->rzx_verify ) {
+    dest->rzx_verify = strdup( src->rzx_verify );
+    if( !dest->rzx_verify ) { settings_free( dest ); return 1; }
+  }
   dest->simpleide_active = src->simpleide_active;
   dest->simpleide_master_file = NULL;
   if( src->simpleide_master_file ) {
@@ -2438,6 +2557,8 @@ settings_copy_internal( settings_info *dest, settings_info *src )
     if( !dest->tape_file ) { settings_free( dest ); return 1; }
   }
   dest->tape_traps = src->tape_traps;
+  dest->turbo = src->turbo;
+  dest->turbo_frameskip = src->turbo_frameskip;
   dest->unittests = src->unittests;
   dest->writable_roms = src->writable_roms;
   dest->zxatasp_active = src->zxatasp_active;
@@ -2610,6 +2731,7 @@ settings_free( settings_info *settings )
   if( settings->rom_ts2068_1 ) free( settings->rom_ts2068_1 );
   if( settings->rs232_rx ) free( settings->rs232_rx );
   if( settings->rs232_tx ) free( settings->rs232_tx );
+  if( settings->rzx_verify ) free( settings->rzx_verify );
   if( settings->simpleide_master_file ) free( settings->simpleide_master_file );
   if( settings->simpleide_slave_file ) free( settings->simpleide_slave_file );
   if( settings->snapshot ) free( settings->snapshot );
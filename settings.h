@@ -46,6 +46,8 @@ typedef struct settings_info {
   char *dck_file;
   char *debugger_command;
    int detect_loader;
+   int display_batch;
+   int display_thread;
    int divide_enabled;
   char *divide_master_file;
   char *divide_slave_file;
@@ -56,6 +58,8 @@ typedef struct settings_info {
    int fastload;
    int frame_rate;
    int full_screen;
+   int headless;
+   int headless_frames;
   char *if2_file;
    int interface1;
    int interface2;
@@ -114,6 +118,8 @@ typedef struct settings_info {
   char *printer_text_filename;
    int raw_s_net;
   char *record_file;
+   int rewind_frames;
+   int rewind_size;
   char *rom_128_0;
   char *rom_128_1;
   char *rom_16;
@@ -162,6 +168,8 @@ typedef struct settings_info {
   char *rs232_tx;
    int rzx_autosaves;
    int rzx_compression;
+   int rzx_flush_frames;
+  char *rzx_verify;
    int simpleide_active;
   char *simpleide_master_file;
   char *simpleide_slave_file;
@@ -183,6 +191,8 @@ typedef struct settings_info {
    int svga_mode;
   char *tape_file;
    int tape_traps;
+   int turbo;
+   int turbo_frameskip;
    int unittests;
    int writable_roms;
    int zxatasp_active;
@@ -25,11 +25,20 @@
 
 #include <config.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif				/* #ifdef HAVE_ZLIB_H */
+
 #include <libspectrum.h>
 
 #include "ay.h"
 #include "disk/beta.h"
 #include "disk/plusd.h"
+#include "display.h"
 #include "fuse.h"
 #include "if2.h"
 #include "joystick.h"
@@ -46,6 +55,231 @@
 #include "zxatasp.h"
 #include "zxcf.h"
 
+#ifdef HAVE_ZLIB_H
+
+/* .szx files can be loaded without reading the whole file into memory
+   and without libspectrum allocating and filling a copy of every RAM
+   page: libspectrum is given everything except the RAMP chunks, and
+   once the machine has been set up those are decompressed straight
+   into the RAM pages */
+
+/* Somewhere to read a snapshot from; either a file or a buffer */
+typedef struct snapshot_source {
+  FILE *file;
+  long file_start;
+  const libspectrum_byte *buffer;
+  size_t length, position;
+} snapshot_source;
+
+#define SZX_HEADER_LENGTH 8
+#define SZX_CHUNK_HEADER_LENGTH 8
+#define SZX_RAMP_HEADER_LENGTH 3
+#define SZX_RAMP_COMPRESSED 0x01
+#define SZX_MAX_RAMP_CHUNKS 64
+
+/* Where a RAMP chunk's data is, and which page it's for */
+typedef struct szx_ramp {
+  size_t offset, length;
+  int page, compressed;
+} szx_ramp;
+
+static int
+source_read( snapshot_source *source, void *dest, size_t length )
+{
+  if( length > source->length - source->position ) return 1;
+
+  if( source->file ) {
+    if( length && fread( dest, length, 1, source->file ) != 1 ) return 1;
+  } else {
+    memcpy( dest, source->buffer + source->position, length );
+  }
+
+  source->position += length;
+
+  return 0;
+}
+
+static int
+source_seek( snapshot_source *source, size_t position )
+{
+  if( position > source->length ) return 1;
+
+  if( source->file &&
+      fseek( source->file, source->file_start + position, SEEK_SET ) )
+    return 1;
+
+  source->position = position;
+
+  return 0;
+}
+
+/* Decompress 'length' bytes from 'source' into a 16K RAM page */
+static int
+szx_inflate_page( snapshot_source *source, size_t length,
+		  libspectrum_byte *page )
+{
+  static libspectrum_byte block[ 0x1000 ];
+  z_stream stream;
+  size_t chunk;
+  int error;
+
+  memset( &stream, 0, sizeof( stream ) );
+  if( inflateInit( &stream ) != Z_OK ) return 1;
+
+  stream.next_out = page;
+  stream.avail_out = 0x4000;
+
+  do {
+
+    if( source->file ) {
+      chunk = length < sizeof( block ) ? length : sizeof( block );
+      if( source_read( source, block, chunk ) ) {
+	inflateEnd( &stream );
+	return 1;
+      }
+      stream.next_in = block;
+    } else {
+      chunk = length;
+      stream.next_in = (Bytef*)( source->buffer + source->position );
+      source->position += chunk;
+    }
+
+    stream.avail_in = chunk;
+    length -= chunk;
+
+    error = inflate( &stream, Z_NO_FLUSH );
+
+  } while( error == Z_OK && length && stream.avail_out );
+
+  inflateEnd( &stream );
+
+  return stream.avail_out ||
+         ( error != Z_OK && error != Z_STREAM_END && error != Z_BUF_ERROR );
+}
+
+/* Returns -1 if 'source' isn't an .szx file, with the source back at its
+   start */
+static int
+snapshot_read_szx( snapshot_source *source, const char *filename )
+{
+  libspectrum_byte header[ SZX_CHUNK_HEADER_LENGTH ], *stripped, *ptr;
+  size_t stripped_length, chunk_length;
+  szx_ramp ramp[ SZX_MAX_RAMP_CHUNKS ];
+  size_t i, ramp_count = 0;
+  libspectrum_snap *snap;
+  int error;
+
+  if( source_read( source, header, SZX_HEADER_LENGTH ) ||
+      memcmp( header, "ZXST", 4 ) ) {
+    source_seek( source, 0 );
+    return -1;
+  }
+
+  stripped = malloc( SZX_HEADER_LENGTH );
+  if( !stripped ) {
+    ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__, __LINE__ );
+    return 1;
+  }
+  memcpy( stripped, header, SZX_HEADER_LENGTH );
+  stripped_length = SZX_HEADER_LENGTH;
+
+  while( source->position < source->length ) {
+
+    if( source_read( source, header, SZX_CHUNK_HEADER_LENGTH ) ) break;
+
+    chunk_length = header[4] | header[5] << 8 | header[6] << 16 |
+                   (size_t)header[7] << 24;
+    if( chunk_length > source->length - source->position ) break;
+
+    /* Check everything about a RAMP chunk except its compressed data
+       now, while the machine is still untouched */
+    if( !memcmp( header, "RAMP", 4 ) && ramp_count < SZX_MAX_RAMP_CHUNKS ) {
+
+      if( chunk_length < SZX_RAMP_HEADER_LENGTH ||
+	  source_read( source, header, SZX_RAMP_HEADER_LENGTH ) )
+	break;
+
+      ramp[ ramp_count ].offset = source->position;
+      ramp[ ramp_count ].length = chunk_length - SZX_RAMP_HEADER_LENGTH;
+      ramp[ ramp_count ].page = header[2];
+      ramp[ ramp_count ].compressed =
+	( header[0] | header[1] << 8 ) & SZX_RAMP_COMPRESSED;
+
+      if( ramp[ ramp_count ].compressed ? !ramp[ ramp_count ].length :
+	  ramp[ ramp_count ].length != 0x4000 )
+	break;
+
+      if( ramp[ ramp_count ].page < SPECTRUM_RAM_PAGES ) ramp_count++;
+
+      if( source_seek( source, source->position + chunk_length -
+		       SZX_RAMP_HEADER_LENGTH ) )
+	break;
+      continue;
+    }
+
+    ptr = realloc( stripped,
+		   stripped_length + SZX_CHUNK_HEADER_LENGTH + chunk_length );
+    if( !ptr ) {
+      free( stripped );
+      ui_error( UI_ERROR_ERROR, "Out of memory at %s:%d", __FILE__,
+		__LINE__ );
+      return 1;
+    }
+    stripped = ptr;
+
+    memcpy( stripped + stripped_length, header, SZX_CHUNK_HEADER_LENGTH );
+    if( source_read( source,
+		     stripped + stripped_length + SZX_CHUNK_HEADER_LENGTH,
+		     chunk_length ) )
+      break;
+    stripped_length += SZX_CHUNK_HEADER_LENGTH + chunk_length;
+  }
+
+  if( source->position < source->length ) {
+    free( stripped );
+    ui_error( UI_ERROR_ERROR, "snapshot_read_szx: snapshot is corrupt" );
+    return 1;
+  }
+
+  snap = libspectrum_snap_alloc();
+
+  error = libspectrum_snap_read( snap, stripped, stripped_length,
+				 LIBSPECTRUM_ID_SNAPSHOT_SZX, filename );
+  free( stripped );
+  if( error ) { libspectrum_snap_free( snap ); return error; }
+
+  error = snapshot_copy_from( snap );
+  libspectrum_snap_free( snap );
+  if( error ) return error;
+
+  for( i = 0; i < ramp_count; i++ ) {
+
+    if( source_seek( source, ramp[i].offset ) ) {
+      error = 1;
+    } else if( ramp[i].compressed ) {
+      error = szx_inflate_page( source, ramp[i].length,
+				RAM[ ramp[i].page ] );
+    } else {
+      error = source_read( source, RAM[ ramp[i].page ], 0x4000 );
+    }
+
+    /* Don't leave a machine running with only some of its RAM loaded */
+    if( error ) {
+      ui_error( UI_ERROR_ERROR, "snapshot_read_szx: corrupt RAM page %d",
+		ramp[i].page );
+      machine_reset( 1 );
+      return 1;
+    }
+  }
+
+  /* RAM has changed since the machine was reset */
+  display_refresh_all();
+
+  return 0;
+}
+
+#endif				/* #ifdef HAVE_ZLIB_H */
+
 #ifdef PSP
 /* 'filename' is used to pacify the file format determining routine */
 int snapshot_read_file(const char *filename, FILE *fptr)
@@ -54,9 +288,38 @@ int snapshot_read( const char *filename )
 #endif
 {
   utils_file file;
-  libspectrum_snap *snap = libspectrum_snap_alloc();
+  libspectrum_snap *snap;
   int error;
 
+#ifdef HAVE_ZLIB_H
+  {
+    snapshot_source source;
+#ifndef PSP
+    FILE *fptr = fopen( filename, "rb" );
+    if( !fptr ) {
+      ui_error( UI_ERROR_ERROR, "couldn't open '%s'", filename );
+      return 1;
+    }
+#endif
+
+    source.file = fptr;
+    source.file_start = ftell( fptr );
+    fseek( fptr, 0, SEEK_END );
+    source.length = ftell( fptr ) - source.file_start;
+    fseek( fptr, source.file_start, SEEK_SET );
+    source.buffer = NULL;
+    source.position = 0;
+
+    error = snapshot_read_szx( &source, filename );
+#ifndef PSP
+    fclose( fptr );
+#endif
+    if( error != -1 ) return error;
+  }
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+  snap = libspectrum_snap_alloc();
+
 #ifdef PSP
   {
     /* PSP version reads from an open and positioned file stream */
@@ -99,9 +362,25 @@ int
 snapshot_read_buffer( const unsigned char *buffer, size_t length,
 		      libspectrum_id_t type )
 {
-  libspectrum_snap *snap = libspectrum_snap_alloc();
+  libspectrum_snap *snap;
   int error;
 
+#ifdef HAVE_ZLIB_H
+  if( type == LIBSPECTRUM_ID_SNAPSHOT_SZX || type == LIBSPECTRUM_ID_UNKNOWN ) {
+    snapshot_source source;
+
+    source.file = NULL;
+    source.buffer = buffer;
+    source.length = length;
+    source.position = 0;
+
+    error = snapshot_read_szx( &source, NULL );
+    if( error != -1 ) return error;
+  }
+#endif				/* #ifdef HAVE_ZLIB_H */
+
+  snap = libspectrum_snap_alloc();
+
   error = libspectrum_snap_read( snap, buffer, length, type, NULL );
   if( error ) { libspectrum_snap_free( snap ); return error; }
     
@@ -42,10 +42,13 @@
 #include <samplerate.h>
 #endif /* #ifdef HAVE_SAMPLERATE */
 
+#include "blep.h"
 #include "fuse.h"
 #include "machine.h"
+#include "movie.h"
 #include "settings.h"
 #include "sound.h"
+#include "sound/dsp.h"
 #include "tape.h"
 #include "ui/ui.h"
 
@@ -93,23 +96,45 @@ static int sound_channels;
 
 static unsigned int ay_tone_levels[16];
 
-static libspectrum_signed_word *sound_buf, *tape_buf;
+static libspectrum_signed_word *sound_buf;
 static float *convert_input_buffer, *convert_output_buffer;
 
+/* The beeper, tape and AY are all output as band-limited steps into
+ * these, which are turned into samples once a frame: one for each side
+ * of the output, or just one if both sides would be the same.
+ */
+static blep_buffer *sound_blep[2];
+
 /* beeper stuff */
-static int sound_oldpos[2], sound_fillpos[2];
-static int sound_oldval[2], sound_oldval_orig[2];
+static int sound_oldval[2];
+static libspectrum_qword sound_beeper_scale;	/* tstates to positions */
 
-/* foo_subcycles are fixed-point with low 16 bits as fractional part.
- * The other bits count as the chip does.
+/* The AY's counters are kept as the time of their next step, measured
+ * from the start of the current frame in ticks of the tone counters
+ * (eight AY cycles) with AY_TICK_BITS fractional bits. Output is only
+ * generated when something changes.
  */
-static unsigned int ay_tone_tick[3], ay_tone_high[3], ay_noise_tick;
-static unsigned int ay_tone_subcycles, ay_env_subcycles;
-static unsigned int ay_env_internal_tick, ay_env_tick;
-static unsigned int ay_tick_incr;
+#define AY_TICK_BITS 8
+
+static libspectrum_dword ay_tone_next[3], ay_noise_next, ay_env_next;
+static int ay_tone_high[3];
 static unsigned int ay_tone_period[3], ay_noise_period, ay_env_period;
+static int ay_rng = 1, ay_noise_toggle = 0;
+static int ay_env_first = 1, ay_env_rev = 0, ay_env_counter = 15;
+static unsigned int ay_env_internal_tick;
 
-static int beeper_last_subpos[2] = { 0, 0 };
+/* How many ticks in a frame and in an output sample, and the scales
+ * from tstates to ticks and from ticks to sample positions; all 32-bit
+ * fixed point.
+ */
+static libspectrum_dword ay_frame_ticks, ay_sample_ticks;
+static libspectrum_qword ay_tstate_scale, ay_position_scale;
+
+/* The level last output on each channel; with AY stereo, each channel
+ * is delayed on the left (0) or right (1) to position it.
+ */
+static int ay_output[3];
+static libspectrum_dword ay_delay[2][3];
 
 /* Local copy of the AY registers */
 static libspectrum_byte sound_ay_registers[16];
@@ -117,7 +142,6 @@ static libspectrum_byte sound_ay_registers[16];
 struct ay_change_tag
 {
   libspectrum_dword tstates;
-  unsigned short ofs;
   unsigned char reg, val;
 };
 
@@ -125,14 +149,18 @@ static struct ay_change_tag ay_change[ AY_CHANGE_MAX ];
 static int ay_change_count;
 
 
-#define STEREO_BUF_SIZE 4096
-
-static int pstereobuf[ STEREO_BUF_SIZE ];
-static int pstereobufsiz, pstereopos;
+/* beeper pseudo-stereo delay */
+static libspectrum_dword sound_pstereo_delay;
 static int psgap = 250;
-static int rstereobuf_l[ STEREO_BUF_SIZE ], rstereobuf_r[ STEREO_BUF_SIZE ];
-static int rstereopos, rchan1pos, rchan2pos, rchan3pos;
 
+/* Set while turbo mode is throwing the sound away */
+static int sound_skipping;
+
+static void sound_timings( void );
+static void sound_beeper_delta( int is_tape, libspectrum_dword position,
+				int delta );
+static void sound_rebase( void );
+static int sound_turbo_skip( void );
 
 static void
 sound_ay_init( void )
@@ -154,21 +182,53 @@ sound_ay_init( void )
   for( f = 0; f < 16; f++ )
     ay_tone_levels[f] = ( levels[f] * AMPL_AY_TONE + 0x8000 ) / 0xffff;
 
-  ay_noise_tick = ay_noise_period = 0;
-  ay_env_internal_tick = ay_env_tick = ay_env_period = 0;
-  ay_tone_subcycles = ay_env_subcycles = 0;
-  for( f = 0; f < 3; f++ )
-    ay_tone_tick[f] = ay_tone_high[f] = 0, ay_tone_period[f] = 1;
+  ay_noise_period = ay_env_period = 0;
+  ay_env_internal_tick = 0;
+  for( f = 0; f < 3; f++ ) {
+    ay_tone_high[f] = 0, ay_tone_period[f] = 1;
+    ay_tone_next[f] = 1 << AY_TICK_BITS;
+  }
+  ay_noise_next = ay_env_next = 2 << AY_TICK_BITS;
+
+  if( sound_enabled ) sound_timings();
 
   ay_change_count = 0;
 }
 
+static void
+sound_timings( void )
+{
+  libspectrum_qword ay_speed =
+    libspectrum_timings_ay_speed( machine_current->machine );
+
+  sound_beeper_scale =
+    ( (libspectrum_qword)sound_generator_framesiz <<
+      ( 32 + BLEP_POSITION_BITS ) ) /
+    machine_current->timings.tstates_per_frame;
+
+  ay_tstate_scale = ( ay_speed << ( 32 + AY_TICK_BITS ) ) /
+    ( 8 * (libspectrum_qword)machine_current->timings.processor_speed );
+  ay_frame_ticks =
+    ( machine_current->timings.tstates_per_frame * ay_tstate_scale ) >> 32;
+
+  /* No AY, so nothing to do */
+  if( !ay_frame_ticks ) {
+    ay_position_scale = 0;
+    return;
+  }
+
+  ay_position_scale =
+    ( (libspectrum_qword)sound_generator_framesiz <<
+      ( 32 + BLEP_POSITION_BITS ) ) / ay_frame_ticks;
+  ay_sample_ticks = ay_frame_ticks / sound_generator_framesiz;
+}
+
 
 void
 sound_init( const char *device )
 {
   static int first_init = 1;
-  int f, ret;
+  int f, ret, delay;
   float hz;
 #ifdef HAVE_SAMPLERATE
   int error;
@@ -219,14 +279,7 @@ sound_init( const char *device )
 
   if( ( sound_buf = malloc( sizeof( libspectrum_signed_word ) *
 			    sound_generator_framesiz * sound_channels ) ) ==
-      NULL
-      || ( tape_buf =
-	   malloc( sizeof( libspectrum_signed_word ) *
-		   sound_generator_framesiz ) ) == NULL ) {
-    if( sound_buf ) {
-      free( sound_buf );
-      sound_buf = NULL;
-    }
+      NULL ) {
     sound_end();
     return;
   }
@@ -260,13 +313,6 @@ sound_init( const char *device )
   }
 #endif /* #ifdef HAVE_SAMPLERATE */
 
-/* if we're resuming, we need to be careful about what
- * gets reset. The minimum we can do is the beeper
- * buffer positions, so that's here.
- */
-  sound_oldpos[0] = sound_oldpos[1] = -1;
-  sound_fillpos[0] = sound_fillpos[1] = 0;
-
 /* this stuff should only happen on the initial call.
  * (We currently assume the new sample rate will be the
  * same as the previous one, hence no need to recalculate
@@ -275,37 +321,47 @@ sound_init( const char *device )
   if( first_init ) {
     first_init = 0;
 
+    sound_dsp_init();
+
     for( f = 0; f < 2; f++ )
-      sound_oldval[f] = sound_oldval_orig[f] = 0;
+      sound_oldval[f] = 0;
   }
 
-  if( sound_stereo_beeper ) {
-    for( f = 0; f < STEREO_BUF_SIZE; f++ )
-      pstereobuf[f] = 0;
-    pstereopos = 0;
-    pstereobufsiz = ( sound_generator_freq * psgap ) / 22000;
-  }
+  delay = 0;
+  for( f = 0; f < 3; f++ ) ay_delay[0][f] = ay_delay[1][f] = 0;
 
   if( sound_stereo_ay ) {
-    int pos =
-      ( sound_stereo_ay_narrow ? 3 : 6 ) * sound_generator_freq / 8000;
+    delay = ( sound_stereo_ay_narrow ? 3 : 6 ) * sound_generator_freq / 8000;
 
-    for( f = 0; f < STEREO_BUF_SIZE; f++ )
-      rstereobuf_l[f] = rstereobuf_r[f] = 0;
-    rstereopos = 0;
+    /* the actual ACB/ABC bit :-)
+     * This works by delaying sounds on the left or right channels to
+     * model the delay you get in the real world when sounds originate
+     * at different places.
+     */
+    ay_delay[1][0] = delay << BLEP_POSITION_BITS;
+    ay_delay[0][ sound_stereo_ay_abc ? 2 : 1 ] = delay << BLEP_POSITION_BITS;
+  }
 
-    /* the actual ACB/ABC bit :-) */
-    rchan1pos = -pos;
-    if( sound_stereo_ay_abc )
-      rchan2pos = 0, rchan3pos = pos;
-    else
-      rchan2pos = pos, rchan3pos = 0;
+  if( sound_stereo_beeper ) {
+    sound_pstereo_delay = ( sound_generator_freq * psgap ) / 22000;
+    if( sound_pstereo_delay > delay ) delay = sound_pstereo_delay;
+    sound_pstereo_delay <<= BLEP_POSITION_BITS;
+  }
+
+  /* Leave room for steps a little after the end of the frame as well as
+     for the stereo delays */
+  for( f = 0; f < ( sound_stereo_ay || sound_stereo_beeper ? 2 : 1 ); f++ ) {
+    sound_blep[f] = blep_alloc( 2 * sound_generator_framesiz + delay + 1 );
+    if( !sound_blep[f] ) {
+      sound_end();
+      return;
+    }
   }
 
-  ay_tick_incr = ( int ) ( 65536. *
-			   libspectrum_timings_ay_speed( machine_current->
-							 machine ) /
-			   sound_generator_freq );
+  sound_skipping = 0;
+  sound_rebase();
+
+  sound_timings();
 }
 
 void
@@ -334,8 +390,6 @@ sound_end( void )
     if( sound_buf ) {
       free( sound_buf );
       sound_buf = NULL;
-      free( tape_buf );
-      tape_buf = NULL;
     }
     if( convert_input_buffer ) {
       free( convert_input_buffer );
@@ -349,94 +403,74 @@ sound_end( void )
     if( src_state )
       src_state = src_delete( src_state );
 #endif /* #ifdef HAVE_SAMPLERATE */
+    blep_free( sound_blep[0] ); sound_blep[0] = NULL;
+    blep_free( sound_blep[1] ); sound_blep[1] = NULL;
     sound_lowlevel_end();
     sound_enabled = 0;
   }
 }
 
 
-/* write sample to buffer as pseudo-stereo */
+/* Add a step to both sides of the output */
 static void
-sound_write_buf_pstereo( libspectrum_signed_word * out, int c )
+sound_add_delta( libspectrum_dword position, int delta )
 {
-  int bl = ( c - pstereobuf[ pstereopos ] ) / 2;
-  int br = ( c + pstereobuf[ pstereopos ] ) / 2;
-
-  if( bl < -AMPL_BEEPER )
-    bl = -AMPL_BEEPER;
-  if( br < -AMPL_BEEPER )
-    br = -AMPL_BEEPER;
-  if( bl > AMPL_BEEPER )
-    bl = AMPL_BEEPER;
-  if( br > AMPL_BEEPER )
-    br = AMPL_BEEPER;
-
-  *out = bl;
-  out[1] = br;
-
-  pstereobuf[ pstereopos ] = c;
-  pstereopos++;
-  if( pstereopos >= pstereobufsiz )
-    pstereopos = 0;
+  blep_add_delta( sound_blep[0], position, delta );
+  if( sound_blep[1] ) blep_add_delta( sound_blep[1], position, delta );
 }
 
+/* Add a step to the beeper or tape output. With beeper pseudo-stereo,
+ * the left side is half the difference between the beeper now and a
+ * little while ago, and the right side half their sum.
+ */
+static void
+sound_beeper_delta( int is_tape, libspectrum_dword position, int delta )
+{
+  if( sound_stereo_beeper && !is_tape ) {
+    blep_add_delta( sound_blep[0], position, delta / 2 );
+    blep_add_delta( sound_blep[1], position, delta / 2 );
+    blep_add_delta( sound_blep[0], position + sound_pstereo_delay,
+		    -delta / 2 );
+    blep_add_delta( sound_blep[1], position + sound_pstereo_delay,
+		    delta / 2 );
+  } else
+    sound_add_delta( position, delta );
+}
 
+/* Start the output from silence and bring it up to the current beeper
+   and tape levels; the AY catches up at its next output */
+static void
+sound_rebase( void )
+{
+  int f;
 
-/* not great having this as a macro to inline it, but it's only
- * a fairly short routine, and it saves messing about.
- * (XXX ummm, possibly not so true any more :-))
- */
-#define AY_GET_SUBVAL( chan ) \
-  ( level * 2 * ay_tone_tick[ chan ] / tone_count )
-
-#define AY_DO_TONE( var, chan ) \
-  ( var ) = 0;								\
-  is_low = 0;								\
-  if( level ) {								\
-    if( ay_tone_high[ chan ] )						\
-      ( var ) = ( level );						\
-    else {								\
-      ( var ) = -( level );						\
-      is_low = 1;							\
-    }									\
-  }									\
-  									\
-  ay_tone_tick[ chan ] += tone_count;					\
-  count = 0;								\
-  while( ay_tone_tick[ chan ] >= ay_tone_period[ chan ] ) {		\
-    count++;								\
-    ay_tone_tick[ chan ] -= ay_tone_period[ chan ];			\
-    ay_tone_high[ chan ] = !ay_tone_high[ chan ];			\
-    									\
-    /* has to be here, unfortunately... */				\
-    if( count == 1 && level && ay_tone_tick[ chan ] < tone_count ) {	\
-      if( is_low )							\
-        ( var ) += AY_GET_SUBVAL( chan );				\
-      else								\
-        ( var ) -= AY_GET_SUBVAL( chan );				\
-      }									\
-    }									\
-  									\
-  /* if it's changed more than once during the sample, we can't */	\
-  /* represent it faithfully. So, just hope it's a sample.      */	\
-  /* (That said, this should also help avoid aliasing noise.)   */	\
-  if( count > 1 )							\
-    ( var ) = -( level )
-
-
-/* add val, correctly delayed on either left or right buffer,
- * to add the AY stereo positioning. This doesn't actually put
- * anything directly in sound_buf, though.
- */
-#define GEN_STEREO( pos, val ) \
-  if( ( pos ) < 0 ) {							\
-    rstereobuf_l[ rstereopos ] += ( val );				\
-    rstereobuf_r[ ( rstereopos - pos ) % STEREO_BUF_SIZE ] += ( val );	\
-  } else {								\
-    rstereobuf_l[ ( rstereopos + pos ) % STEREO_BUF_SIZE ] += ( val );	\
-    rstereobuf_r[ rstereopos ] += ( val );				\
+  blep_clear( sound_blep[0] );
+  if( sound_blep[1] ) blep_clear( sound_blep[1] );
+
+  for( f = 0; f < 3; f++ ) ay_output[f] = 0;
+  for( f = 0; f < 2; f++ )
+    if( sound_oldval[f] ) sound_beeper_delta( f, 0, sound_oldval[f] );
+}
+
+/* In turbo mode the sound would be thrown away anyway, so only the
+   beeper levels and AY registers are tracked; a movie still wants it.
+   Anything left in the buffers when turbo mode ends is from before it
+   started, so is dropped */
+static int
+sound_turbo_skip( void )
+{
+  if( settings_current.turbo && !movie_recording ) {
+    sound_skipping = 1;
+    return 1;
   }
 
+  if( sound_skipping ) {
+    sound_skipping = 0;
+    sound_rebase();
+  }
+
+  return 0;
+}
 
 
 /* bitmasks for envelope */
@@ -445,239 +479,302 @@ sound_write_buf_pstereo( libspectrum_signed_word * out, int c )
 #define AY_ENV_ALT	2
 #define AY_ENV_HOLD	1
 
-#define HZ_COMMON_DENOMINATOR 50
+/* The level output on a channel with the current state of the chip.
+ * If no tone/noise is selected, the chip just shoves the level out
+ * unmodified; this is used by some sample-playing stuff.
+ */
+static int
+sound_ay_channel( int chan )
+{
+  int volume = sound_ay_registers[ 8 + chan ];
+  int mixer = sound_ay_registers[7];
+  int level;
+
+  level = ay_tone_levels[ ( volume & 16 ) ? ay_env_counter : volume & 15 ];
+
+  if( !( mixer & ( 8 << chan ) ) && ay_noise_toggle )
+    return 0;
+
+  if( !( mixer & ( 1 << chan ) ) ) {
+    /* A tone too high to be represented comes out at its low level,
+       which keeps the samples in (e.g.) Robocop audible */
+    if( ( ay_tone_period[ chan ] << AY_TICK_BITS ) < ay_sample_ticks )
+      return -level;
+    return ay_tone_high[ chan ] ? level : -level;
+  }
 
+  return level;
+}
+
+/* Add a step to the output for each channel whose level has changed */
 static void
-sound_ay_overlay( void )
+sound_ay_output( libspectrum_dword now )
 {
-  static int rng = 1;
-  static int noise_toggle = 0;
-  static int env_first = 1, env_rev = 0, env_counter = 15;
-  int tone_level[3];
-  int mixer, envshape;
-  int f, g, level, count;
-  libspectrum_signed_word *ptr;
-  struct ay_change_tag *change_ptr = ay_change;
-  int changes_left = ay_change_count;
-  int reg, r;
-  int is_low;
-  int chan1, chan2, chan3;
-  unsigned int tone_count, noise_count;
-  libspectrum_dword sfreq, cpufreq;
+  libspectrum_dword position = ( now * ay_position_scale ) >> 32;
+  int chan, level, delta, total = 0;
 
-/* If no AY chip, don't produce any AY sound (!) */
-  if( !machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_AY )
-    return;
+  for( chan = 0; chan < 3; chan++ ) {
+    level = sound_ay_channel( chan );
+    delta = level - ay_output[ chan ];
+    if( !delta ) continue;
 
-/* convert change times to sample offsets, use common denominator of 50 to
-   avoid overflowing a dword */
-  sfreq = sound_generator_freq / HZ_COMMON_DENOMINATOR;
-  cpufreq = machine_current->timings.processor_speed / HZ_COMMON_DENOMINATOR;
-  for( f = 0; f < ay_change_count; f++ )
-    ay_change[f].ofs = ( ay_change[f].tstates * sfreq ) / cpufreq;
-
-  for( f = 0, ptr = sound_buf; f < sound_generator_framesiz; f++ ) {
-    /* update ay registers. All this sub-frame change stuff
-     * is pretty hairy, but how else would you handle the
-     * samples in Robocop? :-) It also clears up some other
-     * glitches.
-     */
-    while( changes_left && f >= change_ptr->ofs ) {
-      sound_ay_registers[ reg = change_ptr->reg ] = change_ptr->val;
-      change_ptr++;
-      changes_left--;
-
-      /* fix things as needed for some register changes */
-      switch ( reg ) {
-      case 0:
-      case 1:
-      case 2:
-      case 3:
-      case 4:
-      case 5:
-	r = reg >> 1;
-	/* a zero-len period is the same as 1 */
-	ay_tone_period[r] = ( sound_ay_registers[ reg & ~1 ] |
-			      ( sound_ay_registers[ reg | 1 ] & 15 ) << 8 );
-	if( !ay_tone_period[r] )
-	  ay_tone_period[r]++;
-
-	/* important to get this right, otherwise e.g. Ghouls 'n' Ghosts
-	 * has really scratchy, horrible-sounding vibrato.
-	 */
-	if( ay_tone_tick[r] >= ay_tone_period[r] * 2 )
-	  ay_tone_tick[r] %= ay_tone_period[r] * 2;
-	break;
-      case 6:
-	ay_noise_tick = 0;
-	ay_noise_period = ( sound_ay_registers[ reg ] & 31 );
-	break;
-      case 11:
-      case 12:
-	/* this one *isn't* fixed-point */
-	ay_env_period =
-	  sound_ay_registers[11] | ( sound_ay_registers[12] << 8 );
-	break;
-      case 13:
-	ay_env_internal_tick = ay_env_tick = ay_env_subcycles = 0;
-	env_first = 1;
-	env_rev = 0;
-	env_counter = ( sound_ay_registers[13] & AY_ENV_ATTACK ) ? 0 : 15;
-	break;
-      }
+    ay_output[ chan ] = level;
+
+    if( sound_stereo_ay ) {
+      blep_add_delta( sound_blep[0], position + ay_delay[0][ chan ], delta );
+      blep_add_delta( sound_blep[1], position + ay_delay[1][ chan ], delta );
+    } else
+      total += delta;
+  }
+
+  if( total ) sound_add_delta( position, total );
+}
+
+static void
+sound_ay_noise_step( void )
+{
+  if( ( ay_rng & 1 ) ^ ( ( ay_rng & 2 ) ? 1 : 0 ) )
+    ay_noise_toggle = !ay_noise_toggle;
+
+  /* rng is 17-bit shift reg, bit 0 is output.
+   * input is bit 0 xor bit 2.
+   */
+  ay_rng |= ( ( ay_rng & 1 ) ^ ( ( ay_rng & 4 ) ? 1 : 0 ) ) ? 0x20000 : 0;
+  ay_rng >>= 1;
+}
+
+/* do a 1/16th-of-period incr/decr if needed */
+static void
+sound_ay_env_step( void )
+{
+  int envshape = sound_ay_registers[13];
+
+  if( ay_env_first ||
+      ( ( envshape & AY_ENV_CONT ) && !( envshape & AY_ENV_HOLD ) ) ) {
+    if( ay_env_rev )
+      ay_env_counter -= ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
+    else
+      ay_env_counter += ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
+    if( ay_env_counter < 0 )
+      ay_env_counter = 0;
+    if( ay_env_counter > 15 )
+      ay_env_counter = 15;
+  }
+
+  if( ++ay_env_internal_tick < 16 ) return;
+  ay_env_internal_tick = 0;
+
+  /* end of cycle */
+  if( !( envshape & AY_ENV_CONT ) )
+    ay_env_counter = 0;
+  else {
+    if( envshape & AY_ENV_HOLD ) {
+      if( ay_env_first && ( envshape & AY_ENV_ALT ) )
+	ay_env_counter = ( ay_env_counter ? 0 : 15 );
+    } else {
+      /* non-hold */
+      if( envshape & AY_ENV_ALT )
+	ay_env_rev = !ay_env_rev;
+      else
+	ay_env_counter = ( envshape & AY_ENV_ATTACK ) ? 0 : 15;
     }
+  }
 
-    /* the tone level if no enveloping is being used */
-    for( g = 0; g < 3; g++ )
-      tone_level[g] = ay_tone_levels[ sound_ay_registers[ 8 + g ] & 15 ];
+  ay_env_first = 0;
+}
 
-    /* envelope */
-    envshape = sound_ay_registers[13];
-    level = ay_tone_levels[ env_counter ];
+/* The noise and envelope counters step every 16 AY cycles; a period of
+   zero is the same as one */
+#define AY_TONE_STEP( chan ) \
+  ( ay_tone_period[ chan ] << AY_TICK_BITS )
+#define AY_NOISE_STEP \
+  ( ( ay_noise_period ? ay_noise_period : 1 ) << ( AY_TICK_BITS + 1 ) )
+#define AY_ENV_STEP \
+  ( (libspectrum_dword)( ay_env_period ? ay_env_period : 1 ) << \
+    ( AY_TICK_BITS + 1 ) )
+
+/* Run the chip up to (but not including) 'until'. Only the counters
+ * which can affect the output are stepped one at a time; the others
+ * are just brought up to date at the end.
+ */
+static void
+sound_ay_run( libspectrum_dword until )
+{
+  int mixer = sound_ay_registers[7];
+  int tone_active[3], noise_active = 0, env_active = 0;
+  int chan, which;
+  libspectrum_dword next, step;
+
+  for( chan = 0; chan < 3; chan++ ) {
+    int volume = sound_ay_registers[ 8 + chan ] & 0x1f;
+
+    tone_active[ chan ] = volume && !( mixer & ( 1 << chan ) ) &&
+      AY_TONE_STEP( chan ) >= ay_sample_ticks;
+    if( volume && !( mixer & ( 8 << chan ) ) ) noise_active = 1;
+    if( volume & 16 ) env_active = 1;
+  }
 
-    for( g = 0; g < 3; g++ )
-      if( sound_ay_registers[ 8 + g ] & 16 )
-	tone_level[g] = level;
+  while( 1 ) {
 
-    /* envelope output counter gets incr'd every 16 AY cycles.
-     * Has to be a while, as this is sub-output-sample res.
-     */
-    ay_env_subcycles += ay_tick_incr;
-    noise_count = 0;
-    while( ay_env_subcycles >= ( 16 << 16 ) ) {
-      ay_env_subcycles -= ( 16 << 16 );
-      noise_count++;
-      ay_env_tick++;
-      while( ay_env_tick >= ay_env_period ) {
-	ay_env_tick -= ay_env_period;
-
-	/* do a 1/16th-of-period incr/decr if needed */
-	if( env_first ||
-	    ( ( envshape & AY_ENV_CONT ) && !( envshape & AY_ENV_HOLD ) ) ) {
-	  if( env_rev )
-	    env_counter -= ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
-	  else
-	    env_counter += ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
-	  if( env_counter < 0 )
-	    env_counter = 0;
-	  if( env_counter > 15 )
-	    env_counter = 15;
-	}
-
-	ay_env_internal_tick++;
-	while( ay_env_internal_tick >= 16 ) {
-	  ay_env_internal_tick -= 16;
-
-	  /* end of cycle */
-	  if( !( envshape & AY_ENV_CONT ) )
-	    env_counter = 0;
-	  else {
-	    if( envshape & AY_ENV_HOLD ) {
-	      if( env_first && ( envshape & AY_ENV_ALT ) )
-		env_counter = ( env_counter ? 0 : 15 );
-	    } else {
-	      /* non-hold */
-	      if( envshape & AY_ENV_ALT )
-		env_rev = !env_rev;
-	      else
-		env_counter = ( envshape & AY_ENV_ATTACK ) ? 0 : 15;
-	    }
-	  }
-
-	  env_first = 0;
-	}
-
-	/* don't keep trying if period is zero */
-	if( !ay_env_period )
-	  break;
+    next = until; which = -1;
+
+    for( chan = 0; chan < 3; chan++ )
+      if( tone_active[ chan ] && ay_tone_next[ chan ] < next ) {
+	next = ay_tone_next[ chan ]; which = chan;
       }
+    if( noise_active && ay_noise_next < next ) {
+      next = ay_noise_next; which = 3;
     }
-
-    /* generate tone+noise... or neither.
-     * (if no tone/noise is selected, the chip just shoves the
-     * level out unmodified. This is used by some sample-playing
-     * stuff.)
-     */
-    chan1 = tone_level[0];
-    chan2 = tone_level[1];
-    chan3 = tone_level[2];
-    mixer = sound_ay_registers[7];
-
-    ay_tone_subcycles += ay_tick_incr;
-    tone_count = ay_tone_subcycles >> ( 3 + 16 );
-    ay_tone_subcycles &= ( 8 << 16 ) - 1;
-
-    if( ( mixer & 1 ) == 0 ) {
-      level = chan1;
-      AY_DO_TONE( chan1, 0 );
+    if( env_active && ay_env_next < next ) {
+      next = ay_env_next; which = 4;
     }
-    if( ( mixer & 0x08 ) == 0 && noise_toggle )
-      chan1 = 0;
 
-    if( ( mixer & 2 ) == 0 ) {
-      level = chan2;
-      AY_DO_TONE( chan2, 1 );
+    if( which == -1 ) break;
+
+    switch( which ) {
+    case 3:
+      sound_ay_noise_step(); ay_noise_next += AY_NOISE_STEP; break;
+    case 4:
+      sound_ay_env_step(); ay_env_next += AY_ENV_STEP; break;
+    default:
+      ay_tone_high[ which ] = !ay_tone_high[ which ];
+      ay_tone_next[ which ] += AY_TONE_STEP( which );
+      break;
     }
-    if( ( mixer & 0x10 ) == 0 && noise_toggle )
-      chan2 = 0;
 
-    if( ( mixer & 4 ) == 0 ) {
-      level = chan3;
-      AY_DO_TONE( chan3, 2 );
-    }
-    if( ( mixer & 0x20 ) == 0 && noise_toggle )
-      chan3 = 0;
+    sound_ay_output( next );
+  }
 
-    /* write the sample(s) */
-    if( !sound_stereo ) {
-      /* mono */
-      ( *ptr++ ) += chan1 + chan2 + chan3;
-    } else {
-      if( !sound_stereo_ay ) {
-	/* stereo output, but mono AY sound; still,
-	 * incr separately in case of beeper pseudostereo.
-	 */
-	( *ptr++ ) += chan1 + chan2 + chan3;
-	( *ptr++ ) += chan1 + chan2 + chan3;
-      } else {
-	/* stereo with ACB/ABC AY positioning.
-	 * Here we use real stereo positions for the channels.
-	 * Just because, y'know, it's cool and stuff. No, really. :-)
-	 * This is a little tricky, as it works by delaying sounds
-	 * on the left or right channels to model the delay you get
-	 * in the real world when sounds originate at different places.
-	 */
-	GEN_STEREO( rchan1pos, chan1 );
-	GEN_STEREO( rchan2pos, chan2 );
-	GEN_STEREO( rchan3pos, chan3 );
-	( *ptr++ ) += rstereobuf_l[ rstereopos ];
-	( *ptr++ ) += rstereobuf_r[ rstereopos ];
-	rstereobuf_l[ rstereopos ] = rstereobuf_r[ rstereopos ] = 0;
-	rstereopos++;
-	if( rstereopos >= STEREO_BUF_SIZE )
-	  rstereopos = 0;
-      }
-    }
+  for( chan = 0; chan < 3; chan++ ) {
+    if( ay_tone_next[ chan ] >= until ) continue;
+    step = AY_TONE_STEP( chan );
+    which = ( until - ay_tone_next[ chan ] - 1 ) / step + 1;
+    if( which & 1 ) ay_tone_high[ chan ] = !ay_tone_high[ chan ];
+    ay_tone_next[ chan ] += which * step;
+  }
 
-    /* update noise RNG/filter */
-    ay_noise_tick += noise_count;
-    while( ay_noise_tick >= ay_noise_period ) {
-      ay_noise_tick -= ay_noise_period;
+  /* Nothing can hear the noise generator, so it doesn't matter where in
+     its sequence it is */
+  if( ay_noise_next < until ) {
+    step = AY_NOISE_STEP;
+    ay_noise_next += ( ( until - ay_noise_next - 1 ) / step + 1 ) * step;
+  }
 
-      if( ( rng & 1 ) ^ ( ( rng & 2 ) ? 1 : 0 ) )
-	noise_toggle = !noise_toggle;
+  while( ay_env_next < until ) {
+    sound_ay_env_step(); ay_env_next += AY_ENV_STEP;
+  }
+}
 
-      /* rng is 17-bit shift reg, bit 0 is output.
-       * input is bit 0 xor bit 2.
-       */
-      rng |= ( ( rng & 1 ) ^ ( ( rng & 4 ) ? 1 : 0 ) ) ? 0x20000 : 0;
-      rng >>= 1;
+/* Where would a counter which was due to step at 'next' with the old
+ * period be due to step with the new one?
+ */
+static libspectrum_dword
+sound_ay_reperiod( libspectrum_dword next, libspectrum_dword now,
+		   libspectrum_dword old_step, libspectrum_dword new_step )
+{
+  libspectrum_dword elapsed = old_step - ( next - now );
 
-      /* don't keep trying if period is zero */
-      if( !ay_noise_period )
-	break;
+  return elapsed < new_step ? now + new_step - elapsed : now;
+}
+
+static void
+sound_ay_change( int reg, int val, libspectrum_dword now )
+{
+  libspectrum_dword old_step, elapsed;
+  int r;
+
+  sound_ay_registers[ reg ] = val;
+
+  /* fix things as needed for some register changes */
+  switch ( reg ) {
+  case 0:
+  case 1:
+  case 2:
+  case 3:
+  case 4:
+  case 5:
+    r = reg >> 1;
+    old_step = AY_TONE_STEP( r );
+
+    /* a zero-len period is the same as 1 */
+    ay_tone_period[r] = ( sound_ay_registers[ reg & ~1 ] |
+			  ( sound_ay_registers[ reg | 1 ] & 15 ) << 8 );
+    if( !ay_tone_period[r] )
+      ay_tone_period[r]++;
+
+    /* important to get this right, otherwise e.g. Ghouls 'n' Ghosts
+     * has really scratchy, horrible-sounding vibrato.
+     */
+    elapsed = old_step - ( ay_tone_next[r] - now );
+    if( elapsed >= AY_TONE_STEP( r ) * 2 )
+      elapsed %= AY_TONE_STEP( r ) * 2;
+    if( elapsed >= AY_TONE_STEP( r ) ) {
+      ay_tone_high[r] = !ay_tone_high[r];
+      elapsed -= AY_TONE_STEP( r );
     }
+    ay_tone_next[r] = now + AY_TONE_STEP( r ) - elapsed;
+    break;
+  case 6:
+    ay_noise_period = ( sound_ay_registers[ reg ] & 31 );
+    ay_noise_next = now + AY_NOISE_STEP;
+    break;
+  case 11:
+  case 12:
+    old_step = AY_ENV_STEP;
+    ay_env_period =
+      sound_ay_registers[11] | ( sound_ay_registers[12] << 8 );
+    ay_env_next = sound_ay_reperiod( ay_env_next, now, old_step,
+				     AY_ENV_STEP );
+    break;
+  case 13:
+    ay_env_internal_tick = 0;
+    ay_env_first = 1;
+    ay_env_rev = 0;
+    ay_env_counter = ( sound_ay_registers[13] & AY_ENV_ATTACK ) ? 0 : 15;
+    ay_env_next = now + AY_ENV_STEP;
+    break;
   }
+
+  sound_ay_output( now );
+}
+
+static void
+sound_ay_overlay( void )
+{
+  libspectrum_dword now = 0, when;
+  int f;
+
+/* If no AY chip, don't produce any AY sound (!) */
+  if( !( machine_current->capabilities &
+	 LIBSPECTRUM_MACHINE_CAPABILITY_AY ) )
+    return;
+  if( !ay_position_scale )
+    return;
+
+  /* Pick up any change in level since the buffers were replaced */
+  sound_ay_output( 0 );
+
+  /* update ay registers. All this sub-frame change stuff
+   * is pretty hairy, but how else would you handle the
+   * samples in Robocop? :-) It also clears up some other
+   * glitches.
+   */
+  for( f = 0; f < ay_change_count; f++ ) {
+    when = ( ay_change[f].tstates * ay_tstate_scale ) >> 32;
+    if( when > ay_frame_ticks ) when = ay_frame_ticks;
+    if( when < now ) when = now;
+
+    sound_ay_run( when );
+    sound_ay_change( ay_change[f].reg, ay_change[f].val, when );
+    now = when;
+  }
+
+  sound_ay_run( ay_frame_ticks );
+
+  /* Times are relative to the start of the frame */
+  for( f = 0; f < 3; f++ ) ay_tone_next[f] -= ay_frame_ticks;
+  ay_noise_next -= ay_frame_ticks;
+  ay_env_next -= ay_frame_ticks;
 }
 
 
@@ -710,34 +807,9 @@ sound_ay_reset( void )
   ay_change_count = 0;
   for( f = 0; f < 16; f++ )
     sound_ay_write( f, 0, 0 );
-  for( f = 0; f < 3; f++ )
-    ay_tone_high[f] = 0;
-  ay_tone_subcycles = ay_env_subcycles = 0;
 }
 
 
-/* write stereo or mono beeper sample, and incr ptr */
-#define SOUND_WRITE_BUF_BEEPER( ptr, val ) \
-  do {							\
-    if( sound_stereo_beeper ) {				\
-      sound_write_buf_pstereo( ( ptr ), ( val ) );	\
-      ( ptr ) += 2;					\
-    } else {						\
-      *( ptr )++ = ( val );				\
-      if( sound_stereo )				\
-        *( ptr )++ = ( val );				\
-    }							\
-  } while(0)
-
-/* the tape version works by writing to a separate mono buffer,
- * which gets added after being generated.
- */
-#define SOUND_WRITE_BUF( is_tape, ptr, val ) \
-  if( is_tape )					\
-    *( ptr )++ = ( val );			\
-  else						\
-    SOUND_WRITE_BUF_BEEPER( ptr, val )
-
 #ifdef HAVE_SAMPLERATE
 static void
 sound_resample( void )
@@ -777,39 +849,58 @@ sound_resample( void )
 }
 #endif /* #ifdef HAVE_SAMPLERATE */
 
+/* In turbo mode no AY sound is generated, so just keep the last value
+   written to each register; these then take effect at the start of
+   the first frame after turbo mode ends */
+static void
+sound_ay_coalesce( void )
+{
+  int last[16];
+  int f, count;
+
+  for( f = 0; f < 16; f++ ) last[f] = -1;
+  for( f = 0; f < ay_change_count; f++ ) last[ ay_change[f].reg ] = f;
+
+  for( f = 0, count = 0; f < ay_change_count; f++ ) {
+    if( last[ ay_change[f].reg ] != f ) continue;
+    ay_change[ count ] = ay_change[f];
+    ay_change[ count ].tstates = 0;
+    count++;
+  }
+
+  ay_change_count = count;
+}
+
 void
 sound_frame( void )
 {
-  libspectrum_signed_word *ptr, *tptr;
-  int f, bchan;
-  int ampl = AMPL_BEEPER;
-
   if( !sound_enabled )
     return;
 
-/* fill in remaining beeper/tape sound */
-  ptr =
-    sound_buf + ( sound_stereo ? sound_fillpos[0] * 2 : sound_fillpos[0] );
-  for( bchan = 0; bchan < 2; bchan++ ) {
-    for( f = sound_fillpos[ bchan ]; f < sound_generator_framesiz; f++ )
-      SOUND_WRITE_BUF( bchan, ptr, sound_oldval[ bchan ] );
-
-    ptr = tape_buf + sound_fillpos[1];
-    ampl = AMPL_TAPE;
-  }
-
-/* overlay tape sound */
-  ptr = sound_buf;
-  tptr = tape_buf;
-  for( f = 0; f < sound_generator_framesiz; f++, tptr++ ) {
-    ( *ptr++ ) += *tptr;
-    if( sound_stereo )
-      ( *ptr++ ) += *tptr;
+  if( sound_turbo_skip() ) {
+    sound_ay_coalesce();
+    return;
   }
 
-/* overlay AY sound */
   sound_ay_overlay();
 
+/* turn the beeper, tape and AY steps into samples */
+  if( sound_blep[1] )
+    blep_read_stereo( sound_blep[0], sound_blep[1], sound_buf,
+		      sound_generator_framesiz );
+  else
+    blep_read( sound_blep[0], sound_buf, sound_generator_framesiz,
+	       sound_channels );
+
+  if( movie_recording )
+    movie_add_sound( sound_buf, sound_generator_framesiz, sound_channels,
+		     sound_generator_freq );
+
+  if( settings_current.turbo ) {
+    ay_change_count = 0;
+    return;
+  }
+
 #ifdef HAVE_SAMPLERATE
 /* resample from generated frequency down to output frequency if required */
   if( settings_current.sound_hifi )
@@ -819,9 +910,6 @@ sound_frame( void )
     sound_lowlevel_frame( sound_buf,
 			  sound_generator_framesiz * sound_channels );
 
-  sound_oldpos[0] = sound_oldpos[1] = -1;
-  sound_fillpos[0] = sound_fillpos[1] = 0;
-
   ay_change_count = 0;
 }
 
@@ -832,75 +920,24 @@ sound_frame( void )
 void
 sound_beeper( int is_tape, int on )
 {
-  libspectrum_signed_word *ptr;
-  int newpos, subpos;
-  int val, subval;
-  int f;
   int bchan = ( is_tape ? 1 : 0 );
   int ampl = ( is_tape ? AMPL_TAPE : AMPL_BEEPER );
-  int vol = ampl * 2;
+  int val;
 
   if( !sound_enabled )
     return;
 
   val = ( on ? -ampl : ampl );
 
-  if( val == sound_oldval_orig[ bchan ] )
+  if( val == sound_oldval[ bchan ] )
     return;
 
-/* XXX a lookup table might help here, but would need to regenerate it
- * whenever cycles_per_frame were changed (i.e. when machine type changed).
- */
-  newpos =
-    ( tstates * sound_generator_framesiz ) /
-    machine_current->timings.tstates_per_frame;
-  subpos =
-    ( ( ( libspectrum_signed_qword ) tstates ) * sound_generator_framesiz *
-      vol ) / ( machine_current->timings.tstates_per_frame ) - vol * newpos;
-
-/* if we already wrote here, adjust the level.
- */
-  if( newpos == sound_oldpos[ bchan ] ) {
-    /* adjust it as if the rest of the sample period were all in
-     * the new state. (Often it will be, but if not, we'll fix
-     * it later by doing this again.)
-     */
-    if( on )
-      beeper_last_subpos[ bchan ] += vol - subpos;
-    else
-      beeper_last_subpos[ bchan ] -= vol - subpos;
-  } else
-    beeper_last_subpos[ bchan ] = ( on ? vol - subpos : subpos );
-
-  subval = ampl - beeper_last_subpos[ bchan ];
-
-  if( newpos >= 0 ) {
-    /* fill gap from previous position */
-    if( is_tape )
-      ptr = tape_buf + sound_fillpos[1];
-    else
-      ptr =
-	sound_buf +
-	( sound_stereo ? sound_fillpos[0] * 2 : sound_fillpos[0] );
-
-    for( f = sound_fillpos[ bchan ];
-	 f < newpos && f < sound_generator_framesiz;
-	 f++ )
-      SOUND_WRITE_BUF( bchan, ptr, sound_oldval[ bchan ] );
-
-    if( newpos < sound_generator_framesiz ) {
-      /* newpos may be less than sound_fillpos, so... */
-      if( is_tape )
-	ptr = tape_buf + newpos;
-      else
-	ptr = sound_buf + ( sound_stereo ? newpos * 2 : newpos );
-
-      /* write subsample value */
-      SOUND_WRITE_BUF( bchan, ptr, subval );
-    }
+  if( sound_turbo_skip() ) {
+    sound_oldval[ bchan ] = val;
+    return;
   }
 
-  sound_oldpos[ bchan ] = newpos;
-  sound_fillpos[ bchan ] = newpos + 1;
-  sound_oldval[ bchan ] = sound_oldval_orig[ bchan ] = val;
+  sound_beeper_delta( is_tape, ( tstates * sound_beeper_scale ) >> 32,
+		      val - sound_oldval[ bchan ] );
+  sound_oldval[ bchan ] = val;
 }
@@ -0,0 +1,605 @@
+/* aybench.c: Compare the speed of AY sound generation methods
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Times sound_frame() against the per-sample AY overlay it replaced,
+   which is kept here as a reference, on the same register writes: a
+   typical tune driven from the interrupt, and a 4-bit sample played by
+   writing a volume register many times a frame. Output is mono 16-bit
+   at the usual output rates. This file supplies dummy versions of
+   everything sound.c needs from the rest of Fuse */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libspectrum.h>
+
+#include "machine.h"
+#include "movie.h"
+#include "settings.h"
+#include "sound.h"
+#include "tape.h"
+#include "ui/ui.h"
+
+#if defined( __i386__ ) || defined( __x86_64__ )
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#endif
+
+/* Not exported by sound.h */
+extern int sound_generator_framesiz;
+
+/* How many frames to run for each test */
+static const int BENCH_FRAMES = 3000;
+
+static fuse_machine_info dummy_machine;
+
+/* Checksum of everything output, so nothing can be optimised away */
+static libspectrum_dword output_checksum;
+
+/*
+ * The reference implementation
+ */
+
+struct ref_change_tag
+{
+  libspectrum_dword tstates;
+  unsigned short ofs;
+  unsigned char reg, val;
+};
+
+#define AY_CHANGE_MAX 8000
+
+static struct ref_change_tag ref_ay_change[ AY_CHANGE_MAX ];
+static int ref_ay_change_count;
+
+static unsigned int ref_ay_tone_levels[16];
+static libspectrum_signed_word *ref_sound_buf;
+static int ref_sound_generator_freq, ref_sound_generator_framesiz;
+
+static unsigned int ref_ay_tone_tick[3], ref_ay_tone_high[3], ref_ay_noise_tick;
+static unsigned int ref_ay_tone_subcycles, ref_ay_env_subcycles;
+static unsigned int ref_ay_env_internal_tick, ref_ay_env_tick;
+static unsigned int ref_ay_tick_incr;
+static unsigned int ref_ay_tone_period[3], ref_ay_noise_period, ref_ay_env_period;
+static libspectrum_byte ref_sound_ay_registers[16];
+
+/* bitmasks for envelope */
+#define AY_ENV_CONT	8
+#define AY_ENV_ATTACK	4
+#define AY_ENV_ALT	2
+#define AY_ENV_HOLD	1
+
+#define HZ_COMMON_DENOMINATOR 50
+
+/* The per-sample overlay, as it was in sound.c */
+
+#define AY_GET_SUBVAL( chan ) \
+  ( level * 2 * ref_ay_tone_tick[ chan ] / tone_count )
+
+#define AY_DO_TONE( var, chan ) \
+  ( var ) = 0;								\
+  is_low = 0;								\
+  if( level ) {								\
+    if( ref_ay_tone_high[ chan ] )						\
+      ( var ) = ( level );						\
+    else {								\
+      ( var ) = -( level );						\
+      is_low = 1;							\
+    }									\
+  }									\
+  									\
+  ref_ay_tone_tick[ chan ] += tone_count;					\
+  count = 0;								\
+  while( ref_ay_tone_tick[ chan ] >= ref_ay_tone_period[ chan ] ) {		\
+    count++;								\
+    ref_ay_tone_tick[ chan ] -= ref_ay_tone_period[ chan ];			\
+    ref_ay_tone_high[ chan ] = !ref_ay_tone_high[ chan ];			\
+    									\
+    /* has to be here, unfortunately... */				\
+    if( count == 1 && level && ref_ay_tone_tick[ chan ] < tone_count ) {	\
+      if( is_low )							\
+        ( var ) += AY_GET_SUBVAL( chan );				\
+      else								\
+        ( var ) -= AY_GET_SUBVAL( chan );				\
+      }									\
+    }									\
+  									\
+  /* if it's changed more than once during the sample, we can't */	\
+  /* represent it faithfully. So, just hope it's a sample.      */	\
+  /* (That said, this should also help avoid aliasing noise.)   */	\
+  if( count > 1 )							\
+    ( var ) = -( level )
+
+
+static void
+reference_overlay( void )
+{
+  static int rng = 1;
+  static int noise_toggle = 0;
+  static int env_first = 1, env_rev = 0, env_counter = 15;
+  int tone_level[3];
+  int mixer, envshape;
+  int f, g, level, count;
+  libspectrum_signed_word *ptr;
+  struct ref_change_tag *change_ptr = ref_ay_change;
+  int changes_left = ref_ay_change_count;
+  int reg, r;
+  int is_low;
+  int chan1, chan2, chan3;
+  unsigned int tone_count, noise_count;
+  libspectrum_dword sfreq, cpufreq;
+
+/* If no AY chip, don't produce any AY sound (!) */
+  if( !( machine_current->capabilities &
+	 LIBSPECTRUM_MACHINE_CAPABILITY_AY ) )
+    return;
+
+/* convert change times to sample offsets, use common denominator of 50 to
+   avoid overflowing a dword */
+  sfreq = ref_sound_generator_freq / HZ_COMMON_DENOMINATOR;
+  cpufreq = machine_current->timings.processor_speed / HZ_COMMON_DENOMINATOR;
+  for( f = 0; f < ref_ay_change_count; f++ )
+    ref_ay_change[f].ofs = ( ref_ay_change[f].tstates * sfreq ) / cpufreq;
+
+  for( f = 0, ptr = ref_sound_buf; f < ref_sound_generator_framesiz; f++ ) {
+    /* update ay registers. All this sub-frame change stuff
+     * is pretty hairy, but how else would you handle the
+     * samples in Robocop? :-) It also clears up some other
+     * glitches.
+     */
+    while( changes_left && f >= change_ptr->ofs ) {
+      ref_sound_ay_registers[ reg = change_ptr->reg ] = change_ptr->val;
+      change_ptr++;
+      changes_left--;
+
+      /* fix things as needed for some register changes */
+      switch ( reg ) {
+      case 0:
+      case 1:
+      case 2:
+      case 3:
+      case 4:
+      case 5:
+	r = reg >> 1;
+	/* a zero-len period is the same as 1 */
+	ref_ay_tone_period[r] = ( ref_sound_ay_registers[ reg & ~1 ] |
+			      ( ref_sound_ay_registers[ reg | 1 ] & 15 ) << 8 );
+	if( !ref_ay_tone_period[r] )
+	  ref_ay_tone_period[r]++;
+
+	/* important to get this right, otherwise e.g. Ghouls 'n' Ghosts
+	 * has really scratchy, horrible-sounding vibrato.
+	 */
+	if( ref_ay_tone_tick[r] >= ref_ay_tone_period[r] * 2 )
+	  ref_ay_tone_tick[r] %= ref_ay_tone_period[r] * 2;
+	break;
+      case 6:
+	ref_ay_noise_tick = 0;
+	ref_ay_noise_period = ( ref_sound_ay_registers[ reg ] & 31 );
+	break;
+      case 11:
+      case 12:
+	/* this one *isn't* fixed-point */
+	ref_ay_env_period =
+	  ref_sound_ay_registers[11] | ( ref_sound_ay_registers[12] << 8 );
+	break;
+      case 13:
+	ref_ay_env_internal_tick = ref_ay_env_tick = ref_ay_env_subcycles = 0;
+	env_first = 1;
+	env_rev = 0;
+	env_counter = ( ref_sound_ay_registers[13] & AY_ENV_ATTACK ) ? 0 : 15;
+	break;
+      }
+    }
+
+    /* the tone level if no enveloping is being used */
+    for( g = 0; g < 3; g++ )
+      tone_level[g] = ref_ay_tone_levels[ ref_sound_ay_registers[ 8 + g ] & 15 ];
+
+    /* envelope */
+    envshape = ref_sound_ay_registers[13];
+    level = ref_ay_tone_levels[ env_counter ];
+
+    for( g = 0; g < 3; g++ )
+      if( ref_sound_ay_registers[ 8 + g ] & 16 )
+	tone_level[g] = level;
+
+    /* envelope output counter gets incr'd every 16 AY cycles.
+     * Has to be a while, as this is sub-output-sample res.
+     */
+    ref_ay_env_subcycles += ref_ay_tick_incr;
+    noise_count = 0;
+    while( ref_ay_env_subcycles >= ( 16 << 16 ) ) {
+      ref_ay_env_subcycles -= ( 16 << 16 );
+      noise_count++;
+      ref_ay_env_tick++;
+      while( ref_ay_env_tick >= ref_ay_env_period ) {
+	ref_ay_env_tick -= ref_ay_env_period;
+
+	/* do a 1/16th-of-period incr/decr if needed */
+	if( env_first ||
+	    ( ( envshape & AY_ENV_CONT ) && !( envshape & AY_ENV_HOLD ) ) ) {
+	  if( env_rev )
+	    env_counter -= ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
+	  else
+	    env_counter += ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
+	  if( env_counter < 0 )
+	    env_counter = 0;
+	  if( env_counter > 15 )
+	    env_counter = 15;
+	}
+
+	ref_ay_env_internal_tick++;
+	while( ref_ay_env_internal_tick >= 16 ) {
+	  ref_ay_env_internal_tick -= 16;
+
+	  /* end of cycle */
+	  if( !( envshape & AY_ENV_CONT ) )
+	    env_counter = 0;
+	  else {
+	    if( envshape & AY_ENV_HOLD ) {
+	      if( env_first && ( envshape & AY_ENV_ALT ) )
+		env_counter = ( env_counter ? 0 : 15 );
+	    } else {
+	      /* non-hold */
+	      if( envshape & AY_ENV_ALT )
+		env_rev = !env_rev;
+	      else
+		env_counter = ( envshape & AY_ENV_ATTACK ) ? 0 : 15;
+	    }
+	  }
+
+	  env_first = 0;
+	}
+
+	/* don't keep trying if period is zero */
+	if( !ref_ay_env_period )
+	  break;
+      }
+    }
+
+    /* generate tone+noise... or neither.
+     * (if no tone/noise is selected, the chip just shoves the
+     * level out unmodified. This is used by some sample-playing
+     * stuff.)
+     */
+    chan1 = tone_level[0];
+    chan2 = tone_level[1];
+    chan3 = tone_level[2];
+    mixer = ref_sound_ay_registers[7];
+
+    ref_ay_tone_subcycles += ref_ay_tick_incr;
+    tone_count = ref_ay_tone_subcycles >> ( 3 + 16 );
+    ref_ay_tone_subcycles &= ( 8 << 16 ) - 1;
+
+    if( ( mixer & 1 ) == 0 ) {
+      level = chan1;
+      AY_DO_TONE( chan1, 0 );
+    }
+    if( ( mixer & 0x08 ) == 0 && noise_toggle )
+      chan1 = 0;
+
+    if( ( mixer & 2 ) == 0 ) {
+      level = chan2;
+      AY_DO_TONE( chan2, 1 );
+    }
+    if( ( mixer & 0x10 ) == 0 && noise_toggle )
+      chan2 = 0;
+
+    if( ( mixer & 4 ) == 0 ) {
+      level = chan3;
+      AY_DO_TONE( chan3, 2 );
+    }
+    if( ( mixer & 0x20 ) == 0 && noise_toggle )
+      chan3 = 0;
+
+    /* write the sample */
+    ( *ptr++ ) += chan1 + chan2 + chan3;
+
+    /* update noise RNG/filter */
+    ref_ay_noise_tick += noise_count;
+    while( ref_ay_noise_tick >= ref_ay_noise_period ) {
+      ref_ay_noise_tick -= ref_ay_noise_period;
+
+      if( ( rng & 1 ) ^ ( ( rng & 2 ) ? 1 : 0 ) )
+	noise_toggle = !noise_toggle;
+
+      /* rng is 17-bit shift reg, bit 0 is output.
+       * input is bit 0 xor bit 2.
+       */
+      rng |= ( ( rng & 1 ) ^ ( ( rng & 4 ) ? 1 : 0 ) ) ? 0x20000 : 0;
+      rng >>= 1;
+
+      /* don't keep trying if period is zero */
+      if( !ref_ay_noise_period )
+	break;
+    }
+  }
+}
+
+
+static void
+reference_init( int freq )
+{
+  static const int levels[16] = {
+    0x0000, 0x0385, 0x053D, 0x0770,
+    0x0AD7, 0x0FD5, 0x15B0, 0x230C,
+    0x2B4C, 0x43C1, 0x5A4B, 0x732F,
+    0x9204, 0xAFF1, 0xD921, 0xFFFF
+  };
+  int f;
+
+  for( f = 0; f < 16; f++ ) {
+    ref_ay_tone_levels[f] = ( levels[f] * ( 24 * 256 ) + 0x8000 ) / 0xffff;
+    ref_sound_ay_registers[f] = 0;
+  }
+
+  ref_ay_noise_tick = ref_ay_noise_period = 0;
+  ref_ay_env_internal_tick = ref_ay_env_tick = ref_ay_env_period = 0;
+  ref_ay_tone_subcycles = ref_ay_env_subcycles = 0;
+  for( f = 0; f < 3; f++ )
+    ref_ay_tone_tick[f] = ref_ay_tone_high[f] = 0, ref_ay_tone_period[f] = 1;
+  ref_ay_change_count = 0;
+
+  ref_sound_generator_freq = freq;
+  ref_sound_generator_framesiz = sound_generator_framesiz;
+  ref_ay_tick_incr = 65536. *
+    libspectrum_timings_ay_speed( dummy_machine.machine ) / freq;
+
+  free( ref_sound_buf );
+  ref_sound_buf = malloc( ref_sound_generator_framesiz *
+			  sizeof( *ref_sound_buf ) );
+  if( !ref_sound_buf ) {
+    fprintf( stderr, "out of memory\n" );
+    exit( 1 );
+  }
+}
+
+static void
+reference_frame( void )
+{
+  int f;
+
+  /* sound_frame() used to fill the buffer with the beeper level first */
+  for( f = 0; f < ref_sound_generator_framesiz; f++ ) ref_sound_buf[f] = 0;
+
+  reference_overlay();
+  sound_lowlevel_frame( ref_sound_buf, ref_sound_generator_framesiz );
+
+  ref_ay_change_count = 0;
+}
+
+/*
+ * The register writes made each frame
+ */
+
+typedef void (*write_fn)( int reg, int val, libspectrum_dword now );
+
+static void
+reference_write( int reg, int val, libspectrum_dword now )
+{
+  if( ref_ay_change_count < AY_CHANGE_MAX ) {
+    ref_ay_change[ ref_ay_change_count ].tstates = now;
+    ref_ay_change[ ref_ay_change_count ].reg = reg;
+    ref_ay_change[ ref_ay_change_count ].val = val;
+    ref_ay_change_count++;
+  }
+}
+
+/* A three channel tune with some noise and the odd envelope, updated
+   once a frame from the interrupt */
+static void
+tune_frame( int frame, write_fn write )
+{
+  static const int notes[8] = { 424, 378, 337, 318, 283, 252, 225, 212 };
+  libspectrum_dword now = 200;
+  int chan, note;
+
+  for( chan = 0; chan < 3; chan++ ) {
+    note = notes[ ( frame / ( 6 << chan ) + chan * 3 ) % 8 ] >> chan;
+    write( chan * 2,     note & 0xff, now += 40 );
+    write( chan * 2 + 1, note >> 8,   now += 40 );
+  }
+
+  write( 6, frame & 31, now += 40 );
+  write( 7, ( frame & 16 ) ? 0x30 : 0x38, now += 40 );
+  write( 8, 15 - ( frame % 12 ), now += 40 );
+  write( 9, 12, now += 40 );
+
+  if( frame % 32 == 0 ) {
+    write( 10, 16, now += 40 );
+    write( 11, 0x80, now += 40 );
+    write( 12, 0x00, now += 40 );
+    write( 13, 0x0e, now += 40 );
+  }
+}
+
+/* A 4-bit sample on channel A at about 10kHz, with the others silent */
+static void
+sample_frame( int frame, write_fn write )
+{
+  libspectrum_dword now;
+  int i = 0;
+
+  if( frame == 0 ) {
+    write( 7, 0x3f, 0 );
+    write( 9, 0, 0 );
+    write( 10, 0, 0 );
+  }
+
+  for( now = 100; now < 70000; now += 350, i++ )
+    write( 8, ( ( frame * 200 + i ) * 7 / 3 ) & 15, now );
+}
+
+/*
+ * The timing itself
+ */
+
+static double
+now_seconds( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static libspectrum_qword
+now_cycles( void )
+{
+#ifdef HAVE_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void
+bench( const char *name, int freq,
+       void (*frame_fn)( int frame, write_fn write ) )
+{
+  double start, time_new, time_ref;
+  libspectrum_qword cycles, cycles_new, cycles_ref;
+  int f;
+
+  settings_current.sound_freq = freq;
+  sound_init( NULL );
+  if( !sound_enabled ) {
+    fprintf( stderr, "couldn't initialise sound\n" );
+    exit( 1 );
+  }
+  sound_ay_reset();
+  reference_init( freq );
+
+  start = now_seconds(); cycles = now_cycles();
+  for( f = 0; f < BENCH_FRAMES; f++ ) {
+    frame_fn( f, sound_ay_write );
+    sound_frame();
+  }
+  time_new = now_seconds() - start; cycles_new = now_cycles() - cycles;
+
+  start = now_seconds(); cycles = now_cycles();
+  for( f = 0; f < BENCH_FRAMES; f++ ) {
+    frame_fn( f, reference_write );
+    reference_frame();
+  }
+  time_ref = now_seconds() - start; cycles_ref = now_cycles() - cycles;
+
+  sound_end();
+
+  printf( "%-7s %5d Hz: per-sample %7.1f us/frame", name, freq,
+	  time_ref * 1e6 / BENCH_FRAMES );
+#ifdef HAVE_CYCLE_COUNTER
+  printf( " (%7.0f cycles)", (double)cycles_ref / BENCH_FRAMES );
+#endif
+  printf( ", band-limited %7.1f us/frame", time_new * 1e6 / BENCH_FRAMES );
+#ifdef HAVE_CYCLE_COUNTER
+  printf( " (%7.0f cycles)", (double)cycles_new / BENCH_FRAMES );
+#endif
+  printf( "\n" );
+}
+
+int
+main( void )
+{
+  static const int rates[] = { 44100, 48000 };
+  size_t i;
+
+  dummy_machine.machine = LIBSPECTRUM_MACHINE_128;
+  dummy_machine.capabilities = LIBSPECTRUM_MACHINE_CAPABILITY_AY;
+  dummy_machine.timings.processor_speed =
+    libspectrum_timings_processor_speed( LIBSPECTRUM_MACHINE_128 );
+  dummy_machine.timings.tstates_per_frame = 70908;
+  machine_current = &dummy_machine;
+
+  settings_current.sound = 1;
+  settings_current.emulation_speed = 100;
+
+  for( i = 0; i < sizeof( rates ) / sizeof( rates[0] ); i++ ) {
+    bench( "tune",   rates[i], tune_frame );
+    bench( "sample", rates[i], sample_frame );
+  }
+
+  /* Stop the compiler deciding nothing was used */
+  return output_checksum == 0xdeadbeef;
+}
+
+/*
+ * Dummy versions of the rest of Fuse
+ */
+
+libspectrum_dword tstates;
+fuse_machine_info *machine_current;
+settings_info settings_current;
+int movie_recording;
+
+int
+sound_lowlevel_init( const char *device GCC_UNUSED, int *freqptr GCC_UNUSED,
+		     int *stereoptr )
+{
+  *stereoptr = 0;
+  return 0;
+}
+
+void
+sound_lowlevel_end( void )
+{
+}
+
+void
+sound_lowlevel_frame( libspectrum_signed_word *data, int len )
+{
+  int i;
+
+  for( i = 0; i < len; i++ )
+    output_checksum = output_checksum * 31 + (libspectrum_word)data[i];
+}
+
+void
+movie_add_sound( const libspectrum_signed_word *samples GCC_UNUSED,
+		 size_t count GCC_UNUSED, int channels GCC_UNUSED,
+		 int rate GCC_UNUSED )
+{
+}
+
+int
+tape_is_playing( void )
+{
+  return 0;
+}
+
+int
+ui_error( ui_error_level severity GCC_UNUSED, const char *format, ... )
+{
+  va_list ap;
+
+  va_start( ap, format );
+  vfprintf( stderr, format, ap );
+  va_end( ap );
+  fprintf( stderr, "\n" );
+
+  return 0;
+}
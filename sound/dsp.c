@@ -0,0 +1,196 @@
+/* dsp.c: Per-sample sound processing kernels
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <config.h>
+
+#include "sound/dsp.h"
+
+#if defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+#define SOUND_DSP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static libspectrum_signed_word
+saturate( libspectrum_signed_dword sample )
+{
+  if( sample > 32767 ) return 32767;
+  if( sample < -32768 ) return -32768;
+  return sample;
+}
+
+static void
+integrate_c( libspectrum_signed_word *out,
+	     const libspectrum_signed_dword *impulses, size_t count,
+	     libspectrum_signed_dword *level, int shift, size_t copies )
+{
+  libspectrum_signed_dword sum = *level;
+  libspectrum_signed_word sample;
+  size_t i;
+
+  if( copies == 1 ) {
+    for( i = 0; i < count; i++ ) {
+      sum += impulses[i];
+      out[i] = saturate( sum >> shift );
+    }
+  } else {
+    for( i = 0; i < count; i++ ) {
+      sum += impulses[i];
+      sample = saturate( sum >> shift );
+      *out++ = sample; *out++ = sample;
+    }
+  }
+
+  *level = sum;
+}
+
+static void
+integrate_stereo_c( libspectrum_signed_word *out,
+		    const libspectrum_signed_dword *left,
+		    const libspectrum_signed_dword *right, size_t count,
+		    libspectrum_signed_dword *levels, int shift )
+{
+  libspectrum_signed_dword sum_l = levels[0], sum_r = levels[1];
+  size_t i;
+
+  for( i = 0; i < count; i++ ) {
+    sum_l += left[i];  *out++ = saturate( sum_l >> shift );
+    sum_r += right[i]; *out++ = saturate( sum_r >> shift );
+  }
+
+  levels[0] = sum_l; levels[1] = sum_r;
+}
+
+static const sound_dsp_t dsp_c = {
+  "C", integrate_c, integrate_stereo_c
+};
+
+#ifdef SOUND_DSP_SSE2
+
+/* Four samples at a time: a running sum within the vector by adding
+   shifted copies of itself, then the total so far carried in from the
+   previous four; the final pack saturates to 16 bits for free */
+
+#define SSE2_FUNCTION __attribute__(( target( "sse2" ) ))
+
+static inline __m128i SSE2_FUNCTION
+running_sum( __m128i x, __m128i *carry )
+{
+  x = _mm_add_epi32( x, _mm_slli_si128( x, 4 ) );
+  x = _mm_add_epi32( x, _mm_slli_si128( x, 8 ) );
+  x = _mm_add_epi32( x, *carry );
+  *carry = _mm_shuffle_epi32( x, 0xff );
+  return x;
+}
+
+static void SSE2_FUNCTION
+integrate_sse2( libspectrum_signed_word *out,
+		const libspectrum_signed_dword *impulses, size_t count,
+		libspectrum_signed_dword *level, int shift, size_t copies )
+{
+  __m128i carry = _mm_set1_epi32( *level ), x;
+  __m128i shift_count = _mm_cvtsi32_si128( shift );
+  size_t i;
+
+  for( i = 0; i + 4 <= count; i += 4 ) {
+    x = running_sum( _mm_loadu_si128( (const __m128i*)&impulses[i] ),
+		     &carry );
+    x = _mm_sra_epi32( x, shift_count );
+    x = _mm_packs_epi32( x, x );
+    if( copies == 1 ) {
+      _mm_storel_epi64( (__m128i*)&out[i], x );
+    } else {
+      _mm_storeu_si128( (__m128i*)&out[ 2 * i ], _mm_unpacklo_epi16( x, x ) );
+    }
+  }
+
+  *level = _mm_cvtsi128_si32( carry );
+
+  if( i < count )
+    integrate_c( &out[ i * copies ], &impulses[i], count - i, level, shift,
+		 copies );
+}
+
+static void SSE2_FUNCTION
+integrate_stereo_sse2( libspectrum_signed_word *out,
+		       const libspectrum_signed_dword *left,
+		       const libspectrum_signed_dword *right, size_t count,
+		       libspectrum_signed_dword *levels, int shift )
+{
+  __m128i carry_l = _mm_set1_epi32( levels[0] ),
+          carry_r = _mm_set1_epi32( levels[1] ), l, r;
+  __m128i shift_count = _mm_cvtsi32_si128( shift );
+  size_t i;
+
+  for( i = 0; i + 4 <= count; i += 4 ) {
+    l = running_sum( _mm_loadu_si128( (const __m128i*)&left[i] ), &carry_l );
+    r = running_sum( _mm_loadu_si128( (const __m128i*)&right[i] ), &carry_r );
+    l = _mm_sra_epi32( l, shift_count );
+    r = _mm_sra_epi32( r, shift_count );
+    /* l0 .. l3 r0 .. r3, then interleaved */
+    l = _mm_packs_epi32( l, r );
+    _mm_storeu_si128( (__m128i*)&out[ 2 * i ],
+		      _mm_unpacklo_epi16( l, _mm_srli_si128( l, 8 ) ) );
+  }
+
+  levels[0] = _mm_cvtsi128_si32( carry_l );
+  levels[1] = _mm_cvtsi128_si32( carry_r );
+
+  if( i < count )
+    integrate_stereo_c( &out[ 2 * i ], &left[i], &right[i], count - i,
+			levels, shift );
+}
+
+static const sound_dsp_t dsp_sse2 = {
+  "SSE2", integrate_sse2, integrate_stereo_sse2
+};
+
+#endif			/* #ifdef SOUND_DSP_SSE2 */
+
+/* Every implementation compiled in, slowest first */
+static const sound_dsp_t *implementations[] = {
+  &dsp_c,
+#ifdef SOUND_DSP_SSE2
+  &dsp_sse2,
+#endif			/* #ifdef SOUND_DSP_SSE2 */
+};
+
+static size_t available = 1;
+
+const sound_dsp_t *sound_dsp = &dsp_c;
+
+void
+sound_dsp_init( void )
+{
+  available = 1;
+
+#ifdef SOUND_DSP_SSE2
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "sse2" ) ) available++;
+#endif			/* #ifdef SOUND_DSP_SSE2 */
+
+  sound_dsp = implementations[ available - 1 ];
+}
+
+const sound_dsp_t*
+sound_dsp_get( size_t which )
+{
+  return which < available ? implementations[ which ] : NULL;
+}
@@ -0,0 +1,60 @@
+/* dsp.h: Per-sample sound processing kernels
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef FUSE_SOUND_DSP_H
+#define FUSE_SOUND_DSP_H
+
+#include <stdlib.h>
+
+#include <libspectrum.h>
+
+typedef struct sound_dsp_t {
+
+  const char *name;
+
+  /* Add each of 'count' impulses in turn to '*level', and write
+     '*level >> shift', saturated to 16 bits, to 'copies' (1 or 2)
+     consecutive entries of 'out' */
+  void (*integrate)( libspectrum_signed_word *out,
+		     const libspectrum_signed_dword *impulses, size_t count,
+		     libspectrum_signed_dword *level, int shift,
+		     size_t copies );
+
+  /* The same for a left and right side at once, interleaving the
+     output */
+  void (*integrate_stereo)( libspectrum_signed_word *out,
+			    const libspectrum_signed_dword *left,
+			    const libspectrum_signed_dword *right,
+			    size_t count, libspectrum_signed_dword *levels,
+			    int shift );
+
+} sound_dsp_t;
+
+/* The fastest implementation this CPU can run */
+extern const sound_dsp_t *sound_dsp;
+
+void sound_dsp_init( void );
+
+/* Every implementation this CPU can run, starting from the plain C one
+   at index 0; NULL past the end */
+const sound_dsp_t* sound_dsp_get( size_t which );
+
+#endif			/* #ifndef FUSE_SOUND_DSP_H */
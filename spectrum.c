@@ -31,6 +31,8 @@
 #include "debugger/debugger.h"
 #include "display.h"
 #include "event.h"
+#include "headless.h"
+#include "hostprofile.h"
 #include "keyboard.h"
 #include "loader.h"
 #include "machine.h"
@@ -38,6 +40,7 @@
 #include "printer.h"
 #include "psg.h"
 #include "profile.h"
+#include "rewind.h"
 #include "rzx.h"
 #include "settings.h"
 #include "sound.h"
@@ -46,6 +49,7 @@
 #include "timer/timer.h"
 #include "ui/ui.h"
 #include "ui/uijoystick.h"
+#include "ula.h"
 #include "z80/z80.h"
 
 /* 1040 KB of RAM */
@@ -70,15 +74,27 @@ spectrum_frame_event_fn( libspectrum_dword last_tstates, int type,
 			 void *user_data )
 {
   if( rzx_playback ) event_force_events();
+
+  HOSTPROFILE_ENTER( HOSTPROFILE_RZX );
   rzx_frame();
+  HOSTPROFILE_LEAVE();
+
   psg_frame();
   spectrum_frame();
   z80_interrupt();
   ui_joystick_poll();
   timer_estimate_speed();
   debugger_add_time_events();
+
+  HOSTPROFILE_ENTER( HOSTPROFILE_UI );
   ui_event();
+  HOSTPROFILE_LEAVE();
+
   ui_error_frame();
+
+#ifdef HOST_PROFILE
+  hostprofile_frame();
+#endif				/* #ifdef HOST_PROFILE */
 }
 
 int
@@ -108,9 +124,20 @@ spectrum_frame( void )
   if( z80.interrupts_enabled_at >= 0 )
     z80.interrupts_enabled_at -= frame_length;
 
-  if( sound_enabled ) sound_frame();
+  if( sound_enabled ) {
+    HOSTPROFILE_ENTER( HOSTPROFILE_SOUND );
+    sound_frame();
+    HOSTPROFILE_LEAVE();
+  }
 
-  if( display_frame() ) return 1;
+  if( settings_current.headless ) {
+    headless_frame( frame_length );
+  } else {
+    HOSTPROFILE_ENTER( HOSTPROFILE_DISPLAY );
+    error = display_frame();
+    HOSTPROFILE_LEAVE();
+    if( error ) return 1;
+  }
   if( profile_active ) profile_frame( frame_length );
   printer_frame();
 
@@ -122,6 +149,8 @@ spectrum_frame( void )
 
   loader_frame( frame_length );
 
+  rewind_frame();
+
   return 0;
 }
 
@@ -178,39 +207,40 @@ spectrum_contend_delay_76543210( libspectrum_dword time )
   return contend_delay_common( time, contention_pattern_76543210 );
 }
 
-/* What happens if we read from an unattached port? */
-libspectrum_byte
-spectrum_unattached_port( void )
+/* Which byte of the screen is on the bus at 'time'? Used only to build
+   the table used by spectrum_unattached_port() */
+libspectrum_word
+spectrum_floating_bus_offset( libspectrum_dword time )
 {
   int line, tstates_through_line, column;
 
-  /* Return 0xff (idle bus) if we're in the top border */
-  if( tstates < machine_current->line_times[ DISPLAY_BORDER_HEIGHT ] )
-    return 0xff;
+  /* Idle bus if we're in the top border */
+  if( time < machine_current->line_times[ DISPLAY_BORDER_HEIGHT ] )
+    return ULA_FLOATING_BUS_IDLE;
 
   /* Work out which line we're on, relative to the top of the screen */
-  line = ( (libspectrum_signed_dword)tstates -
+  line = ( (libspectrum_signed_dword)time -
 	   machine_current->line_times[ DISPLAY_BORDER_HEIGHT ] ) /
     machine_current->timings.tstates_per_line;
 
   /* Idle bus if we're in the lower border */
-  if( line >= DISPLAY_HEIGHT ) return 0xff;
+  if( line >= DISPLAY_HEIGHT ) return ULA_FLOATING_BUS_IDLE;
 
   /* Work out where we are in this line, remembering that line_times[] holds
      the first pixel we display, not the start of where the Spectrum produced
      the left border */
-  tstates_through_line = tstates -
+  tstates_through_line = time -
     machine_current->line_times[ DISPLAY_BORDER_HEIGHT + line ] +
     ( machine_current->timings.left_border - DISPLAY_BORDER_WIDTH_COLS * 4 );
 
   /* Idle bus if we're in the left border */
   if( tstates_through_line < machine_current->timings.left_border )
-    return 0xff;
+    return ULA_FLOATING_BUS_IDLE;
 
   /* Or the right border or retrace */
   if( tstates_through_line >= machine_current->timings.left_border +
                               machine_current->timings.horizontal_screen  )
-    return 0xff;
+    return ULA_FLOATING_BUS_IDLE;
 
   column = ( ( tstates_through_line -
 	       machine_current->timings.left_border ) / 8 ) * 2;
@@ -231,20 +261,36 @@ spectrum_unattached_port( void )
     /* Attribute bytes */
     case 5: column++;
     case 3:
-      return RAM[ memory_current_screen ][ display_attr_start[line] + column ];
+      return display_attr_start[line] + column;
 
     /* Screen data */
     case 4: column++;
     case 2:
-      return RAM[ memory_current_screen ][ display_line_start[line] + column ];
+      return display_line_start[line] + column;
 
     /* Idle bus */
     case 0: case 1: case 6: case 7:
-      return 0xff;
+      return ULA_FLOATING_BUS_IDLE;
 
   }
 
-  return 0;		/* Keep gcc happy */
+  return ULA_FLOATING_BUS_IDLE;	/* Keep gcc happy */
+}
+
+/* What happens if we read from an unattached port? */
+libspectrum_byte
+spectrum_unattached_port( void )
+{
+  libspectrum_word offset;
+
+  if( !ula_floating_bus && ula_select_floating_bus() ) return 0xff;
+
+  if( tstates >= ULA_CONTENTION_SIZE ) return 0xff;
+
+  offset = ula_floating_bus[ tstates ];
+  if( offset == ULA_FLOATING_BUS_IDLE ) return 0xff;
+
+  return RAM[ memory_current_screen ][ offset ];
 }
 
 libspectrum_byte
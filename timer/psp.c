@@ -17,6 +17,12 @@ timer_get_time_difference( timer_type *a, timer_type *b )
   return ( *a - *b ) / (float)sceRtcGetTickResolution();
 }
 
+libspectrum_dword
+timer_get_microseconds( void )
+{
+  return sceKernelGetSystemTimeLow();
+}
+
 void
 timer_add_time_difference( timer_type *a, long msec )
 {
@@ -187,20 +187,25 @@ timer_frame( libspectrum_dword last_tstates, int event GCC_UNUSED,
 		  settings_current.emulation_speed ) / 100.0;
   long tstates;
 
-  if( sound_enabled ) {
+  if( sound_enabled && !settings_current.turbo ) {
     timer_frame_callback_sound( last_tstates );
     return;
   }
 
-  /* If we're fastloading, just schedule another check in a frame's time
-     and do nothing else */
-  if( settings_current.fastload && tape_is_playing() ) {
+  /* If we're fastloading, running headless or in turbo mode, just
+     schedule another check in a frame's time and do nothing else */
+  if( settings_current.headless || settings_current.turbo ||
+      ( settings_current.fastload && tape_is_playing() ) ) {
 
     libspectrum_dword next_check_time =
       last_tstates + machine_current->timings.tstates_per_frame;
 
     if( event_add( next_check_time, timer_event ) ) return;
 
+    /* Don't try to catch up on the time spent here when we start
+       throttling again */
+    error = timer_get_real_time( &start_time ); if( error ) return;
+
   } else {
 
     while( 1 ) {
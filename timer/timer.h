@@ -37,6 +37,9 @@ int timer_estimate_speed( void );
 int timer_get_real_time( timer_type *real_time );
 float timer_get_time_difference( timer_type *a, timer_type *b );
 
+/* A quick clock for timing short stretches, which will wrap around */
+libspectrum_dword timer_get_microseconds( void );
+
 int timer_init(void);
 void timer_sleep_ms( int ms );
 int timer_end(void);
@@ -1,6 +1,7 @@
 #include <config.h>
 
 #include "display.h"
+#include "hostprofile.h"
 #include "machine.h"
 #include "settings.h"
 #include "ui/ui.h"
@@ -174,6 +175,14 @@ void uidisplay_frame_end()
 
     int width = pspFontGetTextWidth(&PspStockFont, fps_display);
     pspVideoPrint(&PspStockFont, SCR_WIDTH - width, 0, fps_display, PSP_COLOR_WHITE);
+
+#ifdef HOST_PROFILE
+    /* Where the time went, on the line below */
+    const char *summary = hostprofile_summary();
+    width = pspFontGetTextWidth(&PspStockFont, summary);
+    pspVideoFillRect(SCR_WIDTH - width, line_height, SCR_WIDTH, line_height * 2, PSP_COLOR_BLACK);
+    pspVideoPrint(&PspStockFont, SCR_WIDTH - width, line_height, summary, PSP_COLOR_YELLOW);
+#endif
   }
 
   /* Display any status indicators */
@@ -221,18 +230,9 @@ void uidisplay_putpixel(int x, int y, int colour)
 void uidisplay_plot8(int x, int y, libspectrum_byte data,
                      libspectrum_byte ink, libspectrum_byte paper)
 {
-  x <<= 3;
-  u8 *line_start = (u8*)Screen->Pixels +
-                    ((y << CANVAS_WIDTH_SHIFTBY) + x);
-
-  *line_start++ = ( data & 0x80 ) ? ink : paper;
-  *line_start++ = ( data & 0x40 ) ? ink : paper;
-  *line_start++ = ( data & 0x20 ) ? ink : paper;
-  *line_start++ = ( data & 0x10 ) ? ink : paper;
-  *line_start++ = ( data & 0x08 ) ? ink : paper;
-  *line_start++ = ( data & 0x04 ) ? ink : paper;
-  *line_start++ = ( data & 0x02 ) ? ink : paper;
-  *line_start++ = ( data & 0x01 ) ? ink : paper;
+  uidisplay_expand8((u8*)Screen->Pixels +
+                    ((y << CANVAS_WIDTH_SHIFTBY) + (x << 3)),
+                    data, ink, paper);
 }
 
 /* Print the 16 pixels in `data' using ink colour `ink' and paper
@@ -241,18 +241,9 @@ void uidisplay_plot16(int x, int y, libspectrum_word data,
                       libspectrum_byte ink, libspectrum_byte paper)
 {
   /* Forces a low-res render, discarding every other pixel */
-  x <<= 4;
-  u8 *line_start = (u8*)Screen->Pixels +
-                   ((y << CANVAS_WIDTH_SHIFTBY) + x);
-
-  *line_start++ = ( data & 0x8000 ) ? ink : paper;
-  *line_start++ = ( data & 0x2000 ) ? ink : paper;
-  *line_start++ = ( data & 0x0800 ) ? ink : paper;
-  *line_start++ = ( data & 0x0200 ) ? ink : paper;
-  *line_start++ = ( data & 0x0080 ) ? ink : paper;
-  *line_start++ = ( data & 0x0020 ) ? ink : paper;
-  *line_start++ = ( data & 0x0008 ) ? ink : paper;
-  *line_start++ = ( data & 0x0002 ) ? ink : paper;
+  uidisplay_expand8((u8*)Screen->Pixels +
+                    ((y << CANVAS_WIDTH_SHIFTBY) + (x << 4)),
+                    uidisplay_hires_to_lores(data), ink, paper);
 }
 
 void uidisplay_area(int x, int y, int w, int h)
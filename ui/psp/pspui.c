@@ -7,7 +7,9 @@
 #include "display.h"
 #include "fuse.h"
 #include "menu.h"
+#include "movie.h"
 #include "psg.h"
+#include "rewind.h"
 #include "rzx.h"
 #include "screenshot.h"
 #include "settings.h"
@@ -59,6 +61,12 @@ PSP_MAIN_THREAD_ATTR(PSP_THREAD_ATTR_USER);
 #define OPTION_SHOW_OSI      0x09
 #define OPTION_SHOW_PC       0x0A
 #define OPTION_SHOW_BORDER   0x0B
+#define OPTION_REWIND_SIZE   0x0C
+#define OPTION_DRAWING       0x0D
+
+#define DRAWING_DIRECT   0
+#define DRAWING_BATCHED  1
+#define DRAWING_THREADED 2
 
 #define SYSTEM_SCRNSHOT     0x11
 #define SYSTEM_RESET        0x12
@@ -72,11 +80,14 @@ PSP_MAIN_THREAD_ATTR(PSP_THREAD_ATTR_USER);
 #define SYSTEM_TAPE_BROWSER 0x1A
 #define SYSTEM_TAPE_PLAY    0x1B
 #define SYSTEM_TAPE_REWIND  0x1C
+#define SYSTEM_MOVIE        0x1D
 
 #define SPC_MENU     1
 #define SPC_KYBD     2
 #define SPC_2X_SPD   3
 #define SPC_HALF_SPD 4
+#define SPC_TURBO    5
+#define SPC_REWIND   6
 
 #define CURRENT_GAME (psp_current_game)
 #define GAME_LOADED (psp_current_game[0] != '\0')
@@ -133,6 +144,8 @@ static void psp_display_control_tab();
 static void psp_display_system_tab();
 
 static void psp_load_options();
+static int  psp_get_drawing();
+static void psp_set_drawing(int mode);
 static int  psp_save_options();
 
 static int  psp_load_game(const char *path);
@@ -251,6 +264,17 @@ PL_MENU_OPTIONS_BEGIN(MachineTypes)
   PL_MENU_OPTION("Scorpion ZS 256", LIBSPECTRUM_MACHINE_SCORP)
   PL_MENU_OPTION("Spectrum SE",     LIBSPECTRUM_MACHINE_SE)
 PL_MENU_OPTIONS_END
+PL_MENU_OPTIONS_BEGIN(DrawingOptions)
+  PL_MENU_OPTION("As the emulation runs", DRAWING_DIRECT)
+  PL_MENU_OPTION("At the end of each frame", DRAWING_BATCHED)
+  PL_MENU_OPTION("At the end of each frame, on a separate thread", DRAWING_THREADED)
+PL_MENU_OPTIONS_END
+PL_MENU_OPTIONS_BEGIN(RewindSizeOptions)
+  PL_MENU_OPTION("Disabled", 0)
+  PL_MENU_OPTION("1 MB", 1)
+  PL_MENU_OPTION("2 MB", 2)
+  PL_MENU_OPTION("4 MB", 4)
+PL_MENU_OPTIONS_END
 PL_MENU_OPTIONS_BEGIN(AutoloadSlots)
   PL_MENU_OPTION("Disabled", -1)
   PL_MENU_OPTION("1", 0)
@@ -270,6 +294,8 @@ PL_MENU_OPTIONS_BEGIN(MappableButtons)
   /* Special */
   PL_MENU_OPTION("Special: Open Menu",     (SPC|SPC_MENU))
   PL_MENU_OPTION("Special: Show keyboard", (SPC|SPC_KYBD))
+  PL_MENU_OPTION("Special: Fast forward",  (SPC|SPC_TURBO))
+  PL_MENU_OPTION("Special: Rewind",        (SPC|SPC_REWIND))
 /*
   PL_MENU_OPTION("Special: Run at 50% speed", (SPC|SPC_HALF_SPD))
   PL_MENU_OPTION("Special: Run at 200% speed", (SPC|SPC_2X_SPD))
@@ -377,6 +403,8 @@ PL_MENU_ITEMS_BEGIN(SystemMenuDef)
                "\026\001\020 Reset system")
   PL_MENU_ITEM("Save screenshot",SYSTEM_SCRNSHOT,NULL,
                "\026\001\020 Save screenshot")
+  PL_MENU_ITEM("Record movie",SYSTEM_MOVIE,NULL,
+               "\026\001\020 Start/stop recording screen and sound to a movie")
 PL_MENU_ITEMS_END
 PL_MENU_ITEMS_BEGIN(OptionMenuDef)
   PL_MENU_HEADER("Video")
@@ -384,12 +412,16 @@ PL_MENU_ITEMS_BEGIN(OptionMenuDef)
                "\026\250\020 Change screen size")
   PL_MENU_ITEM("Border",OPTION_SHOW_BORDER,ToggleOptions,
                "\026\250\020 Show/hide border surrounding the main display area")
+  PL_MENU_ITEM("Screen drawing",OPTION_DRAWING,DrawingOptions,
+               "\026\250\020 When to draw the screen; a separate thread lets emulation continue while drawing")
   PL_MENU_HEADER("Input")
   PL_MENU_ITEM("Virtual keyboard mode",OPTION_TOGGLE_VK,VkModeOptions,
                "\026\250\020 Select virtual keyboard mode")
   PL_MENU_HEADER("Enhancements")
   PL_MENU_ITEM("Autoload slot",OPTION_AUTOLOAD,AutoloadSlots,
                "\026\250\020 Select save state to be loaded automatically")
+  PL_MENU_ITEM("Rewind buffer",OPTION_REWIND_SIZE,RewindSizeOptions,
+               "\026\250\020 Memory kept for stepping back with the \"Special: Rewind\" button")
   PL_MENU_HEADER("Performance")
   PL_MENU_ITEM("PSP clock frequency",OPTION_CLOCK_FREQ,PspClockFreqOptions,
                "\026\250\020 Larger values: faster emulation, faster battery depletion (default: 222MHz)")
@@ -478,6 +510,8 @@ pl_vk_layout vk_spectrum;
 u8 show_kybd_held;
 u8 run_full_spd_held;
 u8 run_half_spd_held;
+u8 run_turbo_held;
+u8 run_rewind_held;
 u8 keyboard_visible;
 
 static u8 psp_exit_menu;
@@ -623,6 +657,8 @@ int ui_init(int *argc, char ***argv)
   keyboard_visible = 0;
   run_full_spd_held = 0;
   run_half_spd_held = 0;
+  run_turbo_held = 0;
+  run_rewind_held = 0;
   clear_screen = 1;
   psp_menu_active = 1;
 
@@ -642,6 +678,9 @@ static void psp_display_menu()
   fuse_emulation_pause();
   psp_sound_pause();
 
+  /* The drawing thread mustn't touch the screen while the menu does */
+  display_wait();
+
   /* For purposes of the menu, the screen excludes the border */
   Screen->Viewport.X = DISPLAY_BORDER_WIDTH / 2;
   Screen->Viewport.Y = DISPLAY_BORDER_HEIGHT;
@@ -684,12 +723,16 @@ static void psp_display_menu()
       pl_menu_select_option_by_value(item, (void*)(int)psp_options.animate_menu);
       item = pl_menu_find_item_by_id(&OptionUiMenu.Menu, OPTION_AUTOLOAD);
       pl_menu_select_option_by_value(item, (void*)(int)psp_options.autoload_slot);
+      item = pl_menu_find_item_by_id(&OptionUiMenu.Menu, OPTION_REWIND_SIZE);
+      pl_menu_select_option_by_value(item, (void*)(int)settings_current.rewind_size);
       item = pl_menu_find_item_by_id(&OptionUiMenu.Menu, OPTION_TOGGLE_VK);
       pl_menu_select_option_by_value(item, (void*)(int)psp_options.toggle_vk);
       if ((item = pl_menu_find_item_by_id(&OptionUiMenu.Menu, OPTION_FRAME_LIMITER)))
         pl_menu_select_option_by_value(item, (void*)(int)psp_options.limit_frames);
       item = pl_menu_find_item_by_id(&OptionUiMenu.Menu, OPTION_SHOW_BORDER);
       pl_menu_select_option_by_value(item, (void*)(int)psp_options.show_border);
+      item = pl_menu_find_item_by_id(&OptionUiMenu.Menu, OPTION_DRAWING);
+      pl_menu_select_option_by_value(item, (void*)psp_get_drawing());
 
       pspUiOpenMenu(&OptionUiMenu, NULL);
       break;
@@ -717,6 +760,10 @@ static void psp_display_menu()
     keyboard_visible = 0;
     run_full_spd_held = 0;
     run_half_spd_held = 0;
+    run_turbo_held = 0;
+    settings_current.turbo = 0;
+    run_rewind_held = 0;
+    rewind_hold(0);
     clear_screen = 1;
 
     keyboard_release_all();
@@ -834,6 +881,18 @@ int ui_event( void )
 
           run_full_spd_held = on;
           break;
+        case SPC_TURBO:
+          if (run_turbo_held != on)
+            settings_current.turbo = on;
+
+          run_turbo_held = on;
+          break;
+        case SPC_REWIND:
+          if (run_rewind_held != on)
+            rewind_hold(on);
+
+          run_rewind_held = on;
+          break;
         }
       }
     }
@@ -941,6 +1000,9 @@ static void psp_display_system_tab()
   pl_menu_select_option_by_value(item, (void*)(settings_current.sound_load));
   item = pl_menu_find_item_by_id(&SystemUiMenu.Menu, SYSTEM_TAPE_TRAPS);
   pl_menu_select_option_by_value(item, (void*)(settings_current.tape_traps));
+  item = pl_menu_find_item_by_id(&SystemUiMenu.Menu, SYSTEM_MOVIE);
+  pl_menu_set_item_caption(item, (movie_recording)
+                           ? "Stop recording movie" : "Record movie");
 
   /* Initialize tape browser information */
   item = pl_menu_find_item_by_id(&SystemUiMenu.Menu, SYSTEM_TAPE_BROWSER);
@@ -1124,7 +1186,9 @@ static void psp_load_options()
   psp_options.show_fps = pl_ini_get_int(&file, "Video", "Show FPS", 0);
   psp_options.show_osi = pl_ini_get_int(&file, "Video", "Show Peripheral Status", 0);
   psp_options.show_pc = pl_ini_get_int(&file, "Options", "Show PC", 0);
+  settings_current.rewind_size = pl_ini_get_int(&file, "Options", "Rewind Size", 0);
   psp_options.show_border = pl_ini_get_int(&file, "Video", "Show Border", 1);
+  psp_set_drawing(pl_ini_get_int(&file, "Video", "Screen Drawing", DRAWING_DIRECT));
   psp_options.enable_bw = pl_ini_get_int(&file, "Video", "Enable B&W", 0);
   psp_options.control_mode = pl_ini_get_int(&file, "Menu", "Control Mode", 0);
   psp_options.animate_menu = pl_ini_get_int(&file, "Menu", "Animate", 1);
@@ -1145,6 +1209,20 @@ static void psp_load_options()
   pl_ini_destroy(&file);
 }
 
+/* The display code picks up a change of drawing mode between frames */
+static int psp_get_drawing()
+{
+  if (settings_current.display_thread) return DRAWING_THREADED;
+  if (settings_current.display_batch) return DRAWING_BATCHED;
+  return DRAWING_DIRECT;
+}
+
+static void psp_set_drawing(int mode)
+{
+  settings_current.display_batch = (mode == DRAWING_BATCHED);
+  settings_current.display_thread = (mode == DRAWING_THREADED);
+}
+
 static int psp_save_options()
 {
   pl_file_path path;
@@ -1159,8 +1237,10 @@ static int psp_save_options()
   pl_ini_set_int(&file, "Video", "Show FPS", psp_options.show_fps);
   pl_ini_set_int(&file, "Video", "Show Peripheral Status", psp_options.show_osi);
   pl_ini_set_int(&file, "Video", "Show Border", psp_options.show_border);
+  pl_ini_set_int(&file, "Video", "Screen Drawing", psp_get_drawing());
   pl_ini_set_int(&file, "Video", "Enable B&W", psp_options.enable_bw);
   pl_ini_set_int(&file, "Options", "Show PC", psp_options.show_pc);
+  pl_ini_set_int(&file, "Options", "Rewind Size", settings_current.rewind_size);
   pl_ini_set_int(&file, "Menu", "Control Mode", psp_options.control_mode);
   pl_ini_set_int(&file, "Menu", "Animate", psp_options.animate_menu);
   pl_ini_set_int(&file, "Input", "VK Mode", psp_options.toggle_vk);
@@ -1499,6 +1579,27 @@ static const char* OnSplashGetStatusBarText(const struct PspUiSplash *splash)
   return "\026\255\020/\026\256\020 Switch tabs";
 }
 
+/* Start recording a movie to the first free name in the screenshot
+   directory */
+static int psp_start_movie()
+{
+  pl_file_path path;
+  int i = 0;
+
+  if (!pl_file_exists(psp_screenshot_path))
+    if (!pl_file_mkdir_recursive(psp_screenshot_path))
+      return 0;
+
+  do
+  {
+    snprintf(path, sizeof(path) - 1, "%s%s-%02i.fmv", psp_screenshot_path,
+             (GAME_LOADED) ? pl_file_get_filename(psp_current_game) : "BASIC",
+             i);
+  } while (pl_file_exists(path) && ++i < 100);
+
+  return !movie_start_recording(path);
+}
+
 static int OnMenuOk(const void *uimenu, const void* sel_item)
 {
   switch (((const pl_menu_item*)sel_item)->id)
@@ -1526,6 +1627,22 @@ static int OnMenuOk(const void *uimenu, const void* sel_item)
     else
       pspUiAlert("Screenshot saved successfully");
     break;
+  case SYSTEM_MOVIE:
+    if (movie_recording)
+    {
+      if (movie_stop_recording())
+        pspUiAlert("ERROR: Movie not saved");
+      else
+        pspUiAlert("Movie saved successfully");
+    }
+    else if (!psp_start_movie())
+      pspUiAlert("ERROR: Could not start recording");
+    else
+      pspUiAlert("Recording started");
+
+    pl_menu_set_item_caption((pl_menu_item*)sel_item, (movie_recording)
+                             ? "Stop recording movie" : "Record movie");
+    break;
   }
 
   return 0;
@@ -1604,6 +1721,9 @@ static int OnMenuItemChanged(const struct PspUiMenu *uimenu,
     case OPTION_SHOW_BORDER:
       psp_options.show_border = (int)option->value;
       break;
+    case OPTION_DRAWING:
+      psp_set_drawing((int)option->value);
+      break;
     case OPTION_TOGGLE_VK:
       psp_options.toggle_vk = (int)option->value;
       break;
@@ -1619,6 +1739,11 @@ static int OnMenuItemChanged(const struct PspUiMenu *uimenu,
     case OPTION_AUTOLOAD:
       psp_options.autoload_slot = (int)option->value;
       break;
+    case OPTION_REWIND_SIZE:
+      settings_current.rewind_size = (int)option->value;
+      /* Give back the memory straight away when disabled */
+      if (!settings_current.rewind_size) rewind_reset();
+      break;
     case SYSTEM_MONITOR:
       psp_options.enable_bw = (int)option->value;
       psp_uidisplay_reinit();
@@ -1870,10 +1995,6 @@ int ui_menu_item_set_active(const char *path, int active)
 }
 
 #ifdef USE_LIBPNG
-void menu_file_movies_recordmovieaspng( int action )
-{
-}
-
 void menu_file_savescreenaspng( int action )
 {
 }
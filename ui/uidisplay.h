@@ -55,4 +55,62 @@ void uidisplay_plot8( int x, int y, libspectrum_byte data, libspectrum_byte ink,
 void uidisplay_plot16( int x, int y, libspectrum_word data, libspectrum_byte ink,
                        libspectrum_byte paper);
 
+/* Shared pixel expansion: write the 8 pixels in `data', most
+   significant bit first, in `ink' or `paper' without any branches */
+
+typedef union uidisplay_pixel_masks {
+  libspectrum_byte byte[8];
+  libspectrum_dword word[2];
+} uidisplay_pixel_masks;
+
+extern uidisplay_pixel_masks uidisplay_masks[ 256 ];
+extern libspectrum_byte uidisplay_hires_bits[ 256 ];
+
+void uidisplay_expand_init( void );
+
+static inline void
+uidisplay_expand8( libspectrum_byte *out, libspectrum_byte data,
+                   libspectrum_byte ink, libspectrum_byte paper )
+{
+  libspectrum_dword paper4 = paper * 0x01010101U,
+                    diff4 = ( ink ^ paper ) * 0x01010101U;
+  libspectrum_dword *out4 = (libspectrum_dword*)out;
+
+  out4[0] = paper4 ^ ( diff4 & uidisplay_masks[ data ].word[0] );
+  out4[1] = paper4 ^ ( diff4 & uidisplay_masks[ data ].word[1] );
+}
+
+static inline void
+uidisplay_expand16( libspectrum_word *out, libspectrum_byte data,
+                    libspectrum_word ink, libspectrum_word paper )
+{
+  const libspectrum_byte *mask = uidisplay_masks[ data ].byte;
+  libspectrum_word diff = ink ^ paper;
+  int i;
+
+  for( i = 0; i < 8; i++ )
+    out[i] = paper ^ ( diff & -(libspectrum_word)( mask[i] & 1 ) );
+}
+
+static inline void
+uidisplay_expand32( libspectrum_dword *out, libspectrum_byte data,
+                    libspectrum_dword ink, libspectrum_dword paper )
+{
+  const libspectrum_byte *mask = uidisplay_masks[ data ].byte;
+  libspectrum_dword diff = ink ^ paper;
+  int i;
+
+  for( i = 0; i < 8; i++ )
+    out[i] = paper ^ ( diff & -(libspectrum_dword)( mask[i] & 1 ) );
+}
+
+/* The even pixels of a line of hires data, for targets which show
+   hires modes at lores width */
+static inline libspectrum_byte
+uidisplay_hires_to_lores( libspectrum_word data )
+{
+  return ( uidisplay_hires_bits[ data >> 8 ] << 4 ) |
+           uidisplay_hires_bits[ data & 0xff ];
+}
+
 #endif			/* #ifndef FUSE_UIDISPLAY_H */
@@ -31,6 +31,33 @@
 #include "machine.h"
 #include "ui/uidisplay.h"
 
+/* For each possible byte of display data, a mask with all bits set in
+   each pixel which should be ink. Accessed as bytes for the 16- and
+   32-bit targets and as two words for the 8-bit one, which then
+   writes four pixels per store */
+uidisplay_pixel_masks uidisplay_masks[ 256 ];
+
+/* Every other bit of a byte (7, 5, 3 and 1) packed into a nibble, used
+   to turn a line of hires data into lores */
+libspectrum_byte uidisplay_hires_bits[ 256 ];
+
+void
+uidisplay_expand_init( void )
+{
+  int data, i;
+
+  for( data = 0; data < 256; data++ ) {
+
+    for( i = 0; i < 8; i++ )
+      uidisplay_masks[ data ].byte[i] = ( data & ( 0x80 >> i ) ) ? 0xff : 0;
+
+    uidisplay_hires_bits[ data ] = ( ( data & 0x80 ) >> 4 ) |
+                                   ( ( data & 0x20 ) >> 3 ) |
+                                   ( ( data & 0x08 ) >> 2 ) |
+                                   ( ( data & 0x02 ) >> 1 );
+  }
+}
+
 void uidisplay_spectrum_screen( const libspectrum_byte *screen, int border )
 {
   int x,y;
@@ -25,6 +25,8 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <libspectrum.h>
 
 #include "compat.h"
@@ -36,12 +38,36 @@
 #include "sound.h"
 #include "spectrum.h"
 #include "tape.h"
+#include "ui/ui.h"
 #include "ula.h"
 
 static libspectrum_byte last_byte;
 
-libspectrum_byte ula_contention[ ULA_CONTENTION_SIZE ];
-libspectrum_byte ula_contention_no_mreq[ ULA_CONTENTION_SIZE ];
+const libspectrum_byte *ula_contention;
+const libspectrum_byte *ula_contention_no_mreq;
+const libspectrum_word *ula_floating_bus;
+
+/* The contention and floating bus tables depend only on the machine's
+   timings, so each distinct table is built once and then kept for the
+   rest of the run; selecting a machine just picks the right ones. The
+   tables are never changed once built, so can be shared freely */
+typedef struct ula_table_key {
+
+  spectrum_contention_delay_function delay; /* NULL for the floating bus */
+
+  libspectrum_dword tstates_per_frame;
+  libspectrum_dword first_line;	/* line_times[0] */
+  libspectrum_word tstates_per_line;
+  libspectrum_word left_border, horizontal_screen;
+
+} ula_table_key;
+
+typedef struct ula_table {
+  ula_table_key key;
+  void *data;
+} ula_table;
+
+static GSList *ula_tables = NULL;
 
 /* What to return if no other input pressed; depends on the last byte
    output to the ULA; see CSS FAQ | Technical Information | Port #FE
@@ -61,6 +87,126 @@ static module_info_t ula_module_info = {
 
 };
 
+static void
+ula_table_key_set( ula_table_key *key,
+		   spectrum_contention_delay_function delay )
+{
+  key->delay = delay;
+  key->tstates_per_frame = machine_current->timings.tstates_per_frame;
+  key->first_line = machine_current->line_times[0];
+  key->tstates_per_line = machine_current->timings.tstates_per_line;
+  key->left_border = machine_current->timings.left_border;
+  key->horizontal_screen = machine_current->timings.horizontal_screen;
+}
+
+static gint
+ula_table_compare( gconstpointer a, gconstpointer b )
+{
+  const ula_table_key *key1 = &( (const ula_table*)a )->key,
+                      *key2 = b;
+
+  return !( key1->delay == key2->delay &&
+	    key1->tstates_per_frame == key2->tstates_per_frame &&
+	    key1->first_line == key2->first_line &&
+	    key1->tstates_per_line == key2->tstates_per_line &&
+	    key1->left_border == key2->left_border &&
+	    key1->horizontal_screen == key2->horizontal_screen );
+}
+
+/* Find the table with the given key, or add a new empty one of 'size'
+   bytes */
+static ula_table*
+ula_table_get( ula_table_key *key, size_t size, int *is_new )
+{
+  GSList *found;
+  ula_table *table;
+
+  found = g_slist_find_custom( ula_tables, key, ula_table_compare );
+  if( found ) { *is_new = 0; return found->data; }
+
+  table = malloc( sizeof( *table ) );
+  if( !table ) {
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  table->data = calloc( 1, size );
+  if( !table->data ) {
+    free( table );
+    ui_error( UI_ERROR_ERROR, "out of memory at %s:%d", __FILE__, __LINE__ );
+    return NULL;
+  }
+
+  table->key = *key;
+  ula_tables = g_slist_prepend( ula_tables, table );
+
+  *is_new = 1;
+  return table;
+}
+
+static const libspectrum_byte*
+ula_contention_table( spectrum_contention_delay_function delay )
+{
+  ula_table_key key;
+  ula_table *table;
+  libspectrum_byte *data;
+  libspectrum_dword i;
+  int is_new;
+
+  ula_table_key_set( &key, delay );
+
+  table = ula_table_get( &key, ULA_CONTENTION_SIZE, &is_new );
+  if( !table ) return NULL;
+
+  data = table->data;
+  if( is_new )
+    for( i = 0; i < key.tstates_per_frame; i++ ) data[i] = delay( i );
+
+  return data;
+}
+
+/* Select the contention tables for the current machine, building them
+   if necessary. Must be called after the machine's timings are set */
+int
+ula_select_contention( void )
+{
+  ula_contention =
+    ula_contention_table( machine_current->ram.contend_delay );
+  ula_contention_no_mreq =
+    ula_contention_table( machine_current->ram.contend_delay_no_mreq );
+
+  /* Only built if something actually reads the floating bus */
+  ula_floating_bus = NULL;
+
+  return !ula_contention || !ula_contention_no_mreq;
+}
+
+/* Select the floating bus table for the current machine */
+int
+ula_select_floating_bus( void )
+{
+  ula_table_key key;
+  ula_table *table;
+  libspectrum_word *data;
+  libspectrum_dword i;
+  int is_new;
+
+  ula_table_key_set( &key, NULL );
+
+  table = ula_table_get( &key, ULA_CONTENTION_SIZE * sizeof( *data ),
+			 &is_new );
+  if( !table ) return 1;
+
+  data = table->data;
+  if( is_new )
+    for( i = 0; i < ULA_CONTENTION_SIZE; i++ )
+      data[i] = spectrum_floating_bus_offset( i );
+
+  ula_floating_bus = data;
+
+  return 0;
+}
+
 int
 ula_init( void )
 {
@@ -71,6 +217,26 @@ ula_init( void )
   return 0;
 }
 
+void
+ula_state_save( ula_state *state )
+{
+  state->last_byte = last_byte;
+  state->default_value = ula_default_value;
+  state->contention = ula_contention;
+  state->contention_no_mreq = ula_contention_no_mreq;
+  state->floating_bus = ula_floating_bus;
+}
+
+void
+ula_state_load( const ula_state *state )
+{
+  last_byte = state->last_byte;
+  ula_default_value = state->default_value;
+  ula_contention = state->contention;
+  ula_contention_no_mreq = state->contention_no_mreq;
+  ula_floating_bus = state->floating_bus;
+}
+
 libspectrum_byte
 ula_read( libspectrum_word port, int *attached )
 {
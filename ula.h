@@ -29,13 +29,32 @@
 #define ULA_CONTENTION_SIZE 80000
 
 /* How much contention do we get at every tstate when MREQ is active? */
-extern libspectrum_byte ula_contention[ ULA_CONTENTION_SIZE ];
+extern const libspectrum_byte *ula_contention;
 
 /* And how much when it is inactive */
-extern libspectrum_byte ula_contention_no_mreq[ ULA_CONTENTION_SIZE ];
+extern const libspectrum_byte *ula_contention_no_mreq;
+
+/* Which byte of the current screen is on the floating bus at every
+   tstate (or ULA_FLOATING_BUS_IDLE if none); NULL until first needed */
+#define ULA_FLOATING_BUS_IDLE 0xffff
+extern const libspectrum_word *ula_floating_bus;
 
 int ula_init( void );
 
+int ula_select_contention( void );
+int ula_select_floating_bus( void );
+
+/* The ULA state which rewind keeps with each entry; the tables pointed
+   to are never freed while a machine is in use */
+typedef struct ula_state {
+  libspectrum_byte last_byte, default_value;
+  const libspectrum_byte *contention, *contention_no_mreq;
+  const libspectrum_word *floating_bus;
+} ula_state;
+
+void ula_state_save( ula_state *state );
+void ula_state_load( const ula_state *state );
+
 libspectrum_byte ula_read( libspectrum_word port, int *attached );
 void ula_write( libspectrum_word port, libspectrum_byte b );
 
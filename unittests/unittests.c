@@ -25,12 +25,23 @@
 
 #include <config.h>
 
+#include <stdio.h>
+#include <string.h>
+
 #include <libspectrum.h>
 
+#include "debugger/debugger_internals.h"
+#include "display.h"
 #include "fuse.h"
 #include "machine.h"
+#include "memory.h"
 #include "mempool.h"
+#include "periph.h"
 #include "settings.h"
+#include "sound/dsp.h"
+#include "spectrum.h"
+#include "timer/timer.h"
+#include "ui/uidisplay.h"
 #include "ula.h"
 
 static int
@@ -248,6 +259,550 @@ mempool_test( void )
   return 0;
 }
 
+/* The table-driven pixel expansion must match the obvious version */
+static int
+pixel_expansion_test( void )
+{
+  union { libspectrum_byte b[8]; libspectrum_dword d[2]; } out8;
+  libspectrum_word out16[8];
+  libspectrum_dword out32[8], expected;
+  int data, i;
+
+  uidisplay_expand_init();
+
+  for( data = 0; data < 256; data++ ) {
+
+    uidisplay_expand8( out8.b, data, 0x0d, 0x32 );
+    uidisplay_expand16( out16, data, 0xf81f, 0x07e0 );
+    uidisplay_expand32( out32, data, 0x00ff8000, 0x80000001 );
+
+    for( i = 0; i < 8; i++ ) {
+      expected = data & ( 0x80 >> i );
+      TEST_ASSERT( out8.b[i] == ( expected ? 0x0d : 0x32 ) );
+      TEST_ASSERT( out16[i] == ( expected ? 0xf81f : 0x07e0 ) );
+      TEST_ASSERT( out32[i] == ( expected ? 0x00ff8000 : 0x80000001 ) );
+    }
+
+    /* Only the even pixels of hires data remain */
+    TEST_ASSERT( uidisplay_hires_to_lores( data << 8 | data ) ==
+                 ( uidisplay_hires_bits[ data ] * 0x11 ) );
+    TEST_ASSERT( uidisplay_hires_to_lores( 0xaaaa & ( data * 0x101 ) ) ==
+                 uidisplay_hires_to_lores( data * 0x101 ) );
+  }
+
+  TEST_ASSERT( uidisplay_hires_to_lores( 0x8002 ) == 0x81 );
+
+  return 0;
+}
+
+#define DSP_TEST_LENGTH 1763	/* A frame at 88.2kHz; not a multiple of 4 */
+#define DSP_BENCH_FRAMES 1000
+
+/* Every sound kernel must give exactly the same results as the C one;
+   also report how long each takes to produce a frame of stereo */
+static int
+sound_dsp_test( void )
+{
+  static libspectrum_signed_dword left[ DSP_TEST_LENGTH ],
+    right[ DSP_TEST_LENGTH ];
+  static libspectrum_signed_word expected[ 3 ][ 2 * DSP_TEST_LENGTH ],
+    actual[ 2 * DSP_TEST_LENGTH ];
+  const sound_dsp_t *dsp;
+  libspectrum_signed_dword levels[2];
+  libspectrum_dword seed = 1;
+  timer_type start, end;
+  size_t i, j;
+  int k;
+
+  sound_dsp_init();
+
+  /* Impulses which sometimes push the output past 16 bits */
+  for( i = 0; i < DSP_TEST_LENGTH; i++ ) {
+    seed = seed * 1103515245 + 12345;
+    left[i]  = (libspectrum_signed_dword)( seed >> 8 ) % ( 1 << 22 ) -
+	       ( 1 << 21 ) + ( i < DSP_TEST_LENGTH / 2 ? 1 << 20 : -( 1 << 20 ) );
+    right[i] = (libspectrum_signed_dword)( seed >> 4 ) % ( 1 << 24 ) -
+	       ( 1 << 23 ) - ( i < DSP_TEST_LENGTH / 2 ? 1 << 20 : -( 1 << 20 ) );
+  }
+
+  for( j = 0; ( dsp = sound_dsp_get( j ) ); j++ ) {
+
+    for( k = 0; k < 3; k++ ) {
+      memset( actual, 0, sizeof( actual ) );
+      levels[0] = 1000; levels[1] = -1000;
+      if( k < 2 )
+	dsp->integrate( actual, left, DSP_TEST_LENGTH, levels, 14, k + 1 );
+      else
+	dsp->integrate_stereo( actual, left, right, DSP_TEST_LENGTH, levels,
+			       14 );
+
+      if( j == 0 )
+	memcpy( expected[k], actual, sizeof( actual ) );
+      else
+	TEST_ASSERT( !memcmp( expected[k], actual, sizeof( actual ) ) );
+    }
+
+    timer_get_real_time( &start );
+    for( k = 0; k < DSP_BENCH_FRAMES; k++ )
+      dsp->integrate_stereo( actual, left, right, DSP_TEST_LENGTH, levels,
+			     14 );
+    timer_get_real_time( &end );
+
+    printf( "sound_dsp %s: %.2f us per frame\n", dsp->name,
+	    timer_get_time_difference( &end, &start ) * 1e6 /
+	    DSP_BENCH_FRAMES );
+  }
+
+  return 0;
+}
+
+#define DISPLAY_TEST_FRAMES 300
+
+static libspectrum_dword display_test_seed;
+
+static libspectrum_dword
+display_test_random( void )
+{
+  display_test_seed = display_test_seed * 1103515245 + 12345;
+  return display_test_seed >> 8;
+}
+
+/* Write to a screen page as writebyte() would. Nothing ever flashes, so
+   every mode sees the same flash phase */
+static void
+display_test_write( int page, libspectrum_word offset, libspectrum_byte b )
+{
+  if( offset >= 0x1800 ) b &= 0x7f;
+  if( page == memory_current_screen && RAM[ page ][ offset ] != b )
+    display_dirty( offset, b );
+  RAM[ page ][ offset ] = b;
+}
+
+/* Run a series of frames with a random mixture of screen writes, border
+   changes, switches of screen page and writes to the other page, and
+   checksum what was drawn after each one */
+static void
+display_test_run( libspectrum_dword *checksums )
+{
+  libspectrum_dword frame_length =
+    machine_current->timings.tstates_per_frame;
+  libspectrum_dword when, checksum, first_line;
+  int frame, count, i, x, y, line;
+
+  display_test_seed = 1;
+  first_line = machine_current->line_times[ DISPLAY_BORDER_HEIGHT ];
+
+  memory_current_screen = 5;
+  for( i = 0; i < 0x1b00; i++ ) {
+    RAM[5][i] = display_test_random() & ( i >= 0x1800 ? 0x7f : 0xff );
+    RAM[7][i] = display_test_random() & ( i >= 0x1800 ? 0x7f : 0xff );
+  }
+  tstates = 0;
+  display_set_lores_border( 0 );
+  display_refresh_all();
+
+  for( frame = 0; frame < DISPLAY_TEST_FRAMES; frame++ ) {
+
+    if( frame % 50 == 17 ) display_refresh_all();
+
+    count = display_test_random() % 400;
+    for( i = 0, when = 0; i < count; i++ ) {
+
+      when += display_test_random() % 350;
+      if( when >= frame_length ) break;
+      tstates = when;
+
+      switch( display_test_random() % 40 ) {
+
+      case 0:
+	display_set_lores_border( display_test_random() % 8 );
+	break;
+
+      case 1:
+	if( frame % 3 ) break;
+	display_update_critical( 0, 0 );
+	display_refresh_main_screen();
+	memory_current_screen = memory_current_screen == 5 ? 7 : 5;
+	break;
+
+      case 2: case 3: case 4: case 5:
+	/* Multicolour: change an attribute on the line being drawn */
+	line = ( (int)when - (int)first_line ) /
+	       (int)machine_current->timings.tstates_per_line;
+	if( line < 0 || line >= DISPLAY_HEIGHT ) break;
+	display_test_write( memory_current_screen,
+			    0x1800 + 32 * ( line / 8 ) +
+			    display_test_random() % 32,
+			    display_test_random() );
+	break;
+
+      case 6:
+	display_test_write( memory_current_screen == 5 ? 7 : 5,
+			    display_test_random() % 0x1b00,
+			    display_test_random() );
+	break;
+
+      default:
+	display_test_write( memory_current_screen,
+			    display_test_random() % 0x1b00,
+			    display_test_random() );
+	break;
+
+      }
+    }
+
+    tstates = 0;
+    display_frame();
+    display_wait();
+
+    checksum = 5381;
+    for( y = 0; y < DISPLAY_SCREEN_HEIGHT; y++ )
+      for( x = 0; x < DISPLAY_SCREEN_WIDTH_COLS * 8; x++ )
+	checksum = checksum * 33 + display_getpixel( x, y );
+    checksums[ frame ] = checksum;
+  }
+}
+
+/* Drawing each frame from the log of screen writes, whether directly
+   or on the drawing thread, must give the same picture as drawing as
+   the writes happen */
+static int
+display_modes_test( void )
+{
+  static libspectrum_dword expected[ DISPLAY_TEST_FRAMES ],
+    actual[ DISPLAY_TEST_FRAMES ];
+  static libspectrum_byte saved_screens[2][ 0x4000 ];
+  int saved_batch = settings_current.display_batch,
+    saved_thread = settings_current.display_thread,
+    saved_screen = memory_current_screen,
+    saved_border = display_lores_border;
+  libspectrum_dword saved_tstates = tstates;
+  int mode, r = 0;
+
+  /* Only the 48K's timings and screen layout are assumed */
+  if( machine_current->timex ) return 0;
+
+  memcpy( saved_screens[0], RAM[5], 0x4000 );
+  memcpy( saved_screens[1], RAM[7], 0x4000 );
+
+  for( mode = 0; mode < 3 && !r; mode++ ) {
+
+    /* The new mode is picked up at the end of a frame */
+    settings_current.display_batch = mode == 1;
+    settings_current.display_thread = mode == 2;
+    display_frame();
+    display_wait();
+
+    display_test_run( mode ? actual : expected );
+
+    if( mode && memcmp( expected, actual, sizeof( actual ) ) ) {
+      printf( "Test assertion failed at %s:%d: drawing mode %d differs\n",
+	      __FILE__, __LINE__, mode );
+      r = 1;
+    }
+  }
+
+  settings_current.display_batch = saved_batch;
+  settings_current.display_thread = saved_thread;
+  memory_current_screen = saved_screen;
+  memcpy( RAM[5], saved_screens[0], 0x4000 );
+  memcpy( RAM[7], saved_screens[1], 0x4000 );
+  display_frame();
+  display_wait();
+  tstates = saved_tstates;
+  display_set_lores_border( saved_border );
+  display_refresh_all();
+
+  return r;
+}
+
+#define EXPRESSION_TEST_COUNT 20000
+
+static const int expression_test_binaryops[] = {
+  '+', '-', '*', '/', '&', '^', '|', '<', '>',
+  DEBUGGER_TOKEN_EQUAL_TO, DEBUGGER_TOKEN_NOT_EQUAL_TO,
+  DEBUGGER_TOKEN_LESS_THAN_OR_EQUAL_TO,
+  DEBUGGER_TOKEN_GREATER_THAN_OR_EQUAL_TO,
+  DEBUGGER_TOKEN_LOGICAL_AND, DEBUGGER_TOKEN_LOGICAL_OR,
+};
+
+#define EXPRESSION_TEST_BINARYOPS \
+  ( sizeof( expression_test_binaryops ) / \
+    sizeof( expression_test_binaryops[0] ) )
+
+static debugger_expression*
+expression_test_leaf( libspectrum_dword *seed )
+{
+  static const char *registers[] = { "a", "l", "hl", "sp", "ix" };
+
+  *seed = *seed * 1103515245 + 12345;
+
+  switch( ( *seed >> 16 ) % 4 ) {
+  case 0:
+    return debugger_expression_new_number( *seed >> 20, MEMPOOL_UNTRACKED );
+  case 1:
+    return debugger_expression_new_number( ( *seed >> 24 ) % 3,
+					   MEMPOOL_UNTRACKED );
+  case 2:
+    return debugger_expression_new_register(
+      debugger_register_hash( registers[ ( *seed >> 8 ) % 5 ] ),
+      MEMPOOL_UNTRACKED
+    );
+  default:
+    return debugger_expression_new_variable(
+      ( *seed >> 8 ) & 1 ? "set" : "unset", MEMPOOL_UNTRACKED
+    );
+  }
+}
+
+/* A random expression no more than 'depth' deep. Division is only ever
+   by a non-zero number, so the same tree can be given to both
+   evaluators */
+static debugger_expression*
+expression_test_random( libspectrum_dword *seed, int depth )
+{
+  debugger_expression *op1, *op2;
+  int operation;
+
+  *seed = *seed * 1103515245 + 12345;
+  if( !depth || ( *seed >> 16 ) % 4 == 0 ) return expression_test_leaf( seed );
+
+  if( ( *seed >> 20 ) % 8 == 0 ) {
+    static const int unaryops[] = { '!', '~', '-' };
+    return debugger_expression_new_unaryop(
+      unaryops[ ( *seed >> 24 ) % 3 ],
+      expression_test_random( seed, depth - 1 ), MEMPOOL_UNTRACKED
+    );
+  }
+
+  operation = expression_test_binaryops[ ( *seed >> 8 ) %
+					 EXPRESSION_TEST_BINARYOPS ];
+  op1 = expression_test_random( seed, depth - 1 );
+  op2 = operation == '/' ?
+        debugger_expression_new_number( 1 + ( *seed >> 24 ) % 7,
+					MEMPOOL_UNTRACKED ) :
+        expression_test_random( seed, depth - 1 );
+
+  return debugger_expression_new_binaryop( operation, op1, op2,
+					   MEMPOOL_UNTRACKED );
+}
+
+/* Compile 'exp' and check the program gives the same value as the
+   tree; frees 'exp' */
+static int
+expression_test_compare( debugger_expression *exp )
+{
+  debugger_program *program;
+  libspectrum_dword expected;
+
+  program = debugger_expression_compile( exp );
+  TEST_ASSERT( program );
+
+  expected = debugger_expression_evaluate( exp );
+  TEST_ASSERT( debugger_program_run( program ) == expected );
+
+  debugger_program_delete( program );
+  debugger_expression_delete( exp );
+
+  return 0;
+}
+
+/* Compiled breakpoint conditions must give the same value as
+   evaluating the expression tree */
+static int
+debugger_expression_test( void )
+{
+  debugger_expression *exp;
+  debugger_program *program;
+  libspectrum_dword seed = 1;
+  int a = debugger_register_hash( "a" ), hl = debugger_register_hash( "hl" );
+  int i, r;
+
+  debugger_register_set( a, 0x42 );
+  debugger_register_set( hl, 0x1234 );
+  debugger_variable_set( "set", 0x8000 );
+
+  /* Register operands read the processor when the program is run, not
+     when it is compiled */
+  exp = debugger_expression_new_binaryop(
+    '+', debugger_expression_new_register( a, MEMPOOL_UNTRACKED ),
+    debugger_expression_new_register( hl, MEMPOOL_UNTRACKED ),
+    MEMPOOL_UNTRACKED
+  );
+  program = debugger_expression_compile( exp );
+  TEST_ASSERT( program );
+  TEST_ASSERT( debugger_program_run( program ) == 0x1276 );
+  debugger_register_set( a, 0xff ); debugger_register_set( hl, 0xffff );
+  TEST_ASSERT( debugger_program_run( program ) == 0x100fe );
+  TEST_ASSERT( debugger_expression_evaluate( exp ) == 0x100fe );
+  debugger_program_delete( program );
+  debugger_expression_delete( exp );
+
+  /* The second operand of && and || is skipped when the first decides
+     the result: if it weren't, this would divide by a variable which
+     is never set */
+  exp = debugger_expression_new_binaryop(
+    DEBUGGER_TOKEN_LOGICAL_AND,
+    debugger_expression_new_number( 0, MEMPOOL_UNTRACKED ),
+    debugger_expression_new_binaryop(
+      '/', debugger_expression_new_number( 1, MEMPOOL_UNTRACKED ),
+      debugger_expression_new_variable( "unset", MEMPOOL_UNTRACKED ),
+      MEMPOOL_UNTRACKED
+    ),
+    MEMPOOL_UNTRACKED
+  );
+  if( expression_test_compare( exp ) ) return 1;
+
+  exp = debugger_expression_new_binaryop(
+    DEBUGGER_TOKEN_LOGICAL_OR,
+    debugger_expression_new_variable( "set", MEMPOOL_UNTRACKED ),
+    debugger_expression_new_binaryop(
+      '/', debugger_expression_new_number( 1, MEMPOOL_UNTRACKED ),
+      debugger_expression_new_variable( "unset", MEMPOOL_UNTRACKED ),
+      MEMPOOL_UNTRACKED
+    ),
+    MEMPOOL_UNTRACKED
+  );
+  if( expression_test_compare( exp ) ) return 1;
+
+  /* An expression too deep for the program's stack isn't compiled, so
+     the breakpoint falls back to evaluating the tree */
+  exp = debugger_expression_new_number( 1, MEMPOOL_UNTRACKED );
+  for( i = 0; i < PROGRAM_STACK_SIZE; i++ )
+    exp = debugger_expression_new_binaryop(
+      '+', debugger_expression_new_number( i, MEMPOOL_UNTRACKED ), exp,
+      MEMPOOL_UNTRACKED
+    );
+  TEST_ASSERT( debugger_expression_compile( exp ) == NULL );
+  TEST_ASSERT( debugger_expression_evaluate( exp ) ==
+	       1 + PROGRAM_STACK_SIZE * ( PROGRAM_STACK_SIZE - 1 ) / 2 );
+  debugger_expression_delete( exp );
+
+  /* The same depth leaning the other way needs no stack at all */
+  exp = debugger_expression_new_number( 1, MEMPOOL_UNTRACKED );
+  for( i = 0; i < PROGRAM_STACK_SIZE; i++ )
+    exp = debugger_expression_new_binaryop(
+      '+', exp, debugger_expression_new_number( i, MEMPOOL_UNTRACKED ),
+      MEMPOOL_UNTRACKED
+    );
+  if( expression_test_compare( exp ) ) return 1;
+
+  for( i = 0, r = 0; i < EXPRESSION_TEST_COUNT && !r; i++ ) {
+    debugger_register_set( a, seed & 0xff );
+    debugger_register_set( hl, seed >> 16 );
+    r = expression_test_compare( expression_test_random( &seed, 5 ) );
+  }
+
+  return r;
+}
+
+/* Which of the test peripherals have seen the last port access, in
+   order */
+static int periph_test_seen[4];
+static size_t periph_test_seen_count;
+
+#define PERIPH_TEST_HANDLERS( n ) \
+static libspectrum_byte \
+periph_test_read##n( libspectrum_word port GCC_UNUSED, int *attached ) \
+{ \
+  periph_test_seen[ periph_test_seen_count++ ] = n; \
+  *attached = 1; \
+  return ~( 1 << n ); \
+} \
+\
+static void \
+periph_test_write##n( libspectrum_word port GCC_UNUSED, \
+		      libspectrum_byte b GCC_UNUSED ) \
+{ \
+  periph_test_seen[ periph_test_seen_count++ ] = n; \
+}
+
+PERIPH_TEST_HANDLERS( 0 )
+PERIPH_TEST_HANDLERS( 1 )
+PERIPH_TEST_HANDLERS( 2 )
+PERIPH_TEST_HANDLERS( 3 )
+
+/* Overlapping decodes, including ones which look at only the high byte
+   and a write-only one */
+static const periph_t periph_test_peripherals[] = {
+  { 0x0001, 0x0000, periph_test_read0, periph_test_write0 },
+  { 0xc002, 0xc000, periph_test_read1, periph_test_write1 },
+  { 0x00ff, 0x001f, periph_test_read2, periph_test_write2 },
+  { 0x8000, 0x0000, NULL, periph_test_write3 },
+};
+
+#define PERIPH_TEST_COUNT \
+  ( sizeof( periph_test_peripherals ) / sizeof( periph_test_peripherals[0] ) )
+
+/* Check every port reaches exactly the peripherals which decode it, in
+   the order they were registered */
+static int
+periph_check_ports( const int *active )
+{
+  const periph_t *peripheral;
+  libspectrum_byte value = 0;
+  size_t i, expected;
+  libspectrum_dword port;
+  int write;
+
+  for( port = 0; port < 0x10000; port++ ) {
+    for( write = 0; write < 2; write++ ) {
+
+      periph_test_seen_count = 0;
+      if( write ) {
+	writeport_internal( port, 0 );
+      } else {
+	value = readport_internal( port );
+      }
+
+      expected = 0;
+      for( i = 0; i < PERIPH_TEST_COUNT; i++ ) {
+	peripheral = &periph_test_peripherals[i];
+	if( !active[i] || ( write ? !peripheral->write : !peripheral->read ) ||
+	    ( port & peripheral->mask ) != peripheral->value ) continue;
+
+	TEST_ASSERT( expected < periph_test_seen_count );
+	TEST_ASSERT( periph_test_seen[ expected ] == i );
+	expected++;
+      }
+      TEST_ASSERT( periph_test_seen_count == expected );
+
+      if( !write && expected ) {
+	libspectrum_byte wanted = 0xff;
+	for( i = 0; i < expected; i++ )
+	  wanted &= ~( 1 << periph_test_seen[i] );
+	TEST_ASSERT( value == wanted );
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int
+periph_test( void )
+{
+  int active[ PERIPH_TEST_COUNT ] = { 1, 1, 1, 1 };
+  int r;
+
+  periph_clear();
+  TEST_ASSERT( periph_register_n( periph_test_peripherals,
+				  PERIPH_TEST_COUNT ) == 0 );
+
+  r = periph_check_ports( active );
+
+  if( !r ) {
+    TEST_ASSERT( periph_set_active( 1, 0 ) == 0 );
+    active[1] = 0;
+    r = periph_check_ports( active );
+  }
+
+  /* Put back the machine's own peripherals */
+  machine_reset( 0 );
+
+  return r;
+}
+
 int
 unittests_run( void )
 {
@@ -256,6 +811,11 @@ unittests_run( void )
   r += contention_test();
   r += floating_bus_test();
   r += mempool_test();
+  r += pixel_expansion_test();
+  r += sound_dsp_test();
+  r += periph_test();
+  r += display_modes_test();
+  r += debugger_expression_test();
 
   return r;
 }
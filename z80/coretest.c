@@ -0,0 +1,808 @@
+/* coretest.c: Test program for Fuse's Z80 core
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* The Z80 core is built with CORETEST defined, which turns
+   readbyte_internal() and the contention macros into functions; this
+   file supplies those functions along with dummy versions of everything
+   else the core needs from the rest of Fuse, so the core can be run on
+   its own against a flat 64Kb memory map */
+
+#include <config.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libspectrum.h>
+
+#include "debugger/debugger.h"
+#include "disk/beta.h"
+#include "disk/plusd.h"
+#include "divide.h"
+#include "event.h"
+#include "fuse.h"
+#include "if1.h"
+#include "machine.h"
+#include "memory.h"
+#include "module.h"
+#include "periph.h"
+#include "profile.h"
+#include "rzx.h"
+#include "scld.h"
+#include "settings.h"
+#include "slt.h"
+#include "spectrum.h"
+#include "tape.h"
+#include "ui/ui.h"
+#include "z80.h"
+#include "z80_macros.h"
+
+static const char *progname;
+
+static fuse_machine_info dummy_machine;
+
+static libspectrum_byte memory[ 0x10000 ];
+static libspectrum_byte initial_memory[ 0x10000 ];
+
+/* Running checksum of all port writes, so tests can tell if two runs
+   did the same I/O */
+static libspectrum_dword port_checksum;
+
+/* Should we log every bus access, and should accesses to 0x4000 to
+   0x7fff be delayed as on a 48K machine? */
+static int trace = 0;
+static int contention = 0;
+
+/* The output for the test currently being run */
+static char *output = NULL;
+static size_t output_length = 0, output_size = 0;
+
+/* Statistics are kept for each family of opcodes */
+typedef enum opcode_family {
+  FAMILY_BASE,
+  FAMILY_CB,
+  FAMILY_ED,
+  FAMILY_DD,
+  FAMILY_FD,
+  FAMILY_DDCB,
+  FAMILY_FDCB,
+
+  FAMILY_COUNT
+} opcode_family;
+
+static const char *family_names[ FAMILY_COUNT ] = {
+  "base", "CB", "ED", "DD", "FD", "DDCB", "FDCB"
+};
+
+typedef struct family_stats {
+  unsigned long tests, failures;
+  libspectrum_dword min_tstates, max_tstates;
+  libspectrum_qword total_tstates;
+} family_stats;
+
+static family_stats stats[ FAMILY_COUNT ];
+
+/* How many tstates each differential test is run for */
+static const libspectrum_dword DIFFERENTIAL_TSTATES = 100000;
+
+static int run_tests( const char *tests_file, const char *expected_file );
+static int differential_test( unsigned long seed );
+
+static void
+usage( void )
+{
+  fprintf( stderr,
+	   "usage: %s [-c] <tests.in> [<tests.expected>]\n"
+	   "       %s -d [<count>]\n", progname, progname );
+}
+
+int
+main( int argc, char **argv )
+{
+  unsigned long i, count = 1000;
+  int error = 0;
+
+  progname = argv[0];
+
+  machine_current = &dummy_machine;
+
+  if( z80_init() ) {
+    fprintf( stderr, "%s: error initialising Z80 core\n", progname );
+    return 1;
+  }
+
+  /* -c runs the corpus with contention, for the tests which exercise
+     the contended region */
+  if( argc > 1 && !strcmp( argv[1], "-c" ) ) {
+    contention = 1;
+    argc--; argv++;
+  }
+
+  if( argc < 2 || argc > 3 ) { usage(); return 1; }
+
+  if( !strcmp( argv[1], "-d" ) ) {
+
+    if( argc > 2 ) count = strtoul( argv[2], NULL, 0 );
+
+    contention = 1;
+    for( i = 0; i < count; i++ ) error |= differential_test( i );
+
+    if( !error )
+      printf( "%s: %lu differential tests passed\n", progname, count );
+
+  } else {
+
+    trace = 1;
+    error = run_tests( argv[1], argc > 2 ? argv[2] : NULL );
+
+  }
+
+  return error;
+}
+
+static int
+output_printf( const char *format, ... )
+{
+  va_list ap;
+  int length;
+
+  while( 1 ) {
+
+    va_start( ap, format );
+    length = vsnprintf( output + output_length, output_size - output_length,
+			format, ap );
+    va_end( ap );
+
+    if( length < 0 ) return 1;
+
+    if( output_length + length < output_size ) break;
+
+    output_size = output_size ? 2 * output_size : 0x1000;
+    output = realloc( output, output_size );
+    if( !output ) {
+      fprintf( stderr, "%s: out of memory\n", progname );
+      exit( 1 );
+    }
+
+  }
+
+  output_length += length;
+
+  return 0;
+}
+
+/*
+ * Tests from a file
+ */
+
+/* Read one test from 'f'. Returns 0 on success, -1 at end of file or 1
+   on error */
+static int
+read_test( FILE *f, char *name, size_t name_length,
+	   libspectrum_dword *end_tstates )
+{
+  unsigned af, bc, de, hl, af_, bc_, de_, hl_, ix, iy, sp, pc;
+  unsigned i, r, iff1, iff2, im, end;
+  int halted;
+  unsigned address, byte;
+  size_t length;
+
+  do {
+    if( !fgets( name, name_length, f ) ) return -1;
+    length = strlen( name );
+    while( length && ( name[ length - 1 ] == '\n' ||
+		       name[ length - 1 ] == '\r'    ) )
+      name[ --length ] = '\0';
+  } while( !length );
+
+  if( fscanf( f, "%x %x %x %x %x %x %x %x %x %x %x %x", &af, &bc, &de, &hl,
+	      &af_, &bc_, &de_, &hl_, &ix, &iy, &sp, &pc ) != 12 ) {
+    fprintf( stderr, "%s: %s: bad register line\n", progname, name );
+    return 1;
+  }
+
+  if( fscanf( f, "%x %x %u %u %u %d %u", &i, &r, &iff1, &iff2, &im, &halted,
+	      &end ) != 7 ) {
+    fprintf( stderr, "%s: %s: bad state line\n", progname, name );
+    return 1;
+  }
+
+  AF  = af;  BC  = bc;  DE  = de;  HL  = hl;
+  AF_ = af_; BC_ = bc_; DE_ = de_; HL_ = hl_;
+  IX  = ix;  IY  = iy;  SP  = sp;  PC  = pc;
+  I = i; R = r & 0x7f; R7 = r & 0x80;
+  IFF1 = iff1; IFF2 = iff2; IM = im;
+  z80.halted = halted;
+  z80.interrupts_enabled_at = -1;
+  *end_tstates = end;
+
+  /* Memory is filled with a recognisable pattern, then each block from
+     the test is written over it */
+  for( address = 0; address < 0x10000; address += 4 ) {
+    memory[ address     ] = 0xde; memory[ address + 1 ] = 0xad;
+    memory[ address + 2 ] = 0xbe; memory[ address + 3 ] = 0xef;
+  }
+
+  while( 1 ) {
+
+    if( fscanf( f, "%x", &address ) != 1 ) {
+      fprintf( stderr, "%s: %s: bad memory block\n", progname, name );
+      return 1;
+    }
+    if( address == (unsigned)-1 ) break;
+
+    while( 1 ) {
+      if( fscanf( f, "%x", &byte ) != 1 ) {
+	fprintf( stderr, "%s: %s: bad memory block\n", progname, name );
+	return 1;
+      }
+      if( byte == (unsigned)-1 ) break;
+      memory[ address++ & 0xffff ] = byte;
+    }
+  }
+
+  memcpy( initial_memory, memory, sizeof( memory ) );
+
+  return 0;
+}
+
+/* Each test is named after the opcode bytes it runs, which may not be
+   the first thing the test executes */
+static opcode_family
+get_family( const char *name )
+{
+  unsigned first = 0, second = 0;
+
+  sscanf( name, "%x %x", &first, &second );
+
+  switch( first ) {
+  case 0xcb: return FAMILY_CB;
+  case 0xed: return FAMILY_ED;
+  case 0xdd: return second == 0xcb ? FAMILY_DDCB : FAMILY_DD;
+  case 0xfd: return second == 0xcb ? FAMILY_FDCB : FAMILY_FD;
+  default: return FAMILY_BASE;
+  }
+}
+
+/* Write the final state in the same format as the expected results */
+static void
+dump_state( const char *name )
+{
+  size_t address, start;
+
+  output_printf( "%04x %04x %04x %04x %04x %04x %04x %04x %04x %04x %04x %04x\n",
+		 AF, BC, DE, HL, AF_, BC_, DE_, HL_, IX, IY, SP, PC );
+  output_printf( "%02x %02x %d %d %d %d %d\n", I, ( R7 & 0x80 ) | ( R & 0x7f ),
+		 IFF1, IFF2, IM, z80.halted, (int)tstates );
+
+  /* Then each run of bytes which has changed */
+  for( address = 0; address < 0x10000; address++ ) {
+
+    if( memory[ address ] == initial_memory[ address ] ) continue;
+
+    start = address;
+    output_printf( "%04x ", (unsigned)start );
+    while( address < 0x10000 &&
+	   memory[ address ] != initial_memory[ address ] )
+      output_printf( "%02x ", memory[ address++ ] );
+    output_printf( "-1\n" );
+
+  }
+
+  output_printf( "\n" );
+}
+
+/* Read the expected results for one test into 'buffer' */
+static int
+read_expected( FILE *f, char **buffer, size_t *length, size_t *size )
+{
+  char line[ 256 ];
+  size_t line_length;
+  int started = 0;
+
+  *length = 0;
+
+  while( fgets( line, sizeof( line ), f ) ) {
+
+    line_length = strlen( line );
+    if( line_length && line[ line_length - 1 ] == '\n' &&
+	line_length > 1 && line[ line_length - 2 ] == '\r' ) {
+      line[ line_length - 2 ] = '\n'; line[ --line_length ] = '\0';
+    }
+
+    /* Skip any blank lines before the test */
+    if( !started && line[0] == '\n' ) continue;
+    started = 1;
+
+    if( *length + line_length + 1 > *size ) {
+      *size = 2 * ( *length + line_length + 1 );
+      *buffer = realloc( *buffer, *size );
+      if( !*buffer ) {
+	fprintf( stderr, "%s: out of memory\n", progname );
+	exit( 1 );
+      }
+    }
+
+    memcpy( *buffer + *length, line, line_length + 1 );
+    *length += line_length;
+
+    if( line[0] == '\n' ) break;
+  }
+
+  return !started;
+}
+
+/* Report the first line at which the actual and expected results
+   differ */
+static void
+report_difference( const char *name, const char *expected )
+{
+  const char *a = output, *b = expected;
+  size_t a_length, b_length;
+
+  while( *a && *b ) {
+    a_length = strcspn( a, "\n" ); b_length = strcspn( b, "\n" );
+    if( a_length != b_length || memcmp( a, b, a_length ) ) break;
+    a += a_length + ( a[ a_length ] ? 1 : 0 );
+    b += b_length + ( b[ b_length ] ? 1 : 0 );
+  }
+
+  fprintf( stderr, "%s: %s: expected '%.*s', got '%.*s'\n", progname, name,
+	   (int)strcspn( b, "\n" ), b, (int)strcspn( a, "\n" ), a );
+}
+
+static void
+print_stats( FILE *f )
+{
+  size_t i;
+
+  fprintf( f, "%-6s %7s %8s %8s %8s %8s\n", "family", "tests", "failures",
+	   "min", "mean", "max" );
+
+  for( i = 0; i < FAMILY_COUNT; i++ ) {
+    if( !stats[i].tests ) continue;
+    fprintf( f, "%-6s %7lu %8lu %8u %8.2f %8u\n", family_names[i],
+	     stats[i].tests, stats[i].failures,
+	     (unsigned)stats[i].min_tstates,
+	     (double)stats[i].total_tstates / stats[i].tests,
+	     (unsigned)stats[i].max_tstates );
+  }
+}
+
+/* Run every test in 'tests_file'. If 'expected_file' is given, compare
+   the results against it; otherwise, just write the results to stdout
+   in the same format so they can be used as the expected results */
+static int
+run_tests( const char *tests_file, const char *expected_file )
+{
+  FILE *tests, *expected = NULL;
+  char name[ 256 ], *expected_buffer = NULL;
+  size_t expected_length, expected_size = 0;
+  libspectrum_dword end_tstates;
+  unsigned long count = 0, failures = 0;
+  opcode_family family;
+  int error;
+
+  tests = fopen( tests_file, "r" );
+  if( !tests ) {
+    fprintf( stderr, "%s: couldn't open '%s'\n", progname, tests_file );
+    return 1;
+  }
+
+  if( expected_file ) {
+    expected = fopen( expected_file, "r" );
+    if( !expected ) {
+      fprintf( stderr, "%s: couldn't open '%s'\n", progname, expected_file );
+      fclose( tests );
+      return 1;
+    }
+  }
+
+  while( !( error = read_test( tests, name, sizeof( name ),
+			       &end_tstates ) ) ) {
+
+    family = get_family( name );
+
+    output_length = 0;
+    output_printf( "%s\n", name );
+
+    tstates = 0;
+    event_next_event = end_tstates;
+    while( tstates < end_tstates ) z80_do_opcodes();
+
+    dump_state( name );
+
+    count++;
+    stats[ family ].tests++;
+    stats[ family ].total_tstates += tstates;
+    if( stats[ family ].tests == 1 || tstates < stats[ family ].min_tstates )
+      stats[ family ].min_tstates = tstates;
+    if( tstates > stats[ family ].max_tstates )
+      stats[ family ].max_tstates = tstates;
+
+    if( !expected ) {
+      fwrite( output, 1, output_length, stdout );
+      continue;
+    }
+
+    if( read_expected( expected, &expected_buffer, &expected_length,
+		       &expected_size ) ) {
+      fprintf( stderr, "%s: %s: no expected results\n", progname, name );
+      failures++; stats[ family ].failures++;
+      continue;
+    }
+
+    if( expected_length != output_length ||
+	memcmp( expected_buffer, output, output_length ) ) {
+      report_difference( name, expected_buffer );
+      failures++; stats[ family ].failures++;
+    }
+
+  }
+
+  fclose( tests );
+  if( expected ) fclose( expected );
+  free( expected_buffer );
+
+  if( error == 1 ) return 1;
+
+  if( expected ) {
+    print_stats( stdout );
+    printf( "%s: %lu tests, %lu failures\n", progname, count, failures );
+  } else {
+    print_stats( stderr );
+  }
+
+  return failures ? 1 : 0;
+}
+
+/*
+ * Differential tests
+ */
+
+/* A small deterministic generator so results don't depend on the host's
+   rand() */
+static libspectrum_dword
+next_random( libspectrum_dword *state )
+{
+  *state = *state * 1103515245UL + 12345UL;
+  return *state >> 16;
+}
+
+static void
+randomise_state( unsigned long seed )
+{
+  libspectrum_dword state = seed;
+  size_t i;
+
+  for( i = 0; i < 0x10000; i++ ) memory[i] = next_random( &state );
+
+  AF  = next_random( &state ); BC  = next_random( &state );
+  DE  = next_random( &state ); HL  = next_random( &state );
+  AF_ = next_random( &state ); BC_ = next_random( &state );
+  DE_ = next_random( &state ); HL_ = next_random( &state );
+  IX  = next_random( &state ); IY  = next_random( &state );
+  SP  = next_random( &state ); PC  = next_random( &state );
+  I   = next_random( &state ); R   = next_random( &state ) & 0x7f;
+  R7  = next_random( &state ) & 0x80;
+  IFF1 = IFF2 = 0; IM = next_random( &state ) % 3;
+  z80.halted = 0;
+  z80.interrupts_enabled_at = -1;
+
+  dummy_machine.ram.current_rom = next_random( &state ) & 1;
+  beta_active = 0;
+
+  tstates = 0;
+  port_checksum = 0;
+}
+
+/* Everything which might differ between two runs of the core */
+typedef struct run_result {
+  processor z80;
+  libspectrum_dword tstates;
+  libspectrum_dword port_checksum;
+  libspectrum_byte memory[ 0x10000 ];
+} run_result;
+
+static void
+run_core( run_result *result )
+{
+  event_next_event = DIFFERENTIAL_TSTATES;
+  z80_do_opcodes();
+
+  result->z80 = z80;
+  result->tstates = tstates;
+  result->port_checksum = port_checksum;
+  memcpy( result->memory, memory, sizeof( memory ) );
+}
+
+static int
+compare_runs( unsigned long seed, const run_result *a, const run_result *b )
+{
+  const processor *x = &a->z80, *y = &b->z80;
+
+  if( x->af.w  != y->af.w  || x->bc.w  != y->bc.w  ||
+      x->de.w  != y->de.w  || x->hl.w  != y->hl.w  ||
+      x->af_.w != y->af_.w || x->bc_.w != y->bc_.w ||
+      x->de_.w != y->de_.w || x->hl_.w != y->hl_.w ||
+      x->ix.w  != y->ix.w  || x->iy.w  != y->iy.w  ||
+      x->sp.w  != y->sp.w  || x->pc.w  != y->pc.w  ||
+      x->i != y->i || x->r != y->r || x->r7 != y->r7 ||
+      x->iff1 != y->iff1 || x->iff2 != y->iff2 || x->im != y->im ||
+      x->halted != y->halted ||
+      x->interrupts_enabled_at != y->interrupts_enabled_at ) {
+    fprintf( stderr, "%s: seed %lu: registers differ (PC %04x vs %04x)\n",
+	     progname, seed, x->pc.w, y->pc.w );
+    return 1;
+  }
+
+  if( a->tstates != b->tstates ) {
+    fprintf( stderr, "%s: seed %lu: tstates differ (%u vs %u)\n", progname,
+	     seed, (unsigned)a->tstates, (unsigned)b->tstates );
+    return 1;
+  }
+
+  if( a->port_checksum != b->port_checksum ) {
+    fprintf( stderr, "%s: seed %lu: port writes differ\n", progname, seed );
+    return 1;
+  }
+
+  if( memcmp( a->memory, b->memory, sizeof( a->memory ) ) ) {
+    fprintf( stderr, "%s: seed %lu: memory differs\n", progname, seed );
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Run the same random code twice, once with no checks active (or only
+   the TR-DOS check) so that the threaded code path is used and once
+   with the profiler 'active' to force every opcode through the normal
+   loop, and check that both end up in exactly the same state at
+   exactly the same time */
+static int
+differential_run( unsigned long seed, int beta )
+{
+  static run_result threaded, normal;
+
+  beta_available = beta;
+
+  randomise_state( seed );
+  profile_active = 0;
+  run_core( &threaded );
+
+  randomise_state( seed );
+  profile_active = 1;
+  run_core( &normal );
+  profile_active = 0;
+
+  beta_available = 0;
+
+  return compare_runs( seed, &threaded, &normal );
+}
+
+static int
+differential_test( unsigned long seed )
+{
+  return differential_run( seed, 0 ) || differential_run( seed, 1 );
+}
+
+/* Memory access. When tracing, each access is logged as the time, the
+   type of access ("MC" for contention, "MR"/"MW" for memory read/write,
+   "PR"/"PW" for port read/write), the address and any data */
+
+static void contend( libspectrum_word address );
+
+libspectrum_byte
+readbyte( libspectrum_word address )
+{
+  libspectrum_byte b;
+
+  contend( address );
+  b = memory[ address ];
+  if( trace ) output_printf( "%5d MR %04x %02x\n", (int)tstates, address, b );
+  tstates += 3;
+
+  return b;
+}
+
+libspectrum_byte
+readbyte_internal( libspectrum_word address )
+{
+  return memory[ address ];
+}
+
+void
+writebyte( libspectrum_word address, libspectrum_byte b )
+{
+  contend( address );
+  if( trace ) output_printf( "%5d MW %04x %02x\n", (int)tstates, address, b );
+  tstates += 3;
+  writebyte_internal( address, b );
+}
+
+void
+writebyte_internal( libspectrum_word address, libspectrum_byte b )
+{
+  memory[ address ] = b;
+}
+
+/* Contention: a simplified 48K model, with 0x4000 to 0x7fff contended
+   during the first 128 tstates of each 224 tstate line */
+
+static void
+contend( libspectrum_word address )
+{
+  static const libspectrum_byte pattern[] = { 6, 5, 4, 3, 2, 1, 0, 0 };
+  libspectrum_dword position = tstates % 224;
+
+  if( trace ) output_printf( "%5d MC %04x\n", (int)tstates, address );
+
+  if( !contention ||
+      address < 0x4000 || address >= 0x8000 || position >= 128 ) return;
+
+  tstates += pattern[ position % 8 ];
+}
+
+void
+contend_read( libspectrum_word address, libspectrum_dword time )
+{
+  contend( address ); tstates += time;
+}
+
+void
+contend_read_no_mreq( libspectrum_word address, libspectrum_dword time )
+{
+  contend( address ); tstates += time;
+}
+
+void
+contend_write_no_mreq( libspectrum_word address, libspectrum_dword time )
+{
+  contend( address ); tstates += time;
+}
+
+/* Ports */
+
+libspectrum_byte
+readport( libspectrum_word port )
+{
+  libspectrum_byte b = port >> 8;
+
+  if( trace ) output_printf( "%5d PR %04x %02x\n", (int)tstates, port, b );
+  tstates += 4;
+
+  return b;
+}
+
+void
+writeport( libspectrum_word port, libspectrum_byte b )
+{
+  if( trace ) output_printf( "%5d PW %04x %02x\n", (int)tstates, port, b );
+  tstates += 4;
+  port_checksum = port_checksum * 31 + ( port ^ ( b << 16 ) );
+}
+
+void
+writeport_internal( libspectrum_word port, libspectrum_byte b )
+{
+  writeport( port, b );
+}
+
+/* Dummy versions of everything else the core uses */
+
+libspectrum_dword tstates;
+libspectrum_dword event_next_event;
+
+fuse_machine_info *machine_current;
+settings_info settings_current;
+
+int profile_active = 0;
+int rzx_playback = 0;
+int rzx_instructions_offset = 0;
+size_t rzx_instruction_count = 0;
+enum debugger_mode_t debugger_mode = DEBUGGER_MODE_INACTIVE;
+int beta_available = 0, beta_active = 0;
+int plusd_available = 0;
+int if1_available = 0;
+int spectrum_frame_event = 0;
+scld scld_last_dec;
+
+void profile_map( libspectrum_word pc GCC_UNUSED ) {}
+void profile_interrupt( void ) {}
+/* Record TR-DOS paging in the port checksum so the differential test
+   can see it happened at the same time in both runs */
+void
+beta_page( void )
+{
+  beta_active = 1;
+  port_checksum = port_checksum * 31 + tstates;
+}
+
+void
+beta_unpage( void )
+{
+  beta_active = 0;
+  port_checksum = port_checksum * 37 + tstates;
+}
+
+void plusd_page( void ) {}
+void if1_page( void ) {}
+void if1_unpage( void ) {}
+void divide_set_automap( int state GCC_UNUSED ) {}
+int debugger_trap( void ) { return 0; }
+int rzx_frame( void ) { return 0; }
+int tape_load_trap( void ) { return 1; }
+int tape_save_trap( void ) { return 1; }
+
+int
+debugger_check( debugger_breakpoint_type type GCC_UNUSED,
+		libspectrum_dword value GCC_UNUSED )
+{
+  return 0;
+}
+
+int
+slt_trap( libspectrum_word address GCC_UNUSED,
+	  libspectrum_byte level GCC_UNUSED )
+{
+  return 0;
+}
+
+int
+event_register( event_fn_t fn GCC_UNUSED,
+		const char *description GCC_UNUSED )
+{
+  return 0;
+}
+
+int
+event_add_with_data( libspectrum_dword event_time GCC_UNUSED,
+		     int type GCC_UNUSED, void *user_data GCC_UNUSED )
+{
+  return 0;
+}
+
+int
+module_register( module_info_t *module GCC_UNUSED )
+{
+  return 0;
+}
+
+int
+ui_error( ui_error_level severity GCC_UNUSED, const char *format, ... )
+{
+  va_list ap;
+
+  va_start( ap, format );
+  vfprintf( stderr, format, ap );
+  va_end( ap );
+  fprintf( stderr, "\n" );
+
+  return 0;
+}
+
+void
+fuse_abort( void )
+{
+  abort();
+}
@@ -0,0 +1,1252 @@
+/* reference.c: An independent Z80 model for the core test corpus
+   Copyright (c) 2026 Fuse contributors
+
+   $Id$
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* The expected results for the core tests are produced by this program
+   rather than by the core itself, so a change to the core can't quietly
+   change what it's tested against. It shares no code with the core: the
+   instructions are written from Sean Young's "The Undocumented Z80
+   Documented", and the order and length of every bus cycle from the
+   breakdowns in the comp.sys.sinclair FAQ's section on contended memory,
+   where "hl:1 x 5" means five one tstate cycles with 'hl' on the address
+   bus. The bus trace and the simplified contention model are those
+   described in z80/tests/README */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLAG_C 0x01
+#define FLAG_N 0x02
+#define FLAG_P 0x04
+#define FLAG_3 0x08
+#define FLAG_H 0x10
+#define FLAG_5 0x20
+#define FLAG_Z 0x40
+#define FLAG_S 0x80
+
+static const char *progname;
+
+static unsigned char memory[ 0x10000 ], initial_memory[ 0x10000 ];
+
+static unsigned long tstates;
+static int contention = 0;
+
+/* The registers. 'r' counts every M1 cycle; only its bottom seven bits
+   are used, the top bit being whatever was last loaded into R */
+static unsigned char a, f, b, c, d, e, h, l;
+static unsigned char a_, f_, b_, c_, d_, e_, h_, l_;
+static unsigned ix, iy, sp, pc;
+static unsigned char i, r, r7;
+static int iff1, iff2, im, halted;
+
+/*
+ * Flag helpers
+ */
+
+static int
+parity( unsigned value )
+{
+  int bits = 0;
+
+  value &= 0xff;
+  while( value ) { bits += value & 1; value >>= 1; }
+
+  return !( bits & 1 );
+}
+
+/* Sign, zero and the undocumented bits 3 and 5 of an 8-bit result */
+static unsigned char
+sz53( unsigned value )
+{
+  value &= 0xff;
+  return ( value & ( FLAG_S | FLAG_5 | FLAG_3 ) ) | ( value ? 0 : FLAG_Z );
+}
+
+static unsigned char
+sz53p( unsigned value )
+{
+  return sz53( value ) | ( parity( value ) ? FLAG_P : 0 );
+}
+
+/*
+ * The bus. Every cycle is traced as in z80/tests/README
+ */
+
+static void
+contend( unsigned address )
+{
+  static const unsigned char pattern[] = { 6, 5, 4, 3, 2, 1, 0, 0 };
+  unsigned long position = tstates % 224;
+
+  printf( "%5d MC %04x\n", (int)tstates, address & 0xffff );
+
+  if( contention && address >= 0x4000 && address < 0x8000 &&
+      position < 128 )
+    tstates += pattern[ position % 8 ];
+}
+
+/* An M1 cycle: four tstates, and the refresh counter goes up */
+static unsigned char
+fetch( void )
+{
+  unsigned char opcode;
+
+  contend( pc );
+  tstates += 4;
+  opcode = memory[ pc ];
+  pc = ( pc + 1 ) & 0xffff;
+  r++;
+
+  return opcode;
+}
+
+static unsigned char
+read_byte( unsigned address )
+{
+  unsigned char value;
+
+  address &= 0xffff;
+  contend( address );
+  value = memory[ address ];
+  printf( "%5d MR %04x %02x\n", (int)tstates, address, value );
+  tstates += 3;
+
+  return value;
+}
+
+/* A three tstate read which the trace shows only as contention; used for
+   the displacement and opcode of DDCB and FDCB instructions, and for the
+   operands of jumps and calls which aren't taken */
+static unsigned char
+read_quiet( unsigned address )
+{
+  address &= 0xffff;
+  contend( address );
+  tstates += 3;
+
+  return memory[ address ];
+}
+
+static void
+write_byte( unsigned address, unsigned char value )
+{
+  address &= 0xffff;
+  contend( address );
+  printf( "%5d MW %04x %02x\n", (int)tstates, address, value );
+  tstates += 3;
+  memory[ address ] = value;
+}
+
+/* 'count' one tstate cycles with 'address' on the bus */
+static void
+internal( unsigned address, int count )
+{
+  while( count-- ) { contend( address ); tstates++; }
+}
+
+static unsigned
+ir( void )
+{
+  return i << 8 | ( r7 & 0x80 ) | ( r & 0x7f );
+}
+
+/* Nothing is attached to any port, so a read sees the top half of the
+   address bus */
+static unsigned char
+port_in( unsigned port )
+{
+  unsigned char value = port >> 8;
+
+  printf( "%5d PR %04x %02x\n", (int)tstates, port & 0xffff, value );
+  tstates += 4;
+
+  return value;
+}
+
+static void
+port_out( unsigned port, unsigned char value )
+{
+  printf( "%5d PW %04x %02x\n", (int)tstates, port & 0xffff, value );
+  tstates += 4;
+}
+
+static unsigned
+read_word( unsigned address )
+{
+  unsigned low = read_byte( address );
+  return low | read_byte( address + 1 ) << 8;
+}
+
+static void
+write_word( unsigned address, unsigned value )
+{
+  write_byte( address, value & 0xff );
+  write_byte( address + 1, value >> 8 );
+}
+
+/* The operand bytes following an instruction */
+static unsigned char
+next_byte( void )
+{
+  unsigned char value = read_byte( pc );
+  pc = ( pc + 1 ) & 0xffff;
+  return value;
+}
+
+static unsigned
+next_word( void )
+{
+  unsigned low = next_byte();
+  return low | next_byte() << 8;
+}
+
+/* Push writes the high byte first */
+static void
+push( unsigned value )
+{
+  sp = ( sp - 1 ) & 0xffff; write_byte( sp, value >> 8 );
+  sp = ( sp - 1 ) & 0xffff; write_byte( sp, value & 0xff );
+}
+
+static unsigned
+pop( void )
+{
+  unsigned value = read_word( sp );
+  sp = ( sp + 2 ) & 0xffff;
+  return value;
+}
+
+/*
+ * Register pairs
+ */
+
+static unsigned get_bc( void ) { return b << 8 | c; }
+static unsigned get_de( void ) { return d << 8 | e; }
+static unsigned get_hl( void ) { return h << 8 | l; }
+static unsigned get_af( void ) { return a << 8 | f; }
+
+static void set_bc( unsigned v ) { b = v >> 8; c = v; }
+static void set_de( unsigned v ) { d = v >> 8; e = v; }
+static void set_hl( unsigned v ) { h = v >> 8; l = v; }
+static void set_af( unsigned v ) { a = v >> 8; f = v; }
+
+/* The register pair selected by bits 4 and 5 of an opcode, with 'index'
+   standing in for HL and 'use_af' picking AF rather than SP */
+static unsigned
+get_pair( int n, unsigned index, int use_af )
+{
+  switch( n ) {
+  case 0: return get_bc();
+  case 1: return get_de();
+  case 2: return index;
+  default: return use_af ? get_af() : sp;
+  }
+}
+
+/* The index register in use: 0 for HL, 1 for IX, 2 for IY */
+static int prefix;
+
+static unsigned
+get_index( void )
+{
+  switch( prefix ) {
+  case 1: return ix;
+  case 2: return iy;
+  default: return get_hl();
+  }
+}
+
+static void
+set_index( unsigned v )
+{
+  v &= 0xffff;
+  switch( prefix ) {
+  case 1: ix = v; break;
+  case 2: iy = v; break;
+  default: set_hl( v ); break;
+  }
+}
+
+static void
+set_pair( int n, unsigned v, int use_af )
+{
+  v &= 0xffff;
+  switch( n ) {
+  case 0: set_bc( v ); break;
+  case 1: set_de( v ); break;
+  case 2: set_index( v ); break;
+  default: if( use_af ) set_af( v ); else sp = v; break;
+  }
+}
+
+/* The 8-bit register selected by three bits of an opcode; 6 is never
+   passed. With a prefix, H and L become the halves of the index register
+   unless 'plain' is set */
+static unsigned char
+get_reg( int n, int plain )
+{
+  switch( n ) {
+  case 0: return b;
+  case 1: return c;
+  case 2: return d;
+  case 3: return e;
+  case 4: return plain ? h : get_index() >> 8;
+  case 5: return plain ? l : get_index() & 0xff;
+  default: return a;
+  }
+}
+
+static void
+set_reg( int n, unsigned char v, int plain )
+{
+  switch( n ) {
+  case 0: b = v; break;
+  case 1: c = v; break;
+  case 2: d = v; break;
+  case 3: e = v; break;
+  case 4:
+    if( plain ) h = v; else set_index( ( get_index() & 0x00ff ) | v << 8 );
+    break;
+  case 5:
+    if( plain ) l = v; else set_index( ( get_index() & 0xff00 ) | v );
+    break;
+  default: a = v; break;
+  }
+}
+
+/*
+ * Arithmetic
+ */
+
+static void
+alu( int op, unsigned char value )
+{
+  unsigned result, carry;
+
+  switch( op ) {
+
+  case 0: case 1:		/* ADD, ADC */
+    carry = op == 1 ? f & FLAG_C : 0;
+    result = a + value + carry;
+    f = sz53( result ) | ( result > 0xff ? FLAG_C : 0 ) |
+        ( ( a ^ value ^ result ) & FLAG_H ) |
+        ( ( ~( a ^ value ) & ( a ^ result ) & 0x80 ) ? FLAG_P : 0 );
+    a = result;
+    break;
+
+  case 2: case 3: case 7:	/* SUB, SBC, CP */
+    carry = op == 3 ? f & FLAG_C : 0;
+    result = ( a - value - carry ) & 0x1ff;
+    f = sz53( result ) | ( result & 0x100 ? FLAG_C : 0 ) | FLAG_N |
+        ( ( a ^ value ^ result ) & FLAG_H ) |
+        ( ( ( a ^ value ) & ( a ^ result ) & 0x80 ) ? FLAG_P : 0 );
+    if( op == 7 )
+      f = ( f & ~( FLAG_3 | FLAG_5 ) ) | ( value & ( FLAG_3 | FLAG_5 ) );
+    else
+      a = result;
+    break;
+
+  case 4: a &= value; f = sz53p( a ) | FLAG_H; break;
+  case 5: a ^= value; f = sz53p( a ); break;
+  case 6: a |= value; f = sz53p( a ); break;
+
+  }
+}
+
+static unsigned char
+inc8( unsigned char value )
+{
+  unsigned char result = value + 1;
+
+  f = ( f & FLAG_C ) | sz53( result ) | ( result == 0x80 ? FLAG_P : 0 ) |
+      ( ( result & 0x0f ) ? 0 : FLAG_H );
+
+  return result;
+}
+
+static unsigned char
+dec8( unsigned char value )
+{
+  unsigned char result = value - 1;
+
+  f = ( f & FLAG_C ) | FLAG_N | sz53( result ) |
+      ( value == 0x80 ? FLAG_P : 0 ) | ( ( value & 0x0f ) ? 0 : FLAG_H );
+
+  return result;
+}
+
+static unsigned
+add16( unsigned x, unsigned y )
+{
+  unsigned result = x + y;
+
+  f = ( f & ( FLAG_S | FLAG_Z | FLAG_P ) ) |
+      ( ( result >> 8 ) & ( FLAG_3 | FLAG_5 ) ) |
+      ( ( ( x ^ y ^ result ) >> 8 ) & FLAG_H ) |
+      ( result > 0xffff ? FLAG_C : 0 );
+
+  return result & 0xffff;
+}
+
+static void
+adc16( unsigned value )
+{
+  unsigned x = get_hl(), result = x + value + ( f & FLAG_C );
+
+  f = ( ( result >> 8 ) & ( FLAG_S | FLAG_3 | FLAG_5 ) ) |
+      ( result > 0xffff ? FLAG_C : 0 ) |
+      ( ( ( x ^ value ^ result ) >> 8 ) & FLAG_H ) |
+      ( ( ~( x ^ value ) & ( x ^ result ) & 0x8000 ) ? FLAG_P : 0 ) |
+      ( ( result & 0xffff ) ? 0 : FLAG_Z );
+
+  set_hl( result & 0xffff );
+}
+
+static void
+sbc16( unsigned value )
+{
+  unsigned x = get_hl(), result = ( x - value - ( f & FLAG_C ) ) & 0x1ffff;
+
+  f = FLAG_N | ( ( result >> 8 ) & ( FLAG_S | FLAG_3 | FLAG_5 ) ) |
+      ( result & 0x10000 ? FLAG_C : 0 ) |
+      ( ( ( x ^ value ^ result ) >> 8 ) & FLAG_H ) |
+      ( ( ( x ^ value ) & ( x ^ result ) & 0x8000 ) ? FLAG_P : 0 ) |
+      ( ( result & 0xffff ) ? 0 : FLAG_Z );
+
+  set_hl( result & 0xffff );
+}
+
+/* The CB rotates and shifts, selected by bits 3 to 5 of the opcode */
+static unsigned char
+rotate( int op, unsigned char value )
+{
+  unsigned char result, carry;
+
+  switch( op ) {
+  case 0: carry = value >> 7; result = value << 1 | carry; break;
+  case 1: carry = value & 1; result = value >> 1 | carry << 7; break;
+  case 2: carry = value >> 7; result = value << 1 | ( f & FLAG_C ); break;
+  case 3:
+    carry = value & 1; result = value >> 1 | ( f & FLAG_C ) << 7; break;
+  case 4: carry = value >> 7; result = value << 1; break;
+  case 5: carry = value & 1; result = value >> 1 | ( value & 0x80 ); break;
+  case 6: carry = value >> 7; result = value << 1 | 1; break;
+  default: carry = value & 1; result = value >> 1; break;
+  }
+
+  f = sz53p( result ) | carry;
+
+  return result;
+}
+
+/* BIT; bits 3 and 5 come from 'undocumented', which is the value tested
+   for registers and (HL), and the high byte of the address for (IX+d) */
+static void
+bit( int n, unsigned char value, unsigned char undocumented )
+{
+  f = ( f & FLAG_C ) | FLAG_H | ( undocumented & ( FLAG_3 | FLAG_5 ) );
+  if( !( value & ( 1 << n ) ) ) f |= FLAG_Z | FLAG_P;
+  if( n == 7 && ( value & 0x80 ) ) f |= FLAG_S;
+}
+
+static void
+daa( void )
+{
+  unsigned char add = 0, carry = f & FLAG_C, half;
+
+  if( ( f & FLAG_H ) || ( a & 0x0f ) > 9 ) add = 0x06;
+  if( carry || a > 0x99 ) { add |= 0x60; carry = FLAG_C; }
+
+  if( f & FLAG_N ) {
+    half = ( f & FLAG_H ) && ( a & 0x0f ) < 6 ? FLAG_H : 0;
+    a -= add;
+  } else {
+    half = ( a & 0x0f ) > 9 ? FLAG_H : 0;
+    a += add;
+  }
+
+  f = sz53p( a ) | ( f & FLAG_N ) | carry | half;
+}
+
+static int
+condition( int n )
+{
+  switch( n ) {
+  case 0: return !( f & FLAG_Z );
+  case 1: return f & FLAG_Z;
+  case 2: return !( f & FLAG_C );
+  case 3: return f & FLAG_C;
+  case 4: return !( f & FLAG_P );
+  case 5: return f & FLAG_P;
+  case 6: return !( f & FLAG_S );
+  default: return f & FLAG_S;
+  }
+}
+
+/*
+ * Instructions
+ */
+
+/* The address of an (HL) or (IX+d) operand. For (IX+d), 'wait' is the
+   number of one tstate cycles on the displacement's address afterwards:
+   five normally, but only two for LD (IX+d),n, which fetches its operand
+   first */
+static unsigned
+operand_address( int wait )
+{
+  unsigned address;
+  signed char displacement;
+
+  if( !prefix ) return get_hl();
+
+  displacement = read_byte( pc );
+  if( wait ) internal( pc, wait );
+  pc = ( pc + 1 ) & 0xffff;
+  address = ( get_index() + displacement ) & 0xffff;
+
+  return address;
+}
+
+static void
+execute_cb( void )
+{
+  unsigned char opcode = fetch(), value;
+  int n = opcode & 7, y = ( opcode >> 3 ) & 7;
+  unsigned address;
+
+  if( n != 6 ) {
+    value = get_reg( n, 1 );
+    switch( opcode >> 6 ) {
+    case 0: set_reg( n, rotate( y, value ), 1 ); break;
+    case 1: bit( y, value, value ); break;
+    case 2: set_reg( n, value & ~( 1 << y ), 1 ); break;
+    case 3: set_reg( n, value | 1 << y, 1 ); break;
+    }
+    return;
+  }
+
+  /* pc:4, pc+1:4, hl:3, hl:1, hl(write):3 */
+  address = get_hl();
+  value = read_byte( address );
+  internal( address, 1 );
+  switch( opcode >> 6 ) {
+  case 0: write_byte( address, rotate( y, value ) ); break;
+  case 1: bit( y, value, value ); break;
+  case 2: write_byte( address, value & ~( 1 << y ) ); break;
+  case 3: write_byte( address, value | 1 << y ); break;
+  }
+}
+
+/* DDCB and FDCB: pc:4, pc+1:4, pc+2:3, pc+3:3, pc+3:1 x 2, ii+n:3,
+   ii+n:1, ii+n(write):3 */
+static void
+execute_index_cb( void )
+{
+  unsigned char opcode, value, result;
+  signed char displacement;
+  unsigned address;
+  int n, y;
+
+  displacement = read_quiet( pc ); pc = ( pc + 1 ) & 0xffff;
+  opcode = read_quiet( pc );
+  internal( pc, 2 );
+  pc = ( pc + 1 ) & 0xffff;
+
+  address = ( get_index() + displacement ) & 0xffff;
+  n = opcode & 7; y = ( opcode >> 3 ) & 7;
+
+  value = read_byte( address );
+  internal( address, 1 );
+
+  switch( opcode >> 6 ) {
+  case 0: result = rotate( y, value ); break;
+  case 1: bit( y, value, address >> 8 ); return;
+  case 2: result = value & ~( 1 << y ); break;
+  default: result = value | 1 << y; break;
+  }
+
+  write_byte( address, result );
+
+  /* The result is also copied to the register given by the opcode */
+  if( n != 6 ) set_reg( n, result, 1 );
+}
+
+/* The block instructions; 'step' is +1 or -1 and 'repeat' is set for the
+   repeating versions */
+static void
+block_ld( int step, int repeat )
+{
+  unsigned char value, n;
+
+  /* pc:4, pc+1:4, hl:3, de:3, de:1 x 2, [de:1 x 5] */
+  value = read_byte( get_hl() );
+  write_byte( get_de(), value );
+  internal( get_de(), 2 );
+  set_bc( ( get_bc() - 1 ) & 0xffff );
+
+  n = value + a;
+  f = ( f & ( FLAG_S | FLAG_Z | FLAG_C ) ) | ( get_bc() ? FLAG_P : 0 ) |
+      ( n & FLAG_3 ) | ( ( n & 0x02 ) ? FLAG_5 : 0 );
+
+  if( repeat && get_bc() ) {
+    internal( get_de(), 5 );
+    pc = ( pc - 2 ) & 0xffff;
+  }
+
+  set_hl( ( get_hl() + step ) & 0xffff );
+  set_de( ( get_de() + step ) & 0xffff );
+}
+
+static void
+block_cp( int step, int repeat )
+{
+  unsigned char value, result, half, n;
+
+  /* pc:4, pc+1:4, hl:3, hl:1 x 5, [hl:1 x 5] */
+  value = read_byte( get_hl() );
+  internal( get_hl(), 5 );
+  set_bc( ( get_bc() - 1 ) & 0xffff );
+
+  result = a - value;
+  half = ( a ^ value ^ result ) & FLAG_H;
+  n = result - ( half ? 1 : 0 );
+  f = ( f & FLAG_C ) | FLAG_N | half | ( get_bc() ? FLAG_P : 0 ) |
+      ( sz53( result ) & ( FLAG_S | FLAG_Z ) ) |
+      ( n & FLAG_3 ) | ( ( n & 0x02 ) ? FLAG_5 : 0 );
+
+  if( repeat && get_bc() && result ) {
+    internal( get_hl(), 5 );
+    pc = ( pc - 2 ) & 0xffff;
+  }
+
+  set_hl( ( get_hl() + step ) & 0xffff );
+}
+
+static void
+block_in( int step, int repeat )
+{
+  unsigned char value, k;
+
+  /* pc:4, pc+1:5, IO, hl:3, [hl:1 x 5] */
+  internal( ir(), 1 );
+  value = port_in( get_bc() );
+  write_byte( get_hl(), value );
+  b--;
+
+  k = value + ( ( c + step ) & 0xff );
+  f = sz53( b ) | ( value & 0x80 ? FLAG_N : 0 ) |
+      ( value + ( ( c + step ) & 0xff ) > 0xff ? FLAG_H | FLAG_C : 0 ) |
+      ( parity( ( k & 7 ) ^ b ) ? FLAG_P : 0 );
+
+  if( repeat && b ) {
+    internal( get_hl(), 5 );
+    pc = ( pc - 2 ) & 0xffff;
+  }
+
+  set_hl( ( get_hl() + step ) & 0xffff );
+}
+
+static void
+block_out( int step, int repeat )
+{
+  unsigned char value, k;
+
+  /* pc:4, pc+1:5, hl:3, IO, [bc:1 x 5]; B is decremented before it is
+     put on the bus */
+  internal( ir(), 1 );
+  value = read_byte( get_hl() );
+  b--;
+  port_out( get_bc(), value );
+  set_hl( ( get_hl() + step ) & 0xffff );
+
+  k = value + l;
+  f = sz53( b ) | ( value & 0x80 ? FLAG_N : 0 ) |
+      ( value + l > 0xff ? FLAG_H | FLAG_C : 0 ) |
+      ( parity( ( k & 7 ) ^ b ) ? FLAG_P : 0 );
+
+  if( repeat && b ) {
+    internal( get_bc(), 5 );
+    pc = ( pc - 2 ) & 0xffff;
+  }
+}
+
+static void
+execute_ed( void )
+{
+  unsigned char opcode = fetch(), value;
+  int y = ( opcode >> 3 ) & 7, p = ( opcode >> 4 ) & 3;
+  unsigned address;
+
+  if( opcode >= 0x40 && opcode < 0x80 ) {
+
+    switch( opcode & 7 ) {
+
+    case 0:			/* IN r,(C): pc:4, pc+1:4, IO */
+      value = port_in( get_bc() );
+      f = ( f & FLAG_C ) | sz53p( value );
+      if( y != 6 ) set_reg( y, value, 1 );
+      return;
+
+    case 1:			/* OUT (C),r: pc:4, pc+1:4, IO */
+      port_out( get_bc(), y == 6 ? 0 : get_reg( y, 1 ) );
+      return;
+
+    case 2:			/* SBC/ADC HL,rr: pc:4, pc+1:4, ir:1 x 7 */
+      internal( ir(), 7 );
+      if( opcode & 0x08 ) adc16( get_pair( p, get_hl(), 0 ) );
+      else sbc16( get_pair( p, get_hl(), 0 ) );
+      return;
+
+    case 3:		/* LD (nn),rr and LD rr,(nn): pc:4, pc+1:4, pc+2:3,
+			   pc+3:3, nn:3, nn+1:3 */
+      address = next_word();
+      if( opcode & 0x08 ) set_pair( p, read_word( address ), 0 );
+      else write_word( address, get_pair( p, get_hl(), 0 ) );
+      return;
+
+    case 4:			/* NEG */
+      value = a; a = 0; alu( 2, value );
+      return;
+
+    case 5:			/* RETN, RETI: pc:4, pc+1:4, sp:3, sp+1:3 */
+      iff1 = iff2;
+      pc = pop();
+      return;
+
+    case 6:			/* IM */
+      im = ( y & 3 ) < 2 ? 0 : ( y & 3 ) - 1;
+      return;
+
+    case 7:
+      switch( y ) {
+      case 0: internal( ir(), 1 ); i = a; return;	/* LD I,A */
+      case 1: internal( ir(), 1 ); r = r7 = a; return;	/* LD R,A */
+      case 2: case 3:					/* LD A,I/R */
+	internal( ir(), 1 );
+	a = y == 2 ? i : ( ( r & 0x7f ) | ( r7 & 0x80 ) );
+	f = ( f & FLAG_C ) | sz53( a ) | ( iff2 ? FLAG_P : 0 );
+	return;
+      case 4: case 5:					/* RRD, RLD */
+	/* pc:4, pc+1:4, hl:3, hl:1 x 4, hl(write):3 */
+	value = read_byte( get_hl() );
+	internal( get_hl(), 4 );
+	if( y == 4 ) {
+	  write_byte( get_hl(), ( a << 4 | value >> 4 ) & 0xff );
+	  a = ( a & 0xf0 ) | ( value & 0x0f );
+	} else {
+	  write_byte( get_hl(), ( value << 4 | ( a & 0x0f ) ) & 0xff );
+	  a = ( a & 0xf0 ) | value >> 4;
+	}
+	f = ( f & FLAG_C ) | sz53p( a );
+	return;
+      default: return;					/* NOP */
+      }
+
+    }
+  }
+
+  if( opcode >= 0xa0 && opcode < 0xc0 && ( opcode & 7 ) < 4 ) {
+    int step = ( opcode & 0x08 ) ? -1 : 1, repeat = opcode >= 0xb0;
+    switch( opcode & 3 ) {
+    case 0: block_ld( step, repeat ); break;
+    case 1: block_cp( step, repeat ); break;
+    case 2: block_in( step, repeat ); break;
+    case 3: block_out( step, repeat ); break;
+    }
+  }
+
+  /* Anything else is an eight tstate no-op */
+}
+
+/* The unprefixed instructions, and those with DD or FD in front which
+   use IX or IY in place of HL */
+static void
+execute( unsigned char opcode )
+{
+  int x = opcode >> 6, y = ( opcode >> 3 ) & 7, z = opcode & 7;
+  int p = y >> 1, q = y & 1;
+  unsigned char value;
+  unsigned address, word;
+  signed char offset;
+
+  switch( x ) {
+
+  case 0:
+    switch( z ) {
+
+    case 0:
+      switch( y ) {
+      case 0: break;						/* NOP */
+      case 1:							/* EX AF,AF' */
+	value = a; a = a_; a_ = value;
+	value = f; f = f_; f_ = value;
+	break;
+      case 2:		/* DJNZ: pc:4, ir:1, pc+1:3, [pc+1:1 x 5] */
+	internal( ir(), 1 );
+	if( --b ) {
+	  offset = read_byte( pc );
+	  internal( pc, 5 );
+	  pc = ( pc + 1 + offset ) & 0xffff;
+	} else {
+	  read_quiet( pc );
+	  pc = ( pc + 1 ) & 0xffff;
+	}
+	break;
+      default:		/* JR (cc): pc:4, pc+1:3, [pc+1:1 x 5] */
+	if( y == 3 || condition( y - 4 ) ) {
+	  offset = read_byte( pc );
+	  internal( pc, 5 );
+	  pc = ( pc + 1 + offset ) & 0xffff;
+	} else {
+	  read_quiet( pc );
+	  pc = ( pc + 1 ) & 0xffff;
+	}
+	break;
+      }
+      break;
+
+    case 1:
+      if( !q ) {		/* LD rr,nn: pc:4, pc+1:3, pc+2:3 */
+	set_pair( p, next_word(), 0 );
+      } else {			/* ADD HL,rr: pc:4, ir:1 x 7 */
+	internal( ir(), 7 );
+	set_index( add16( get_index(), get_pair( p, get_index(), 0 ) ) );
+      }
+      break;
+
+    case 2:
+      switch( y ) {
+      case 0: write_byte( get_bc(), a ); break;	/* LD (BC),A: bc:3 */
+      case 1: a = read_byte( get_bc() ); break;	/* LD A,(BC) */
+      case 2: write_byte( get_de(), a ); break;
+      case 3: a = read_byte( get_de() ); break;
+      case 4:		/* LD (nn),HL: pc+1:3, pc+2:3, nn:3, nn+1:3 */
+	address = next_word(); write_word( address, get_index() ); break;
+      case 5: address = next_word(); set_index( read_word( address ) ); break;
+      case 6: address = next_word(); write_byte( address, a ); break;
+      case 7: address = next_word(); a = read_byte( address ); break;
+      }
+      break;
+
+    case 3:			/* INC/DEC rr: pc:4, ir:1 x 2 */
+      internal( ir(), 2 );
+      word = get_pair( p, get_index(), 0 );
+      set_pair( p, q ? word - 1 : word + 1, 0 );
+      break;
+
+    case 4: case 5:
+      if( y == 6 ) {	/* INC/DEC (HL): hl:3, hl:1, hl(write):3 */
+	address = operand_address( 5 );
+	value = read_byte( address );
+	internal( address, 1 );
+	write_byte( address, z == 4 ? inc8( value ) : dec8( value ) );
+      } else {
+	value = get_reg( y, 0 );
+	set_reg( y, z == 4 ? inc8( value ) : dec8( value ), 0 );
+      }
+      break;
+
+    case 6:
+      if( y == 6 ) {		/* LD (HL),n: pc+1:3, hl:3 */
+	if( prefix ) {
+	  /* pc+2:3, pc+3:3, pc+3:1 x 2, ii+n:3 */
+	  offset = next_byte();
+	  value = read_byte( pc );
+	  internal( pc, 2 );
+	  pc = ( pc + 1 ) & 0xffff;
+	  write_byte( get_index() + offset, value );
+	} else {
+	  value = next_byte();
+	  write_byte( get_hl(), value );
+	}
+      } else {			/* LD r,n: pc+1:3 */
+	set_reg( y, next_byte(), 0 );
+      }
+      break;
+
+    case 7:
+      switch( y ) {
+      case 0:							/* RLCA */
+	a = ( a << 1 | a >> 7 ) & 0xff;
+	f = ( f & ( FLAG_P | FLAG_Z | FLAG_S ) ) |
+	    ( a & ( FLAG_C | FLAG_3 | FLAG_5 ) );
+	break;
+      case 1:							/* RRCA */
+	f = ( f & ( FLAG_P | FLAG_Z | FLAG_S ) ) | ( a & FLAG_C );
+	a = ( a >> 1 | a << 7 ) & 0xff;
+	f |= a & ( FLAG_3 | FLAG_5 );
+	break;
+      case 2:							/* RLA */
+	value = a;
+	a = ( a << 1 | ( f & FLAG_C ) ) & 0xff;
+	f = ( f & ( FLAG_P | FLAG_Z | FLAG_S ) ) | ( value >> 7 ) |
+	    ( a & ( FLAG_3 | FLAG_5 ) );
+	break;
+      case 3:							/* RRA */
+	value = a;
+	a = a >> 1 | ( f & FLAG_C ) << 7;
+	f = ( f & ( FLAG_P | FLAG_Z | FLAG_S ) ) | ( value & FLAG_C ) |
+	    ( a & ( FLAG_3 | FLAG_5 ) );
+	break;
+      case 4: daa(); break;
+      case 5:							/* CPL */
+	a ^= 0xff;
+	f = ( f & ( FLAG_C | FLAG_P | FLAG_Z | FLAG_S ) ) |
+	    ( a & ( FLAG_3 | FLAG_5 ) ) | FLAG_N | FLAG_H;
+	break;
+      case 6:							/* SCF */
+	f = ( f & ( FLAG_P | FLAG_Z | FLAG_S ) ) |
+	    ( a & ( FLAG_3 | FLAG_5 ) ) | FLAG_C;
+	break;
+      case 7:							/* CCF */
+	f = ( f & ( FLAG_P | FLAG_Z | FLAG_S ) ) |
+	    ( ( f & FLAG_C ) ? FLAG_H : FLAG_C ) |
+	    ( a & ( FLAG_3 | FLAG_5 ) );
+	break;
+      }
+      break;
+
+    }
+    break;
+
+  case 1:
+    if( y == 6 && z == 6 ) {					/* HALT */
+      halted = 1;
+      pc = ( pc - 1 ) & 0xffff;
+    } else if( y == 6 ) {	/* LD (HL),r: hl:3; H and L are never IXH
+				   and IXL here */
+      address = operand_address( 5 );
+      write_byte( address, get_reg( z, prefix != 0 ) );
+    } else if( z == 6 ) {	/* LD r,(HL) */
+      address = operand_address( 5 );
+      set_reg( y, read_byte( address ), prefix != 0 );
+    } else {
+      set_reg( y, get_reg( z, 0 ), 0 );
+    }
+    break;
+
+  case 2:
+    if( z == 6 ) {		/* ALU (HL): hl:3 */
+      address = operand_address( 5 );
+      alu( y, read_byte( address ) );
+    } else {
+      alu( y, get_reg( z, 0 ) );
+    }
+    break;
+
+  case 3:
+    switch( z ) {
+
+    case 0:			/* RET cc: pc:4, ir:1, [sp:3, sp+1:3] */
+      internal( ir(), 1 );
+      if( condition( y ) ) pc = pop();
+      break;
+
+    case 1:
+      if( !q ) {		/* POP rr: sp:3, sp+1:3 */
+	set_pair( p, pop(), 1 );
+      } else {
+	switch( p ) {
+	case 0: pc = pop(); break;				/* RET */
+	case 1:							/* EXX */
+	  value = b; b = b_; b_ = value; value = c; c = c_; c_ = value;
+	  value = d; d = d_; d_ = value; value = e; e = e_; e_ = value;
+	  value = h; h = h_; h_ = value; value = l; l = l_; l_ = value;
+	  break;
+	case 2: pc = get_index(); break;			/* JP (HL) */
+	case 3: internal( ir(), 2 ); sp = get_index(); break; /* LD SP,HL */
+	}
+      }
+      break;
+
+    case 2:			/* JP cc,nn: pc+1:3, pc+2:3 */
+      if( condition( y ) ) {
+	pc = next_word();
+      } else {
+	read_quiet( pc ); read_quiet( pc + 1 );
+	pc = ( pc + 2 ) & 0xffff;
+      }
+      break;
+
+    case 3:
+      switch( y ) {
+      case 0: pc = next_word(); break;				/* JP nn */
+      case 2:			/* OUT (n),A: pc+1:3, IO */
+	value = next_byte();
+	port_out( a << 8 | value, a );
+	break;
+      case 3:			/* IN A,(n): pc+1:3, IO */
+	value = next_byte();
+	a = port_in( a << 8 | value );
+	break;
+      case 4:	/* EX (SP),HL: sp:3, sp+1:3, sp+1:1, sp+1(write):3,
+		   sp(write):3, sp(write):1 x 2 */
+	word = read_byte( sp );
+	word |= read_byte( sp + 1 ) << 8;
+	internal( sp + 1, 1 );
+	write_byte( sp + 1, get_index() >> 8 );
+	write_byte( sp, get_index() & 0xff );
+	internal( sp, 2 );
+	set_index( word );
+	break;
+      case 5:							/* EX DE,HL */
+	word = get_de(); set_de( get_hl() ); set_hl( word );
+	break;
+      case 6: iff1 = iff2 = 0; break;				/* DI */
+      case 7: iff1 = iff2 = 1; break;				/* EI */
+      }
+      break;
+
+    case 4:	/* CALL cc,nn: pc+1:3, pc+2:3, [pc+2:1, sp-1:3, sp-2:3] */
+      if( condition( y ) ) {
+	word = read_byte( pc );
+	word |= read_byte( pc + 1 ) << 8;
+	internal( pc + 1, 1 );
+	pc = ( pc + 2 ) & 0xffff;
+	push( pc );
+	pc = word;
+      } else {
+	read_quiet( pc ); read_quiet( pc + 1 );
+	pc = ( pc + 2 ) & 0xffff;
+      }
+      break;
+
+    case 5:
+      if( !q ) {		/* PUSH rr: ir:1, sp-1:3, sp-2:3 */
+	internal( ir(), 1 );
+	push( get_pair( p, get_index(), 1 ) );
+      } else if( p == 0 ) {	/* CALL nn */
+	word = read_byte( pc );
+	word |= read_byte( pc + 1 ) << 8;
+	internal( pc + 1, 1 );
+	pc = ( pc + 2 ) & 0xffff;
+	push( pc );
+	pc = word;
+      }
+      break;
+
+    case 6: alu( y, next_byte() ); break;		/* ALU n: pc+1:3 */
+
+    case 7:			/* RST: ir:1, sp-1:3, sp-2:3 */
+      internal( ir(), 1 );
+      push( pc );
+      pc = y * 8;
+      break;
+
+    }
+    break;
+
+  }
+}
+
+/* Does an opcode following DD or FD do anything different from the
+   unprefixed version? */
+static int
+uses_index( unsigned char opcode )
+{
+  int x = opcode >> 6, y = ( opcode >> 3 ) & 7, z = opcode & 7;
+
+  switch( x ) {
+  case 0:
+    if( z == 1 ) return y == 4 || ( y & 1 );	/* LD HL,nn; ADD HL,rr */
+    if( z == 2 ) return y == 4 || y == 5;	/* LD (nn),HL; LD HL,(nn) */
+    if( z == 3 ) return y == 4 || y == 5;	/* INC HL; DEC HL */
+    return ( z >= 4 && z <= 6 ) && ( y >= 4 && y <= 6 );
+  case 1:
+    if( y == 6 && z == 6 ) return 0;		/* HALT */
+    return y == 4 || y == 5 || y == 6 || z == 4 || z == 5 || z == 6;
+  case 2:
+    return z == 4 || z == 5 || z == 6;
+  default:
+    return opcode == 0xe1 || opcode == 0xe3 || opcode == 0xe5 ||
+           opcode == 0xe9 || opcode == 0xf9 || opcode == 0xcb;
+  }
+}
+
+/* Run one whole instruction, including any prefixes */
+static void
+step( void )
+{
+  unsigned char opcode = fetch();
+
+  prefix = 0;
+
+  switch( opcode ) {
+
+  case 0xcb: execute_cb(); break;
+  case 0xed: execute_ed(); break;
+
+  case 0xdd: case 0xfd:
+    /* A prefix followed by an instruction which doesn't use HL is just a
+       four tstate no-op, and the instruction runs on its own */
+    if( !uses_index( memory[ pc ] ) ) break;
+    prefix = opcode == 0xdd ? 1 : 2;
+    opcode = fetch();
+    if( opcode == 0xcb ) execute_index_cb(); else execute( opcode );
+    break;
+
+  default: execute( opcode ); break;
+
+  }
+}
+
+/*
+ * Reading and writing the test files
+ */
+
+/* Read one test from 'input' in the format described in
+   z80/tests/README. Returns 0 on success, -1 at end of file or 1 on
+   error */
+static int
+read_test( FILE *input, char *name, size_t name_length,
+	   unsigned long *end_tstates )
+{
+  unsigned af, bc, de, hl, af2, bc2, de2, hl2, ix_in, iy_in, sp_in, pc_in;
+  unsigned i_in, r_in, iff1_in, iff2_in, im_in, end;
+  int halted_in;
+  unsigned address, byte;
+  size_t length;
+
+  do {
+    if( !fgets( name, name_length, input ) ) return -1;
+    length = strlen( name );
+    while( length && ( name[ length - 1 ] == '\n' ||
+		       name[ length - 1 ] == '\r'    ) )
+      name[ --length ] = '\0';
+  } while( !length );
+
+  if( fscanf( input, "%x %x %x %x %x %x %x %x %x %x %x %x", &af, &bc, &de,
+	      &hl, &af2, &bc2, &de2, &hl2, &ix_in, &iy_in, &sp_in,
+	      &pc_in ) != 12 ) {
+    fprintf( stderr, "%s: %s: bad register line\n", progname, name );
+    return 1;
+  }
+
+  if( fscanf( input, "%x %x %u %u %u %d %u", &i_in, &r_in, &iff1_in,
+	      &iff2_in, &im_in, &halted_in, &end ) != 7 ) {
+    fprintf( stderr, "%s: %s: bad state line\n", progname, name );
+    return 1;
+  }
+
+  set_af( af ); set_bc( bc ); set_de( de ); set_hl( hl );
+  a_ = af2 >> 8; f_ = af2; b_ = bc2 >> 8; c_ = bc2;
+  d_ = de2 >> 8; e_ = de2; h_ = hl2 >> 8; l_ = hl2;
+  ix = ix_in & 0xffff; iy = iy_in & 0xffff;
+  sp = sp_in & 0xffff; pc = pc_in & 0xffff;
+  i = i_in; r = r_in & 0x7f; r7 = r_in & 0x80;
+  iff1 = iff1_in; iff2 = iff2_in; im = im_in; halted = halted_in;
+  *end_tstates = end;
+
+  for( address = 0; address < 0x10000; address += 4 ) {
+    memory[ address     ] = 0xde; memory[ address + 1 ] = 0xad;
+    memory[ address + 2 ] = 0xbe; memory[ address + 3 ] = 0xef;
+  }
+
+  while( 1 ) {
+
+    if( fscanf( input, "%x", &address ) != 1 ) {
+      fprintf( stderr, "%s: %s: bad memory block\n", progname, name );
+      return 1;
+    }
+    if( address == (unsigned)-1 ) break;
+
+    while( 1 ) {
+      if( fscanf( input, "%x", &byte ) != 1 ) {
+	fprintf( stderr, "%s: %s: bad memory block\n", progname, name );
+	return 1;
+      }
+      if( byte == (unsigned)-1 ) break;
+      memory[ address++ & 0xffff ] = byte;
+    }
+  }
+
+  memcpy( initial_memory, memory, sizeof( memory ) );
+
+  return 0;
+}
+
+static void
+write_state( void )
+{
+  size_t address;
+
+  printf( "%04x %04x %04x %04x %04x %04x %04x %04x %04x %04x %04x %04x\n",
+	  get_af(), get_bc(), get_de(), get_hl(), a_ << 8 | f_, b_ << 8 | c_,
+	  d_ << 8 | e_, h_ << 8 | l_, ix, iy, sp, pc );
+  printf( "%02x %02x %d %d %d %d %d\n", i, ( r7 & 0x80 ) | ( r & 0x7f ),
+	  iff1, iff2, im, halted, (int)tstates );
+
+  for( address = 0; address < 0x10000; address++ ) {
+
+    if( memory[ address ] == initial_memory[ address ] ) continue;
+
+    printf( "%04x ", (unsigned)address );
+    while( address < 0x10000 &&
+	   memory[ address ] != initial_memory[ address ] )
+      printf( "%02x ", memory[ address++ ] );
+    printf( "-1\n" );
+
+  }
+
+  printf( "\n" );
+}
+
+int
+main( int argc, char **argv )
+{
+  char name[ 256 ];
+  unsigned long end_tstates;
+  FILE *input;
+  int error;
+
+  progname = argv[0];
+
+  if( argc > 1 && !strcmp( argv[1], "-c" ) ) {
+    contention = 1;
+    argc--; argv++;
+  }
+
+  if( argc != 2 ) {
+    fprintf( stderr, "usage: %s [-c] <tests.in>\n", progname );
+    return 1;
+  }
+
+  input = fopen( argv[1], "r" );
+  if( !input ) {
+    fprintf( stderr, "%s: couldn't open '%s'\n", progname, argv[1] );
+    return 1;
+  }
+
+  while( !( error = read_test( input, name, sizeof( name ),
+			       &end_tstates ) ) ) {
+
+    printf( "%s\n", name );
+
+    tstates = 0;
+    while( tstates < end_tstates ) step();
+
+    write_state();
+  }
+
+  fclose( input );
+
+  return error == 1;
+}
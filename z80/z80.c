@@ -29,6 +29,7 @@
 #include "fuse.h"
 #include "memory.h"
 #include "module.h"
+#include "profile.h"
 #include "rzx.h"
 #include "scld.h"
 #include "spectrum.h"
@@ -183,6 +184,8 @@ z80_interrupt( void )
 	fuse_abort();
     }
 
+    if( profile_active ) profile_interrupt();
+
     return 1;			/* Accepted an interrupt */
 
   } else {
@@ -219,6 +222,8 @@ z80_nmi( libspectrum_dword tstates, int type, void *user_data )
 
   /* FIXME: how does contention apply here? */
   tstates += 11; PC = 0x0066;
+
+  if( profile_active ) profile_interrupt();
 }
 
 /* Routines for transferring the Z80 contents to and from snapshots */
@@ -96,10 +96,51 @@ enum {
 
 #endif				/* #ifdef __GNUC__ */
 
+/* When none of the checks above are needed, we can go one step further
+   and use threaded code: rather than returning to the top of the loop
+   after each opcode, fetch the next opcode and jump directly to the
+   code for it. This gives the host's branch predictor one indirect
+   jump per opcode to learn from, rather than a single shared switch.
+   Each case in opcodes_base.c is labelled so we can jump to it; the
+   normal switch is still used whenever any check is active.
+
+   The same is done when the only active check is the TR-DOS ROM paging
+   check, as the Pentagon and Scorpion always have that active; the
+   check is then made inline before each threaded fetch */
+
+#ifdef __GNUC__
+
+#define OPCODE( opcode ) case opcode: opcode_##opcode
+
+#define OPCODE_LABELS( high ) \
+  &&opcode_0x##high##0, &&opcode_0x##high##1, &&opcode_0x##high##2, \
+  &&opcode_0x##high##3, &&opcode_0x##high##4, &&opcode_0x##high##5, \
+  &&opcode_0x##high##6, &&opcode_0x##high##7, &&opcode_0x##high##8, \
+  &&opcode_0x##high##9, &&opcode_0x##high##a, &&opcode_0x##high##b, \
+  &&opcode_0x##high##c, &&opcode_0x##high##d, &&opcode_0x##high##e, \
+  &&opcode_0x##high##f
+
+#else				/* #ifdef __GNUC__ */
+
+#define OPCODE( opcode ) case opcode
+
+#endif				/* #ifdef __GNUC__ */
+
 #ifndef HAVE_ENOUGH_MEMORY
 static libspectrum_byte opcode = 0x00;
 #endif
 
+/* Page the TR-DOS ROM in or out as appropriate */
+#define BETA_CHECK() \
+  do { \
+    if( beta_active ) { \
+      if( machine_current->ram.current_rom && PC >= 16384 ) beta_unpage(); \
+    } else if( ( PC & 0xff00 ) == 0x3d00 && \
+	       machine_current->ram.current_rom ) { \
+      beta_page(); \
+    } \
+  } while( 0 )
+
 /* Execute Z80 opcodes until the next event */
 void
 z80_do_opcodes( void )
@@ -115,7 +156,10 @@ z80_do_opcodes( void )
 
 #undef SETUP_CHECK
 #define SETUP_CHECK( label, condition ) \
-  if( condition ) { cgoto[ next ] = &&label; next = pos_##label + 1; } \
+  if( condition ) { \
+    cgoto[ next ] = &&label; next = pos_##label + 1; \
+    active_checks |= 1 << pos_##label; \
+  } \
   check++;
 
 #undef SETUP_NEXT
@@ -124,9 +168,25 @@ z80_do_opcodes( void )
   next = check;
 
   void *cgoto[ numchecks ]; size_t next = 0; size_t check = 0;
+  unsigned active_checks = 0; void *threaded = NULL;
+
+  static void * const opcode_labels[ 0x100 ] = {
+    OPCODE_LABELS( 0 ), OPCODE_LABELS( 1 ), OPCODE_LABELS( 2 ),
+    OPCODE_LABELS( 3 ), OPCODE_LABELS( 4 ), OPCODE_LABELS( 5 ),
+    OPCODE_LABELS( 6 ), OPCODE_LABELS( 7 ), OPCODE_LABELS( 8 ),
+    OPCODE_LABELS( 9 ), OPCODE_LABELS( a ), OPCODE_LABELS( b ),
+    OPCODE_LABELS( c ), OPCODE_LABELS( d ), OPCODE_LABELS( e ),
+    OPCODE_LABELS( f ),
+  };
 
 #include "z80_checks.h"
 
+  if( !active_checks ) {
+    threaded = &&threaded_fetch;
+  } else if( active_checks == 1 << pos_beta ) {
+    threaded = &&threaded_beta;
+  }
+
 #endif				/* #ifdef __GNUC__ */
 
   while( tstates < event_next_event ) {
@@ -159,15 +219,7 @@ z80_do_opcodes( void )
 
     CHECK( beta, beta_available )
 
-    if( beta_active ) {
-      if( machine_current->ram.current_rom &&
-	  PC >= 16384 ) {
-	beta_unpage();
-      }
-    } else if( ( PC & 0xff00 ) == 0x3d00 &&
-	       machine_current->ram.current_rom ) {
-      beta_page();
-    }
+    BETA_CHECK();
 
     END_CHECK
 
@@ -236,6 +288,24 @@ z80_do_opcodes( void )
 #include "opcodes_base.c"
     }
 
+#ifdef __GNUC__
+
+    /* Threaded code: see above. This must do exactly what the top of
+       the loop does with the same checks active */
+    if( threaded && tstates < event_next_event ) goto *threaded;
+    continue;
+
+  threaded_beta:
+    BETA_CHECK();
+
+  threaded_fetch:
+    contend_read( PC, 4 );
+    opcode = readbyte_internal( PC );
+    PC++; R++;
+    goto *opcode_labels[ opcode ];
+
+#endif				/* #ifdef __GNUC__ */
+
   }
 
 }